@@ -0,0 +1,224 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDateTime>
+#include <QDesktopServices>
+#include <QDir>
+#include <QSettings>
+#include <QStringList>
+#include <QDebug>
+
+#include "AttachmentCache.h"
+
+AttachmentCache::AttachmentCache(const QString &trackerId,
+                                 const QMap<QString, QString> &attachment)
+    : mHash(QCryptographicHash::Sha1)
+{
+    mKey = entryKey(trackerId, attachment);
+    mLastModified = attachment.value("last_modified");
+    mSize = 0;
+}
+
+AttachmentCache::~AttachmentCache()
+{
+    if (mFile.isOpen())
+        discard();
+}
+
+bool
+AttachmentCache::open()
+{
+    QDir().mkpath(cacheDir());
+    // A file of its own per download, as the same attachment can be
+    // downloaded twice at once.  commit() and discard() deal with it, since
+    // the automatic removal would follow the file to its new name.
+    mFile.setFileTemplate(QString("%1/XXXXXX.part").arg(cacheDir()));
+    mFile.setAutoRemove(false);
+    if (!mFile.open())
+    {
+        qDebug() << "AttachmentCache: Could not open " << mFile.fileTemplate() << ": " << mFile.errorString();
+        return false;
+    }
+    mHash.reset();
+    mSize = 0;
+    return true;
+}
+
+bool
+AttachmentCache::write(const QByteArray &data)
+{
+    if (mFile.write(data) != data.size())
+    {
+        qDebug() << "AttachmentCache: Could not write " << mFile.fileName() << ": " << mFile.errorString();
+        return false;
+    }
+    mHash.addData(data);
+    mSize += data.size();
+    return true;
+}
+
+QString
+AttachmentCache::commit()
+{
+    mFile.close();
+    QString hash = mHash.result().toHex();
+    QString path = QString("%1/%2").arg(cacheDir()).arg(hash);
+
+    // Identical content may already be there under another attachment
+    if (QFile::exists(path))
+    {
+        mFile.remove();
+    }
+    else if (!mFile.rename(path))
+    {
+        qDebug() << "AttachmentCache: Could not rename " << mFile.fileName() << ": " << mFile.errorString();
+        mFile.remove();
+        return "";
+    }
+
+    QSettings index(QString("%1/index.ini").arg(cacheDir()), QSettings::IniFormat);
+    index.beginGroup(mKey);
+    index.setValue("hash", hash);
+    index.setValue("size", mSize);
+    index.setValue("last-modified", mLastModified);
+    index.setValue("last-used", QDateTime::currentDateTime());
+    index.endGroup();
+    index.sync();
+
+    // The newest entry is never evicted, so an attachment bigger than the
+    // whole cache is kept until the next download
+    QSettings settings("Entomologist");
+    evict(settings.value("attachment-cache-size", 256).toLongLong() * 1024 * 1024);
+    return path;
+}
+
+void
+AttachmentCache::discard()
+{
+    mFile.close();
+    mFile.remove();
+}
+
+QString
+AttachmentCache::lookup(const QString &trackerId,
+                        const QMap<QString, QString> &attachment)
+{
+    QString key = entryKey(trackerId, attachment);
+    QSettings index(QString("%1/index.ini").arg(cacheDir()), QSettings::IniFormat);
+    index.beginGroup(key);
+    QString hash = index.value("hash").toString();
+    if (hash.isEmpty())
+        return "";
+
+    // Trac attachments can be replaced under the same name
+    QString path = QString("%1/%2").arg(cacheDir()).arg(hash);
+    if ((index.value("last-modified").toString() != attachment.value("last_modified"))
+        || !QFile::exists(path))
+    {
+        index.endGroup();
+        index.remove(key);
+        return "";
+    }
+
+    index.setValue("last-used", QDateTime::currentDateTime());
+    return path;
+}
+
+bool
+AttachmentCache::copyTo(const QString &cachedPath, const QString &destination)
+{
+    if (cachedPath == destination)
+        return true;
+    if (QFile::exists(destination))
+        QFile::remove(destination);
+    if (!QFile::copy(cachedPath, destination))
+    {
+        qDebug() << "AttachmentCache: Could not copy " << cachedPath << " to " << destination;
+        return false;
+    }
+    return true;
+}
+
+QString
+AttachmentCache::cacheDir()
+{
+    return QString("%1%2attachments")
+            .arg(QDesktopServices::storageLocation(QDesktopServices::CacheLocation))
+            .arg(QDir::separator());
+}
+
+// Trac has no attachment ids, only file names
+QString
+AttachmentCache::entryKey(const QString &trackerId,
+                          const QMap<QString, QString> &attachment)
+{
+    QString id = QString("%1\n%2\n%3\n%4")
+                 .arg(trackerId)
+                 .arg(attachment.value("bug_id"))
+                 .arg(attachment.value("attachment_id"))
+                 .arg(attachment.value("filename"));
+    return QCryptographicHash::hash(id.toUtf8(), QCryptographicHash::Sha1).toHex();
+}
+
+// Drops the least recently used entries until the files left add up to no
+// more than limit bytes.  Content shared by several entries is counted
+// and removed once.
+void
+AttachmentCache::evict(qint64 limit)
+{
+    QSettings index(QString("%1/index.ini").arg(cacheDir()), QSettings::IniFormat);
+    QMap<QDateTime, QString> byAge;
+    QMap<QString, qint64> hashSizes;
+    QMap<QString, int> hashUsers;
+    QStringList keys = index.childGroups();
+    for (int i = 0; i < keys.size(); ++i)
+    {
+        index.beginGroup(keys.at(i));
+        QString hash = index.value("hash").toString();
+        QDateTime used = index.value("last-used").toDateTime();
+        while (byAge.contains(used))
+            used = used.addMSecs(1);
+        byAge.insert(used, keys.at(i));
+        hashSizes[hash] = index.value("size").toLongLong();
+        hashUsers[hash]++;
+        index.endGroup();
+    }
+
+    qint64 total = 0;
+    QMapIterator<QString, qint64> s(hashSizes);
+    while (s.hasNext())
+        total += s.next().value();
+
+    QMapIterator<QDateTime, QString> oldest(byAge);
+    while ((total > limit) && (byAge.size() > 1) && oldest.hasNext())
+    {
+        QString key = oldest.next().value();
+        byAge.remove(oldest.key());
+        QString hash = index.value(key + "/hash").toString();
+        index.remove(key);
+        if (--hashUsers[hash] == 0)
+        {
+            QFile::remove(QString("%1/%2").arg(cacheDir()).arg(hash));
+            total -= hashSizes.value(hash);
+        }
+    }
+}
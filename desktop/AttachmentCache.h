@@ -0,0 +1,71 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef ATTACHMENTCACHE_H
+#define ATTACHMENTCACHE_H
+
+#include <QCryptographicHash>
+#include <QMap>
+#include <QString>
+#include <QTemporaryFile>
+
+// Downloaded attachments are kept under the cache directory, one file per
+// distinct content (named by its SHA-1), with an index mapping tracker and
+// attachment to the content.  The least recently used entries are dropped
+// once the total passes the attachment-cache-size setting (in MB).
+//
+// A download writes into an AttachmentCache object as data arrives, so the
+// whole attachment never has to sit in memory, and commit()s it at the end.
+class AttachmentCache
+{
+public:
+    AttachmentCache(const QString &trackerId,
+                    const QMap<QString, QString> &attachment);
+    ~AttachmentCache();
+
+    bool open();
+    bool write(const QByteArray &data);
+    // Moves the download into the cache and returns its path there, or an
+    // empty string if it couldn't be stored
+    QString commit();
+    void discard();
+
+    // Path of the cached copy of an attachment, or an empty string
+    static QString lookup(const QString &trackerId,
+                          const QMap<QString, QString> &attachment);
+    // Copies a cached file to where the user asked for it
+    static bool copyTo(const QString &cachedPath, const QString &destination);
+
+private:
+    static QString cacheDir();
+    static QString entryKey(const QString &trackerId,
+                            const QMap<QString, QString> &attachment);
+    static void evict(qint64 limit);
+
+    QString mKey;
+    QString mLastModified;
+    QTemporaryFile mFile;
+    QCryptographicHash mHash;
+    qint64 mSize;
+};
+
+#endif // ATTACHMENTCACHE_H
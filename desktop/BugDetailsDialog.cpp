@@ -9,6 +9,8 @@
 #include "tracker_uis/BackendDetails.h"
 #include "Utilities.hpp"
 #include "SqlUtilities.h"
+#include "SqlReader.h"
+#include "AttachmentCache.h"
 #include "AttachmentWidget.h"
 #include "BugDetailsDialog.h"
 #include "ui_BugDetailsDialog.h"
@@ -21,6 +23,10 @@ BugDetailsDialog::BugDetailsDialog(Backend *backend, QWidget *parent) :
     pBackend = backend;
     connect(pBackend, SIGNAL(commentsCached()),
             this, SLOT(commentsCached()));
+    pReader = new SqlReader(this);
+    connect(pReader, SIGNAL(finished(SqlReadResult)),
+            this, SLOT(commentsLoaded(SqlReadResult)));
+    mCommentsRequest = 0;
 
     ui->setupUi(this);
     ui->cancelButton->setIcon(style()->standardIcon(QStyle::SP_DialogCancelButton));
@@ -201,16 +207,27 @@ BugDetailsDialog::loadComments()
     }
 }
 
+// The comments are read on the reader thread, and filled in by
+// commentsLoaded() when they arrive
 void
 BugDetailsDialog::setComments()
 {
+    mCommentsRequest = pReader->loadBugComments(pBackend->type(), mTrackerId, mCurrentBugId);
+}
+
+void
+BugDetailsDialog::commentsLoaded(SqlReadResult result)
+{
+    if (result.id != mCommentsRequest)
+        return;
+
     int i = 0;
     int total = 0;
     if (ui->descriptionText->text().isEmpty())
-        ui->descriptionText->setText(SqlUtilities::getBugDescription(pBackend->type(), mCurrentBugId));
-    QList < QMap<QString, QString> > mainComments = SqlUtilities::loadComments(mTrackerId, mCurrentBugId, false);
-    QList < QMap<QString, QString> > shadowComments = SqlUtilities::loadComments(mTrackerId, mCurrentBugId, true);
-    QList < QMap<QString, QString> > attachmentList = SqlUtilities::loadAttachments(mTrackerId, mCurrentBugId);
+        ui->descriptionText->setText(result.text);
+    QList < QMap<QString, QString> > mainComments = result.comments;
+    QList < QMap<QString, QString> > shadowComments = result.shadowComments;
+    QList < QMap<QString, QString> > attachmentList = result.attachments;
     if (attachmentList.size() == 0)
     {
         ui->topAttachmentsFrame->hide();
@@ -325,9 +342,7 @@ BugDetailsDialog::attachmentClicked(int rowId)
             .arg(QDir::separator())
             .arg(attachment["filename"]);
 
-    ui->loadingCommentsLabel->setText("Downloading attachment...");
-    startSpinner();
-    pBackend->downloadAttachment(rowId, path);
+    fetchAttachment(rowId, attachment, path);
 }
 
 void
@@ -343,11 +358,25 @@ BugDetailsDialog::attachmentSaveAsClicked(int rowId)
     QString fileName = QFileDialog::getSaveFileName(0, tr("Save File As"),
                                path);
     if (!fileName.isEmpty())
+        fetchAttachment(rowId, attachment, fileName);
+}
+
+// Attachments that were downloaded before are copied out of the cache
+void
+BugDetailsDialog::fetchAttachment(int rowId,
+                                  const QMap<QString, QString> &attachment,
+                                  const QString &path)
+{
+    QString cachedPath = AttachmentCache::lookup(pBackend->id(), attachment);
+    if (!cachedPath.isEmpty() && AttachmentCache::copyTo(cachedPath, path))
     {
-        ui->loadingCommentsLabel->setText("Downloading attachment...");
-        startSpinner();
-        pBackend->downloadAttachment(rowId, fileName);
+        attachmentDownloaded(path);
+        return;
     }
+
+    ui->loadingCommentsLabel->setText("Downloading attachment...");
+    startSpinner();
+    pBackend->downloadAttachment(rowId, path);
 }
 
 void
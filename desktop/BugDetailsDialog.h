@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QtSql>
 #include "CommentFrame.h"
+#include "SqlReaderThread.h"
 
 namespace Ui {
     class BugDetailsDialog;
@@ -14,6 +15,7 @@ class BackendDetails;
 class QMovie;
 class QLabel;
 class QSplitterHandle;
+class SqlReader;
 
 class BugDetailsDialog : public QDialog
 {
@@ -34,6 +36,7 @@ public slots:
     void attachmentSaveAsClicked(int rowId);
     void attachmentDownloaded(const QString &filePath);
     void commentsCached();
+    void commentsLoaded(SqlReadResult result);
     void textClicked(const QString &text);
     void save();
     void cancel();
@@ -49,11 +52,16 @@ private:
     void frameToggle(QWidget *frame, QLabel *arrow);
     void startSpinner();
     void stopSpinner();
+    void fetchAttachment(int rowId,
+                         const QMap<QString, QString> &attachment,
+                         const QString &path);
     Ui::BugDetailsDialog *ui;
     QString mCurrentBugId, mTrackerId;
     Backend *pBackend;
     BackendDetails *pDetails;
     QMovie *pSpinnerMovie;
+    SqlReader *pReader;
+    int mCommentsRequest;
     bool openAttachment;
 };
 
@@ -65,7 +65,11 @@ CommentFrame::setName(const QString &name)
 void
 CommentFrame::setDate(const QString &date)
 {
-    QDateTime formatDate = QDateTime::fromString(date, Qt::ISODate);
+    // Cached comments are stored as epoch seconds, older ones as ISO strings
+    bool isEpoch = false;
+    uint seconds = date.toUInt(&isEpoch);
+    QDateTime formatDate = isEpoch ? QDateTime::fromTime_t(seconds)
+                                   : QDateTime::fromString(date, Qt::ISODate);
     ui->dateLabel->setText(formatDate.toString(Qt::DefaultLocaleLongDate));
 }
 
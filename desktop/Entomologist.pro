@@ -28,6 +28,8 @@ SOURCES += main.cpp \
     libmaia/maiaObject.cpp \
     libmaia/maiaFault.cpp \
     trackers/Backend.cpp \
+    trackers/SyncPhaseGraph.cpp \
+    trackers/SyncPipeline.cpp \
     trackers/Bugzilla.cpp \
     NewTracker.cpp \
     trackers/NovellBugzilla.cpp \
@@ -39,6 +41,17 @@ SOURCES += main.cpp \
     Preferences.cpp \
     About.cpp \
     SqlWriterThread.cpp \
+    SqlWriter.cpp \
+    SqlRecordBatch.cpp \
+    SqlStatementCache.cpp \
+    SqlMaintenance.cpp \
+    AttachmentCache.cpp \
+    SqlReaderThread.cpp \
+    SqlReader.cpp \
+    SqlWatchdog.cpp \
+    SqlProfiler.cpp \
+    SyncCoordinator.cpp \
+    SyncScheduler.cpp \
     PlaceholderLineEdit.cpp \
     qtsoap/qtsoap.cpp \
     trackers/Mantis.cpp \
@@ -68,6 +81,7 @@ SOURCES += main.cpp \
     tracker_uis/MantisUI.cpp \
     SqlUtilities.cpp \
     tracker_uis/BackendUI.cpp \
+    tracker_uis/AllBugsUI.cpp \
     BugDetailsDialog.cpp \
     tracker_uis/TracDetails.cpp \
     TrackerTabWidget.cpp \
@@ -102,6 +116,8 @@ HEADERS += MainWindow.h \
     libmaia/maiaObject.h \
     libmaia/maiaFault.h \
     trackers/Backend.h \
+    trackers/SyncPhaseGraph.h \
+    trackers/SyncPipeline.h \
     trackers/Bugzilla.h \
     NewTracker.h \
     trackers/NovellBugzilla.h \
@@ -113,6 +129,17 @@ HEADERS += MainWindow.h \
     Preferences.h \
     About.h \
     SqlWriterThread.h \
+    SqlWriter.h \
+    SqlRecordBatch.h \
+    SqlStatementCache.h \
+    SqlMaintenance.h \
+    AttachmentCache.h \
+    SqlReaderThread.h \
+    SqlReader.h \
+    SqlWatchdog.h \
+    SqlProfiler.h \
+    SyncCoordinator.h \
+    SyncScheduler.h \
     PlaceholderLineEdit.h \
     qtsoap/qtsoap.h \
     trackers/Mantis.h \
@@ -146,6 +173,7 @@ HEADERS += MainWindow.h \
     tracker_uis/MantisUI.h \
     SqlUtilities.h \
     tracker_uis/BackendUI.h \
+    tracker_uis/AllBugsUI.h \
     BugDetailsDialog.h \
     tracker_uis/TracDetails.h \
     TrackerTabWidget.h \
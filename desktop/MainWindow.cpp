@@ -42,6 +42,10 @@
 #include <QPainter>
 #include <QDockWidget>
 #include <QToolBar>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QPlainTextEdit>
+#include <QVBoxLayout>
 
 #include "About.h"
 #include "ChangelogWindow.h"
@@ -51,6 +55,7 @@
 #include "SqlBugDelegate.h"
 #include "SqlBugModel.h"
 #include "SearchTab.h"
+#include "tracker_uis/AllBugsUI.h"
 #include "trackers/Bugzilla.h"
 #include "trackers/NovellBugzilla.h"
 #include "trackers/Trac.h"
@@ -62,11 +67,17 @@
 #include "Utilities.hpp"
 #include "MonitorDialog.h"
 #include "SqlUtilities.h"
+#include "SqlStatementCache.h"
+#include "SqlProfiler.h"
+#include "SqlMaintenance.h"
+#include "SqlReader.h"
+#include "SyncCoordinator.h"
+#include "SyncScheduler.h"
 #include "ui_MainWindow.h"
 #include "ToDoListWidget.h"
 #include "UpdatesAvailableDialog.h"
 
-#define DB_VERSION 6
+#define DB_VERSION 19
 
 bool mLogAllXmlRpcOutput;
 
@@ -84,14 +95,6 @@ MainWindow::MainWindow(QWidget *parent) :
     pDetectorProgress = NULL;
     mLogAllXmlRpcOutput = false;
     mDbUpdated = false;
-    // mSyncRequests tracks how many sync requests have been made
-    // in order to know when to re-enable the widgets
-    mSyncRequests = 0;
-    // mSyncPosition is used to iterate through the backend list,
-    // so we only sync one repository at a time, rather than flinging
-    // requests at all of them at once.
-    mSyncPosition = 0;
-    mUploading = false;
     QSettings settings("Entomologist");
 
     pManager = new QNetworkAccessManager();
@@ -136,16 +139,11 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->spinnerLabel->hide();
     ui->syncingLabel->hide();
 
-    // Set up the resync timer
-    pUpdateTimer = new QTimer(this);
-    connect(pUpdateTimer, SIGNAL(timeout()),
-            this, SLOT(resync()));
-    setTimer();
-
     // Keyboard shortcuts for search bar focus / upload changes.
     QShortcut* searchFocus;
     QShortcut* uploadChange;
     QShortcut *logXmlRpc;
+    QShortcut *sqlProfile;
 
     searchFocus = new QShortcut(QKeySequence(Qt::META + Qt::Key_Space),this);
     searchFocus->setContext(Qt::ApplicationShortcut);
@@ -159,6 +157,10 @@ MainWindow::MainWindow(QWidget *parent) :
     logXmlRpc->setContext(Qt::ApplicationShortcut);
     connect(logXmlRpc, SIGNAL(activated()), this, SLOT(toggleXmlRpcLogging()));
 
+    sqlProfile = new QShortcut(QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_9), this);
+    sqlProfile->setContext(Qt::ApplicationShortcut);
+    connect(sqlProfile, SIGNAL(activated()), this, SLOT(showSqlProfile()));
+
     // Menu actions
     connect(ui->action_Add_Tracker, SIGNAL(triggered()),
             this, SLOT(addTrackerTriggered()));
@@ -193,6 +195,8 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(ui->trackerTab, SIGNAL(showMenu(int)),
             this, SLOT(showMenu(int)));
+    connect(ui->trackerTab, SIGNAL(currentChanged(int)),
+            this, SLOT(trackerTabChanged(int)));
     ui->trackerTab->removeTab(0);
     ui->trackerTab->removeTab(0);
 
@@ -208,6 +212,26 @@ MainWindow::MainWindow(QWidget *parent) :
             checkForUpdates();
 
     setupDB();
+    pMaintenance = new SqlMaintenance(this);
+    pSyncCoordinator = new SyncCoordinator(this);
+    connect(pSyncCoordinator, SIGNAL(started()),
+            this, SLOT(startAnimation()));
+    connect(pSyncCoordinator, SIGNAL(progress(int,int)),
+            this, SLOT(syncProgress(int,int)));
+    connect(pSyncCoordinator, SIGNAL(finished()),
+            this, SLOT(syncFinished()));
+
+    // Each tracker has its own automatic sync schedule
+    pSyncScheduler = new SyncScheduler(this);
+    connect(pSyncScheduler, SIGNAL(syncDue(QList<Backend*>)),
+            this, SLOT(syncDue(QList<Backend*>)));
+    connect(pSyncCoordinator, SIGNAL(synced(Backend*,bool)),
+            pSyncScheduler, SLOT(synced(Backend*,bool)));
+    setTimer();
+    pReader = new SqlReader(this);
+    mPendingChangesRequest = 0;
+    connect(pReader, SIGNAL(finished(SqlReadResult)),
+            this, SLOT(pendingChangesLoaded(SqlReadResult)));
     toggleButtons();
 
     // Now we need the todo list widget
@@ -231,11 +255,29 @@ MainWindow::MainWindow(QWidget *parent) :
             this, SLOT(openSearchedBug(QString,QString)));
 
     loadTrackers();
+
+    // Created after the trackers are loaded so that it doesn't requery
+    // once for every tracker that's added
+    pAllBugsTab = new AllBugsUI(this);
+    connect(pAllBugsTab, SIGNAL(openBug(QString,QString)),
+            this, SLOT(openAllBugsRow(QString,QString)));
+    connect(this, SIGNAL(reloadFromDatabase()),
+            pAllBugsTab, SLOT(reloadFromDatabase()));
+    connect(this, SIGNAL(setShowOptions(bool,bool,bool,bool)),
+            pAllBugsTab, SLOT(setShowOptions(bool,bool,bool,bool)));
+    pAllBugsTab->setShowOptions(ui->actionMy_Bugs->isChecked(),
+                                ui->actionMy_Reports->isChecked(),
+                                ui->actionMy_CCs->isChecked(),
+                                ui->actionMonitored_Components->isChecked());
+    ui->trackerTab->addTab(pAllBugsTab, QIcon(":/bug"), tr("All Bugs"));
     ui->trackerTab->addTab(pSearchTab, QIcon(":/search"), "Search");
 
     if ((settings.value("startup-sync", false).toBool() == true)
        || (mDbUpdated))
-        syncNextTracker();
+    {
+        if (isOnline())
+            pSyncCoordinator->start(mBackendList, SyncCoordinator::SYNC);
+    }
 }
 
 MainWindow::~MainWindow()
@@ -373,8 +415,6 @@ MainWindow::setupTracker(Backend *newBug, QMap<QString, QString> info)
     newBug->setVersion(info["version"]);
     if (!info["monitored_components"].isEmpty())
         newBug->setMonitorComponents(info["monitored_components"].split(","));
-    connect(newBug, SIGNAL(bugsUpdated()),
-            this, SLOT(bugsUpdated()));
     connect(newBug, SIGNAL(backendError(QString)),
             this, SLOT(backendError(QString)));
 
@@ -386,7 +426,6 @@ MainWindow::setupTracker(Backend *newBug, QMap<QString, QString> info)
         info["auto_cache_comments"] = newBug->autoCacheComments();
         int tracker = SqlUtilities::simpleInsert("trackers", info);
         newBug->setId(QString("%1").arg(tracker));
-        mSyncPosition = mBackendList.size() + 1;
         connect(newBug, SIGNAL(fieldsFound()),
                 this, SLOT(fieldsChecked()));
         newBug->checkFields();
@@ -414,6 +453,7 @@ MainWindow::addTrackerToList(Backend *newTracker, bool sync)
     connect(newTracker->displayWidget(), SIGNAL(bugChanged()),
             this, SLOT(toggleButtons()));
     int newIndex = ui->trackerTab->insertTab(0, newTracker->displayWidget(), newTracker->name());
+    ui->trackerTab->setTrackerName(newIndex, newTracker->name());
     pSearchTab->addTracker(newTracker);
     filterTable();
 
@@ -424,35 +464,57 @@ MainWindow::addTrackerToList(Backend *newTracker, bool sync)
     ui->trackerTab->setCurrentIndex(newIndex);
     mBackendMap[newTracker->id()] = newTracker;
     mBackendList.append(newTracker);
+    pSyncScheduler->addBackend(newTracker);
     if(!QFile::exists(iconPath))
         fetchIcon(newTracker->url(), iconPath, newTracker->username(), newTracker->password());
     if (sync)
         syncTracker(newTracker);
 }
 
-// This slot is connected to a signal in each Backend object,
-// so we know when we're done syncing and can let the user
-// interact with the application again
+// Called once every queued sync and upload has finished, so the user
+// can interact with the application again
+void
+MainWindow::syncFinished()
+{
+    filterTable();
+    stopAnimation();
+    updateTrackerBadges();
+    notifyUser();
+    emit reloadFromDatabase();
+}
+
 void
-MainWindow::bugsUpdated()
+MainWindow::syncProgress(int done,
+                         int total)
 {
-    mSyncRequests--;
-    qDebug() << "bugsUpdated: mSyncRequests is now: " << mSyncRequests;
+    QString action = pSyncCoordinator->isUploading() ? "Uploading changes to" : "Syncing";
+    ui->syncingLabel->setText(QString("%1 %2 (%3 of %4)...")
+                              .arg(action)
+                              .arg(pSyncCoordinator->activeNames().join(", "))
+                              .arg(done + 1)
+                              .arg(total));
+}
 
-    if (mSyncRequests == 0)
+// Shows how many bugs changed in the last sync next to each tracker's
+// name, with the rest of its counts in the tooltip
+void
+MainWindow::updateTrackerBadges()
+{
+    QMapIterator<QString, Backend *> i(mBackendMap);
+    while (i.hasNext())
     {
-        if (mSyncPosition == mBackendList.size())
-        {
-            filterTable();
-            mUploading = false;
-            stopAnimation();
-            notifyUser();
-            emit reloadFromDatabase();
-        }
-        else
-        {
-            syncNextTracker();
-        }
+        i.next();
+        int index = ui->trackerTab->indexOf(i.value()->displayWidget());
+        if (index == -1)
+            continue;
+
+        QMap<QString, int> stats = SqlUtilities::trackerStats(i.key());
+        QString toolTip = tr("%1 changed in the last sync\n%2 open, %3 assigned to you\n%4 unsent changes")
+                          .arg(stats.value("recent"))
+                          .arg(stats.value("open"))
+                          .arg(stats.value("assigned"))
+                          .arg(stats.value("pending"));
+        ui->trackerTab->setTrackerBadge(index, stats.value("recent"), toolTip);
     }
 }
 
@@ -472,11 +534,15 @@ MainWindow::notifyUser()
 #endif
 
     int total = 0;
+    QStringList perTracker;
     QMapIterator<QString, Backend *> i(mBackendMap);
     while (i.hasNext())
     {
         i.next();
         total += i.value()->latestUpdateCount();
+        int recent = SqlUtilities::trackerStats(i.key()).value("recent");
+        if (recent > 0)
+            perTracker << QString("%1: %2").arg(i.value()->name()).arg(recent);
     }
 
     if (total > 0)
@@ -506,8 +572,9 @@ MainWindow::notifyUser()
             QApplication::setWindowIcon(QIcon(newIcon));
         }
 #else
+        perTracker.prepend(tr("%n bug(s) updated", "", total));
         pTrayIcon->showMessage("Bugs Updated",
-                               tr("%n bug(s) updated", "", total),
+                               perTracker.join("\n"),
                                QSystemTrayIcon::Information,
                                5000);
 #endif
@@ -548,6 +615,7 @@ MainWindow::startAnimation()
         ui->trackerTab->setTabEnabled(i, false);
     }
     pSpinnerMovie->start();
+    pMaintenance->setSyncActive(true);
 }
 
 void
@@ -569,6 +637,7 @@ MainWindow::stopAnimation()
     }
 
     toggleButtons();
+    pMaintenance->setSyncActive(false);
 }
 
 // Grab the favicon.ico for each tracker to make the bug list prettier
@@ -749,14 +818,7 @@ MainWindow::syncTracker(Backend *tracker)
     if (!isOnline())
         return;
 
-    qDebug() << "Syncing " << tracker->name();
-    ui->syncingLabel->setText(QString("Syncing %1...").arg(tracker->name()));
-    if (mSyncRequests == 0)
-        startAnimation();
-    else
-        qDebug() << "Outstanding sync requests: " << mSyncRequests;
-    mSyncRequests++;
-    tracker->sync();
+    pSyncCoordinator->start(tracker, SyncCoordinator::SYNC);
 }
 
 // This is triggered when the user selects File -> Add Tracker
@@ -970,28 +1032,7 @@ MainWindow::resync()
         return;
     }
 
-    mSyncPosition = 0;
-    syncNextTracker();
-}
-
-void
-MainWindow::syncNextTracker()
-{
-    if (mBackendList.empty())
-        return;
-
-    Backend *b = mBackendList.at(mSyncPosition);
-    mSyncPosition++;
-    if (mUploading)
-    {
-        mSyncRequests++;
-        ui->syncingLabel->setText(QString("Uploading changes to %1").arg(b->name()));
-        b->uploadAll();
-    }
-    else
-    {
-        syncTracker(b);
-    }
+    pSyncCoordinator->start(mBackendList, SyncCoordinator::SYNC);
 }
 
 // This is called when the user presses the upload button
@@ -1022,10 +1063,7 @@ MainWindow::upload()
     if (reallyUpload)
     {
         qDebug() << "Uploading...";
-        startAnimation();
-        mUploading = true;
-        mSyncPosition = 0;
-        syncNextTracker();
+        pSyncCoordinator->start(mBackendList, SyncCoordinator::UPLOAD);
     }
 }
 
@@ -1075,6 +1113,9 @@ void
 MainWindow::quitEvent()
 {
     qDebug() << "quitEvent";
+    qDebug() << "Prepared statement cache:\n" << qPrintable(SqlStatementCache::report());
+    if (SqlProfiler::enabled())
+        qDebug() << qPrintable(SqlProfiler::report());
     if (isVisible())
     {
         QSettings settings("Entomologist");
@@ -1173,7 +1214,6 @@ MainWindow::showEditMonitoredComponents()
                 else
                     b->setMonitorComponents(components.split(","));
                 b->setLastSync("1970-01-01T12:13:14");
-                mSyncPosition = mBackendList.size();
                 syncTracker(b);
             }
         }
@@ -1199,7 +1239,16 @@ MainWindow::changeEvent(QEvent *e)
 void
 MainWindow::toggleButtons()
 {
-    if (!SqlUtilities::hasPendingChanges())
+    mPendingChangesRequest = pReader->hasPendingChanges();
+}
+
+void
+MainWindow::pendingChangesLoaded(SqlReadResult result)
+{
+    if (result.id != mPendingChangesRequest)
+        return;
+
+    if (!result.flag)
     {
         uploadButton->setEnabled(false);
         changelogButton->setEnabled(false);
@@ -1271,7 +1320,11 @@ MainWindow::backendError(const QString &message)
         if (pDetectorProgress->isVisible())
             pDetectorProgress->reset();
     ErrorHandler::handleError("An error occurred.", message);
-    bugsUpdated();
+
+    // Sync errors are counted by the coordinator; anything else (like a
+    // failed version check) just needs the spinner stopped
+    if (!pSyncCoordinator->isActive())
+        stopAnimation();
 }
 
 // When the user edits tracker information, this is called to save their new
@@ -1312,7 +1365,7 @@ MainWindow::updateTracker(const QString &id, QMap<QString, QString> data, bool u
         QString oldName, newName;
         oldName = b->name();
         newName = data["name"];
-        ui->trackerTab->setTabText(ui->trackerTab->currentIndex(), newName);
+        ui->trackerTab->setTrackerName(ui->trackerTab->currentIndex(), newName);
         pSearchTab->renameTracker(oldName, newName);
         b->setName(newName);
         QSettings settings("Entomologist");
@@ -1353,10 +1406,13 @@ MainWindow::deleteTracker(const QString &id)
         }
     }
 
+    pSyncScheduler->removeBackend(b);
+    pSyncCoordinator->remove(b);
     QString name = b->name();
     SqlUtilities::removeTracker(b->id(), name);
     pSearchTab->removeTracker(b);
     delete b; // This removes the tab as well, as the widget is destroyed
+    pAllBugsTab->reloadFromDatabase();
 
     QSettings settings("Entomologist");
     settings.remove(QString("%1-sort-column").arg(name));
@@ -1374,19 +1430,32 @@ MainWindow::fieldsChecked()
 void
 MainWindow::setTimer()
 {
-    QSettings settings("Entomologist");
-    bool update = settings.value("update-automatically", false).toBool();
-    int interval = settings.value("update-interval", 2).toInt();
-    if (interval < 2)
-        interval = 2;
-
-    // interval is in hours, so convert it to msec
-    int timeout = interval * 60 * 60 * 1000;
-    pUpdateTimer->setInterval(timeout);
-    if (update)
-        pUpdateTimer->start();
-    else
-        pUpdateTimer->stop();
+    pSyncScheduler->reloadSettings();
+}
+
+// Called by the scheduler when trackers are due for an automatic sync
+void
+MainWindow::syncDue(QList<Backend *> backends)
+{
+    if (!isOnline())
+        return;
+
+    pSyncCoordinator->start(backends, SyncCoordinator::SYNC);
+}
+
+// Tabs the user looks at often are synced more often
+void
+MainWindow::trackerTabChanged(int index)
+{
+    QWidget *widget = ui->trackerTab->widget(index);
+    for (int i = 0; i < mBackendList.size(); ++i)
+    {
+        if (mBackendList.at(i)->displayWidget() == widget)
+        {
+            pSyncScheduler->tabViewed(mBackendList.at(i));
+            return;
+        }
+    }
 }
 
 void
@@ -1427,7 +1496,11 @@ MainWindow::showMenu(int tabIndex)
         return;
     }
 
-    QString trackerName = ui->trackerTab->tabText(tabIndex);
+    // The All Bugs tab doesn't belong to a tracker
+    if (tabIndex == ui->trackerTab->indexOf(pAllBugsTab))
+        return;
+
+    QString trackerName = ui->trackerTab->trackerName(tabIndex);
     Backend *b = NULL;
     for (int i = 0; i < mBackendList.size(); ++i)
     {
@@ -1473,7 +1546,6 @@ MainWindow::showMenu(int tabIndex)
     }
     else if (a == resyncAction)
     {
-        mSyncPosition = mBackendList.size();
         syncTracker(b);
     }
 }
@@ -1521,7 +1593,7 @@ MainWindow::compareTabName(QString compareItem)
     int ret = -1;
     for(int i = 0; i < ui->trackerTab->count(); i++)
     {
-        if(QString::compare(compareItem,ui->trackerTab->tabText(i)) == 0)
+        if(QString::compare(compareItem,ui->trackerTab->trackerName(i)) == 0)
         {
             ret = i;
             break;
@@ -1539,12 +1611,22 @@ MainWindow::openSearchedBug(const QString &trackerName,
         Backend *b = mBackendList.at(i);
         if (b->name() == trackerName)
         {
-            qDebug() << "openSearchedBug: mSyncRequests is now " << mSyncRequests;
             b->displayWidget()->loadSearchResult(bugId);
         }
     }
 }
 
+// Called from the All Bugs tab, which passes the bug on to the tab
+// of the tracker it belongs to
+void
+MainWindow::openAllBugsRow(const QString &trackerId,
+                           const QString &rowId)
+{
+    Backend *b = mBackendMap.value(trackerId, NULL);
+    if (b != NULL)
+        b->displayWidget()->showBugDetails(rowId);
+}
+
 void
 MainWindow::checkForUpdates()
 {
@@ -1605,6 +1687,48 @@ MainWindow::toggleXmlRpcLogging()
     box.exec();
 }
 
+// Hidden debug dialog for the SQL profiler.  The first time it's used
+// without --profile-sql it just turns profiling on.
+void
+MainWindow::showSqlProfile()
+{
+    if (!SqlProfiler::enabled())
+    {
+        SqlProfiler::setEnabled(true);
+        QMessageBox box;
+        box.setText("Enabling SQL profiling");
+        box.setIcon(QMessageBox::Information);
+        box.setStandardButtons(QMessageBox::Ok);
+        box.exec();
+        return;
+    }
+
+    QDialog dlg(this);
+    dlg.setWindowTitle("SQL Profile");
+    QVBoxLayout *layout = new QVBoxLayout(&dlg);
+    QPlainTextEdit *text = new QPlainTextEdit(SqlProfiler::report(), &dlg);
+    text->setReadOnly(true);
+    text->setLineWrapMode(QPlainTextEdit::NoWrap);
+    text->setFont(QFont("Monospace"));
+    layout->addWidget(text);
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Save
+                                                     | QDialogButtonBox::Close,
+                                                     Qt::Horizontal,
+                                                     &dlg);
+    layout->addWidget(buttons);
+    connect(buttons, SIGNAL(accepted()), &dlg, SLOT(accept()));
+    connect(buttons, SIGNAL(rejected()), &dlg, SLOT(reject()));
+    dlg.resize(900, 500);
+    if (dlg.exec() == QDialog::Accepted)
+    {
+        QString fileName = QFileDialog::getSaveFileName(this,
+                                                        "Save SQL Profile",
+                                                        QDir::homePath() + QDir::separator() + "entomologist-sql.txt");
+        if (!fileName.isEmpty())
+            SqlProfiler::dumpReport(fileName);
+    }
+}
+
 // TODO implement this?
 void
 MainWindow::handleSslErrors(QNetworkReply *reply,
@@ -33,6 +33,8 @@
 #include <QSslError>
 #include <QTableView>
 
+#include "SqlReaderThread.h"
+
 namespace Ui {
     class MainWindow;
 }
@@ -45,7 +47,6 @@ class QLabel;
 class QNetworkAccessManager;
 class QSpacerItem;
 class QProgressDialog;
-class QTimer;
 class SearchTab;
 class QSqlDatabase;
 class Backend;
@@ -53,6 +54,11 @@ class Autodetector;
 class SqlBugModel;
 class BackendUI;
 class ToDoListWidget;
+class AllBugsUI;
+class SqlMaintenance;
+class SqlReader;
+class SyncCoordinator;
+class SyncScheduler;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -78,6 +84,7 @@ public slots:
     void trayActivated(QSystemTrayIcon::ActivationReason reason);
     void addTrackerTriggered();
     void toggleButtons();
+    void pendingChangesLoaded(SqlReadResult result);
     void showMenu(int tabIndex);
     void prefsTriggered();
     void websiteTriggered();
@@ -88,7 +95,13 @@ public slots:
     void showEditMonitoredComponents();
     void iconDownloaded();
     void htmlIconDownloaded();
-    void bugsUpdated();
+    void startAnimation();
+    void stopAnimation();
+    void syncFinished();
+    void syncProgress(int done,
+                      int total);
+    void syncDue(QList<Backend *> backends);
+    void trackerTabChanged(int index);
     void filterTable();
     void finishedDetecting(QMap<QString, QString> data);
     void resync();
@@ -97,8 +110,11 @@ public slots:
     void backendError(const QString &message);
     void searchFocusTriggered();
     void toggleXmlRpcLogging();
+    void showSqlProfile();
     void openSearchedBug(const QString &trackerName,
                          const QString &bugId);
+    void openAllBugsRow(const QString &trackerId,
+                        const QString &rowId);
 protected:
     void changeEvent(QEvent *e);
     void showEvent(QShowEvent *e);
@@ -115,9 +131,8 @@ private:
     void syncTracker(Backend *tracker);
     void setupTrayIcon();
     void notifyUser();
+    void updateTrackerBadges();
     void checkVersion(Backend *b);
-    void startAnimation();
-    void stopAnimation();
     void loadTrackers();
     void addTracker(QMap<QString, QString> info);
     void addTrackerToList(Backend *newTracker, bool sync = false);
@@ -130,10 +145,6 @@ private:
     QAction *refreshButton, *uploadButton, *changelogButton;
     QString getChangelog();
     QString autodetectTracker(const QString &url);
-    void syncNextTracker();
-    int mSyncRequests;
-    int mSyncPosition;
-    bool mUploading;
     QMap<QString, Backend*> mBackendMap;
     QList<Backend *> mBackendList;
     QString mDbPath;
@@ -147,11 +158,16 @@ private:
     QNetworkAccessManager *pManager;
     QProgressDialog *pDetectorProgress;
     QSpacerItem *pCommentSpacer;
-    QTimer *pUpdateTimer;
     QSystemTrayIcon *pTrayIcon;
     QMenu *pTrayIconMenu;
     QDockWidget *pToDoDock;
     SearchTab *pSearchTab;
+    AllBugsUI *pAllBugsTab;
+    SqlMaintenance *pMaintenance;
+    SqlReader *pReader;
+    SyncCoordinator *pSyncCoordinator;
+    SyncScheduler *pSyncScheduler;
+    int mPendingChangesRequest;
     ToDoListWidget *pToDoListWidget;
     Ui::MainWindow *ui;
     QList<BackendUI*> trackerTabsList;
@@ -32,6 +32,7 @@
 #include "trackers/Mantis.h"
 #include "trackers/Trac.h"
 #include "SqlUtilities.h"
+#include "SqlReader.h"
 #include "ErrorHandler.h"
 #include "MonitorDialog.h"
 #include "ui_MonitorDialog.h"
@@ -42,6 +43,9 @@ MonitorDialog::MonitorDialog(QWidget *parent) :
 {
     mRequests = 0;
     mComponentCount = 0;
+    pReader = new SqlReader(this);
+    connect(pReader, SIGNAL(finished(SqlReadResult)),
+            this, SLOT(componentsLoaded(SqlReadResult)));
     ui->setupUi(this);
     ui->okButton->setIcon(style()->standardIcon(QStyle::SP_DialogOkButton));
     ui->cancelButton->setIcon(style()->standardIcon(QStyle::SP_DialogCancelButton));
@@ -235,7 +239,17 @@ void
 MonitorDialog::componentsFound()
 {
     Backend *backend = qobject_cast<Backend*>(sender());
-    QStringList components = SqlUtilities::fieldValues(backend->id(), "component");
+    mComponentRequests[pReader->fieldValues(backend->id(), "component")] = backend;
+}
+
+void
+MonitorDialog::componentsLoaded(SqlReadResult result)
+{
+    Backend *backend = mComponentRequests.take(result.id);
+    if (backend == NULL)
+        return;
+
+    QStringList components = result.values;
     QVariant backendVariant;
     backendVariant.setValue(backend);
     QString type = backend->type();
@@ -4,10 +4,13 @@
 #include <QDialog>
 #include <QMap>
 
+#include "SqlReaderThread.h"
+
 class QMovie;
 class QListWidgetItem;
 class QTreeWidgetItem;
 class Backend;
+class SqlReader;
 
 namespace Ui {
     class MonitorDialog;
@@ -31,6 +34,7 @@ public:
 public slots:
     void itemExpanded(QTreeWidgetItem *item);
     void componentsFound();
+    void componentsLoaded(SqlReadResult result);
     void backendError(const QString &msg);
     void okClicked();
 
@@ -49,6 +53,8 @@ private:
     Ui::MonitorDialog *ui;
     QMovie *pSpinnerMovie;
     QMap<QString, QTreeWidgetItem *> mTreeMap;
+    SqlReader *pReader;
+    QMap<int, Backend *> mComponentRequests;
     int mRequests;
 };
 
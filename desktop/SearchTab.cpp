@@ -33,6 +33,7 @@ SearchTab::SearchTab(QWidget *parent) :
     }
 
     ui->trackerCombo->addItem("All Trackers");
+    ui->remoteCheckBox->setChecked(settings.value("search-online", true).toBool());
 
     pModel = new SqlSearchModel(this);
     pModel->setTable("search_results");
@@ -105,14 +106,23 @@ SearchTab::searchButtonClicked()
         return;
 
     SqlUtilities::clearSearch();
-    ui->searchWidget->hide();
-    ui->searchSpinnerWidget->show();
-    pSpinnerMovie->start();
-    mSearchCount = 0;
     int index = ui->trackerCombo->currentIndex();
     QString selected = ui->trackerCombo->currentText();
     QSettings settings("Entomologist");
     settings.setValue("last-search-query", search);
+    settings.setValue("search-online", ui->remoteCheckBox->isChecked());
+
+    // Show whatever is already cached straight away.  The remote results
+    // are merged in as each tracker answers.
+    int found = SqlUtilities::localSearch(search, (index == 0) ? QString() : selected);
+    pModel->select();
+    if ((found >= 0) && !ui->remoteCheckBox->isChecked())
+        return;
+
+    ui->searchWidget->hide();
+    ui->searchSpinnerWidget->show();
+    pSpinnerMovie->start();
+    mSearchCount = 0;
 
     QMapIterator<QString, Backend*> i(mIdMap);
     while (i.hasNext())
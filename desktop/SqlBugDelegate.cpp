@@ -29,6 +29,7 @@
 #include "SqlBugDelegate.h"
 #include "SqlUtilities.h"
 SqlBugDelegate::SqlBugDelegate()
+    : mTimestampColumn(-1)
 {
 }
 
@@ -42,6 +43,8 @@ SqlBugDelegate::paint(QPainter *painter,
 {
     QStyleOptionViewItemV4 optionV4 = option;
     initStyleOption(&optionV4, index);
+    if (index.column() == mTimestampColumn)
+        optionV4.text = SqlUtilities::formatEpoch(index.data());
 
     QStyle *style = optionV4.widget? optionV4.widget->style() : QApplication::style();
 
@@ -68,3 +71,17 @@ SqlBugDelegate::paint(QPainter *painter,
         doc.documentLayout()->draw(painter, ctx);
     painter->restore();
 }
+
+QSize
+SqlBugDelegate::sizeHint(const QStyleOptionViewItem &option,
+                         const QModelIndex &index) const
+{
+    if (index.column() != mTimestampColumn)
+        return QStyledItemDelegate::sizeHint(option, index);
+
+    QStyleOptionViewItemV4 optionV4 = option;
+    initStyleOption(&optionV4, index);
+    optionV4.text = SqlUtilities::formatEpoch(index.data());
+    QStyle *style = optionV4.widget? optionV4.widget->style() : QApplication::style();
+    return style->sizeFromContents(QStyle::CT_ItemViewItem, &optionV4, QSize(), optionV4.widget);
+}
@@ -32,6 +32,14 @@ Q_OBJECT
 public:
     SqlBugDelegate();
     void paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const;
+    QSize sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const;
+
+    // The column holding last_modified, which is stored as an epoch
+    // and formatted here for display
+    void setTimestampColumn(int column) { mTimestampColumn = column; }
+
+private:
+    int mTimestampColumn;
 };
 
 #endif // SQLBUGDELEGATE_H
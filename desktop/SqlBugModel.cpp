@@ -27,8 +27,11 @@
 #include "SqlUtilities.h"
 #include <QPixmap>
 #include <QDebug>
+#include <QTime>
 
 #include "SqlBugModel.h"
+#include "SqlProfiler.h"
+#include "SqlWatchdog.h"
 
 // We just subclass here so we can set custom queries
 
@@ -65,3 +68,26 @@ SqlBugModel::data(const QModelIndex &item,
 
      return value;
 }
+
+// The tracker tabs build their queries by hand, so they get profiled here
+void
+SqlBugModel::setQuery(const QString &query,
+                      const QSqlDatabase &db)
+{
+    SQL_WATCHDOG(query);
+    if (!SqlProfiler::enabled())
+    {
+        QSqlQueryModel::setQuery(query, db);
+        return;
+    }
+
+    QTime timer;
+    timer.start();
+    QSqlQueryModel::setQuery(query, db);
+    QSqlQuery q = QSqlQueryModel::query();
+    int rows = SqlProfiler::countRows(q);
+    SqlProfiler::record(query,
+                        timer.elapsed(),
+                        rows,
+                        db.isValid() ? db : QSqlDatabase::database());
+}
@@ -33,6 +33,8 @@ class SqlBugModel : public QSqlQueryModel
 public:
     SqlBugModel(QObject *parent = 0);
     QVariant data(const QModelIndex &item, int role) const;
+    void setQuery(const QString &query,
+                  const QSqlDatabase &db = QSqlDatabase());
 };
 
 #endif // SQLBUGMODEL_H
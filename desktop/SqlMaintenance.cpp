@@ -0,0 +1,104 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDateTime>
+#include <QSettings>
+#include <QTimer>
+#include <QDebug>
+
+#include "SqlMaintenance.h"
+#include "SqlUtilities.h"
+#include "SqlWriterThread.h"
+
+SqlMaintenance::SqlMaintenance(QObject *parent) :
+    QObject(parent)
+{
+    QSettings settings("Entomologist");
+    mSyncActive = false;
+    pTimer = new QTimer(this);
+    pTimer->setInterval(settings.value("db-maintenance-interval", 300).toInt() * 1000);
+    connect(pTimer, SIGNAL(timeout()),
+            this, SLOT(runMaintenance()));
+    pTimer->start();
+
+    // An older database is switched to incremental auto_vacuum now rather
+    // than from the timer, and not at all if that has failed before
+    if (!settings.value("db-auto-vacuum-failed", false).toBool())
+        enqueue(SqlUtilities::MAINTAIN_CONVERT);
+}
+
+SqlMaintenance::~SqlMaintenance()
+{
+}
+
+void
+SqlMaintenance::setSyncActive(bool active)
+{
+    mSyncActive = active;
+}
+
+// Returns true, and resets the clock, if more than intervalSecs have
+// passed since the setting was last stamped
+bool
+SqlMaintenance::isDue(const QString &settingName, int intervalSecs)
+{
+    QSettings settings("Entomologist");
+    QDateTime last = settings.value(settingName, QDateTime()).toDateTime();
+    QDateTime now = QDateTime::currentDateTime();
+    if (last.isValid() && (last.secsTo(now) < intervalSecs))
+        return false;
+
+    settings.setValue(settingName, now);
+    return true;
+}
+
+void
+SqlMaintenance::runMaintenance()
+{
+    if (mSyncActive)
+        return;
+
+    QSettings settings("Entomologist");
+    int tasks = SqlUtilities::MAINTAIN_VACUUM;
+    if (isDue("db-last-analyze", settings.value("db-analyze-interval", 86400).toInt()))
+        tasks |= SqlUtilities::MAINTAIN_ANALYZE;
+    if (isDue("db-last-integrity-check", settings.value("db-integrity-check-interval", 604800).toInt()))
+        tasks |= SqlUtilities::MAINTAIN_INTEGRITY;
+    if (isDue("db-last-search-prune", settings.value("search-prune-interval", 3600).toInt()))
+        tasks |= SqlUtilities::MAINTAIN_PRUNE_SEARCHES;
+    enqueue(tasks);
+}
+
+// Queued behind any sync data, and run on its own rather than grouped
+// into another request's transaction
+void
+SqlMaintenance::enqueue(int tasks)
+{
+    QSettings settings("Entomologist");
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::MAINTENANCE;
+    request.priority = SqlWriterThread::PRIORITY_LOW;
+    request.operation = tasks;
+    request.id = settings.value("db-vacuum-slice-pages", 256).toInt();
+    SqlWriterThread::instance()->enqueue(request);
+}
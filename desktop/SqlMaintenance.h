@@ -0,0 +1,57 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLMAINTENANCE_H
+#define SQLMAINTENANCE_H
+
+#include <QObject>
+
+class QTimer;
+
+// Keeps the cache database in shape while nothing is syncing.  Each time
+// the timer fires and the application is idle, one maintenance request is
+// queued on the writer thread: it reclaims a bounded number of free pages,
+// and every so often refreshes the planner statistics or checks integrity.
+// A database from before incremental auto_vacuum is converted once, when
+// this starts.
+class SqlMaintenance : public QObject
+{
+Q_OBJECT
+public:
+    explicit SqlMaintenance(QObject *parent = 0);
+    ~SqlMaintenance();
+
+public slots:
+    // MainWindow calls this as syncs and uploads start and finish
+    void setSyncActive(bool active);
+    void runMaintenance();
+
+private:
+    bool isDue(const QString &settingName, int intervalSecs);
+    void enqueue(int tasks);
+
+    QTimer *pTimer;
+    bool mSyncActive;
+};
+
+#endif // SQLMAINTENANCE_H
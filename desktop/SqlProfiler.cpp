@@ -0,0 +1,283 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#include <QDebug>
+#include <QFile>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QSettings>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QStringList>
+#include <QTextStream>
+#include <QTime>
+#include <QVariant>
+#include "SqlProfiler.h"
+#include "SqlWatchdog.h"
+
+bool SqlProfiler::sEnabled = false;
+QMutex SqlProfiler::sMutex;
+QHash<QString, SqlProfiler::Entry> SqlProfiler::sEntries;
+
+bool
+SqlProfiler::enabled()
+{
+    return sEnabled;
+}
+
+void
+SqlProfiler::setEnabled(bool enabled)
+{
+    sEnabled = enabled;
+}
+
+bool
+SqlProfiler::exec(QSqlQuery &query,
+                  QSqlDatabase db)
+{
+    SQL_WATCHDOG(query.lastQuery());
+    if (!sEnabled)
+        return query.exec();
+
+    QTime timer;
+    timer.start();
+    bool ret = query.exec();
+    int rows = ret ? countRows(query) : -1;
+    store(query.lastQuery(), timer.elapsed(), rows, query.boundValues().size(), db);
+    return ret;
+}
+
+bool
+SqlProfiler::exec(QSqlQuery &query,
+                  const QString &sql,
+                  QSqlDatabase db)
+{
+    SQL_WATCHDOG(sql);
+    if (!sEnabled)
+        return query.exec(sql);
+
+    QTime timer;
+    timer.start();
+    bool ret = query.exec(sql);
+    int rows = ret ? countRows(query) : -1;
+    store(sql, timer.elapsed(), rows, 0, db);
+    return ret;
+}
+
+bool
+SqlProfiler::execBatch(QSqlQuery &query,
+                       QSqlDatabase db)
+{
+    SQL_WATCHDOG(query.lastQuery());
+    if (!sEnabled)
+        return query.execBatch();
+
+    QTime timer;
+    timer.start();
+    bool ret = query.execBatch();
+    int rows = ret ? query.numRowsAffected() : -1;
+    store(query.lastQuery(), timer.elapsed(), rows, query.boundValues().size(), db);
+    return ret;
+}
+
+void
+SqlProfiler::record(const QString &sql,
+                    int elapsed,
+                    int rows,
+                    QSqlDatabase db)
+{
+    if (sEnabled)
+        store(sql, elapsed, rows, 0, db);
+}
+
+int
+SqlProfiler::countRows(QSqlQuery &query)
+{
+    if (!query.isActive())
+        return -1;
+    if (!query.isSelect())
+        return query.numRowsAffected();
+    if (query.isForwardOnly())
+        return -1;
+
+    // SQLite doesn't know how many rows a SELECT has until it's been
+    // stepped through, so this is where most of the cost of a big read is
+    int rows = 0;
+    if (query.last())
+        rows = query.at() + 1;
+    query.seek(QSql::BeforeFirstRow);
+    return rows;
+}
+
+void
+SqlProfiler::store(const QString &sql,
+                   int elapsed,
+                   int rows,
+                   int placeholders,
+                   QSqlDatabase db)
+{
+    QString key = normalize(sql);
+    bool needsPlan = false;
+    {
+        QMutexLocker locker(&sMutex);
+        Entry &entry = sEntries[key];
+        entry.calls++;
+        entry.totalMs += elapsed;
+        if (elapsed > entry.maxMs)
+            entry.maxMs = elapsed;
+        if (rows > 0)
+            entry.rows += rows;
+        needsPlan = entry.plan.isEmpty() && elapsed > threshold();
+    }
+
+    if (!needsPlan)
+        return;
+
+    // The plan is captured on the connection the statement ran on, which
+    // is only ever used by this thread, and outside the lock so that a slow
+    // EXPLAIN doesn't hold up the other threads
+    QString plan = explain(sql, placeholders, db);
+    qDebug() << "SqlProfiler: " << elapsed << "ms: " << key;
+    QMutexLocker locker(&sMutex);
+    sEntries[key].plan = plan;
+}
+
+// Folds statements that only differ in their literals together, so that
+// the per-bug queries the tracker UIs build with arg() show up as one entry
+QString
+SqlProfiler::normalize(const QString &sql)
+{
+    QString ret = sql.simplified();
+    ret.replace(QRegExp("'([^']|'')*'"), "?");
+    ret.replace(QRegExp("\\b\\d+(\\.\\d+)?\\b"), "?");
+    ret.replace(QRegExp("\\?(\\s*,\\s*\\?)+"), "?, ...");
+    return ret;
+}
+
+QString
+SqlProfiler::explain(const QString &sql,
+                     int placeholders,
+                     QSqlDatabase db)
+{
+    QString statement = sql.trimmed();
+    if (!statement.startsWith("SELECT", Qt::CaseInsensitive)
+        && !statement.startsWith("WITH", Qt::CaseInsensitive))
+        return QString("(no plan captured for %1)").arg(statement.section(' ', 0, 0).toUpper());
+
+    // The plan doesn't depend on the bound values, so NULLs will do
+    QSqlQuery q(db);
+    if (!q.prepare("EXPLAIN QUERY PLAN " + statement))
+        return QString("(EXPLAIN failed: %1)").arg(q.lastError().text());
+    for (int i = 0; i < placeholders; ++i)
+        q.bindValue(i, QVariant());
+    if (!q.exec())
+        return QString("(EXPLAIN failed: %1)").arg(q.lastError().text());
+
+    // The last column is the detail text, whatever the SQLite version
+    QStringList lines;
+    int detail = q.record().count() - 1;
+    while (q.next())
+        lines << q.value(detail).toString();
+    return lines.join("\n");
+}
+
+int
+SqlProfiler::threshold()
+{
+    static int threshold = -1;
+    if (threshold < 0)
+    {
+        QSettings settings("Entomologist");
+        threshold = settings.value("sql-profiler-threshold", 20).toInt();
+    }
+    return threshold;
+}
+
+QString
+SqlProfiler::report()
+{
+    QMutexLocker locker(&sMutex);
+    QMultiMap<qint64, QString> byTotal;
+    QHashIterator<QString, Entry> i(sEntries);
+    while (i.hasNext())
+    {
+        i.next();
+        byTotal.insert(i.value().totalMs, i.key());
+    }
+
+    QStringList lines;
+    lines << QString("SQL profile: %1 statements, slow threshold %2ms")
+             .arg(sEntries.size())
+             .arg(threshold());
+    lines << QString("%1 %2 %3 %4 %5  sql")
+             .arg("calls", 7)
+             .arg("total ms", 9)
+             .arg("max ms", 7)
+             .arg("avg ms", 7)
+             .arg("rows", 9);
+
+    // Slowest first
+    QMapIterator<qint64, QString> j(byTotal);
+    j.toBack();
+    while (j.hasPrevious())
+    {
+        j.previous();
+        const Entry &entry = sEntries[j.value()];
+        lines << QString("%1 %2 %3 %4 %5  %6")
+                 .arg(entry.calls, 7)
+                 .arg(entry.totalMs, 9)
+                 .arg(entry.maxMs, 7)
+                 .arg(double(entry.totalMs) / entry.calls, 7, 'f', 1)
+                 .arg(entry.rows, 9)
+                 .arg(j.value());
+        if (!entry.plan.isEmpty())
+        {
+            QStringList plan = entry.plan.split("\n");
+            for (int k = 0; k < plan.size(); ++k)
+                lines << QString("%1  plan: %2").arg("", 43).arg(plan.at(k));
+        }
+    }
+    return lines.join("\n");
+}
+
+bool
+SqlProfiler::dumpReport(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        qDebug() << "SqlProfiler: could not write the report to " << fileName << ": " << file.errorString();
+        return false;
+    }
+
+    QTextStream out(&file);
+    out << report() << "\n";
+    return true;
+}
+
+void
+SqlProfiler::reset()
+{
+    QMutexLocker locker(&sMutex);
+    sEntries.clear();
+}
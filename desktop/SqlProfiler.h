@@ -0,0 +1,98 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#ifndef SQLPROFILER_H
+#define SQLPROFILER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+// Opt-in record of where the time goes in SQL.  Statements are grouped by
+// their normalized text (literals replaced with ?), and any SELECT that takes
+// longer than the sql-profiler-threshold setting (in ms, default 20) has its
+// EXPLAIN QUERY PLAN saved alongside it.  Turned on by the sql-profiler
+// setting or --profile-sql; when it's off every call is a plain exec().
+class SqlProfiler
+{
+public:
+    static bool enabled();
+    static void setEnabled(bool enabled);
+
+    // Equivalent to query.exec(), query.exec(sql) and query.execBatch().
+    // db has to be the connection the query was created on.  SELECTs that
+    // aren't forward-only are read to the end to count their rows, and are
+    // left positioned before the first row.
+    static bool exec(QSqlQuery &query,
+                     QSqlDatabase db = QSqlDatabase::database());
+    static bool exec(QSqlQuery &query,
+                     const QString &sql,
+                     QSqlDatabase db = QSqlDatabase::database());
+    static bool execBatch(QSqlQuery &query,
+                          QSqlDatabase db = QSqlDatabase::database());
+
+    // For callers that run their own SQL (the table models).  rows is -1
+    // if it isn't known.
+    static void record(const QString &sql,
+                       int elapsed,
+                       int rows,
+                       QSqlDatabase db = QSqlDatabase::database());
+
+    // Reads an active SELECT to the end and rewinds it, returning the row
+    // count, or -1 for forward-only queries.
+    static int countRows(QSqlQuery &query);
+
+    static QString report();
+    static bool dumpReport(const QString &fileName);
+    static void reset();
+
+private:
+    struct Entry
+    {
+        Entry() : calls(0), totalMs(0), maxMs(0), rows(0) {}
+        int calls;
+        qint64 totalMs;
+        int maxMs;
+        qint64 rows;
+        QString plan;
+    };
+
+    static void store(const QString &sql,
+                      int elapsed,
+                      int rows,
+                      int placeholders,
+                      QSqlDatabase db);
+    static QString normalize(const QString &sql);
+    static QString explain(const QString &sql,
+                           int placeholders,
+                           QSqlDatabase db);
+    static int threshold();
+
+    static bool sEnabled;
+    static QMutex sMutex;
+    static QHash<QString, Entry> sEntries;
+};
+
+#endif // SQLPROFILER_H
@@ -0,0 +1,95 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include "SqlReader.h"
+
+SqlReader::SqlReader(QObject *parent) :
+    QObject(parent)
+{
+    SqlReaderThread *thread = SqlReaderThread::instance();
+    mClientId = thread->registerClient();
+    connect(thread, SIGNAL(requestFinished(quint64, SqlReadResult)),
+            this, SLOT(requestFinished(quint64, SqlReadResult)),
+            Qt::QueuedConnection);
+}
+
+SqlReader::~SqlReader()
+{
+}
+
+int
+SqlReader::enqueue(SqlReadRequest &request)
+{
+    request.clientId = mClientId;
+    return SqlReaderThread::instance()->enqueue(request);
+}
+
+int
+SqlReader::loadBugComments(const QString &table,
+                           const QString &trackerId,
+                           const QString &bugId)
+{
+    SqlReadRequest request;
+    request.type = SqlReadRequest::BUG_COMMENTS;
+    request.table = table;
+    request.trackerId = trackerId;
+    request.bugId = bugId;
+    return enqueue(request);
+}
+
+int
+SqlReader::hasPendingChanges()
+{
+    SqlReadRequest request;
+    request.type = SqlReadRequest::PENDING_CHANGES;
+    return enqueue(request);
+}
+
+int
+SqlReader::fieldValues(const QString &trackerId, const QString &fieldName)
+{
+    SqlReadRequest request;
+    request.type = SqlReadRequest::FIELD_VALUES;
+    request.trackerId = trackerId;
+    request.field = fieldName;
+    return enqueue(request);
+}
+
+int
+SqlReader::assignedToValues(const QString &table, const QString &trackerId)
+{
+    SqlReadRequest request;
+    request.type = SqlReadRequest::ASSIGNED_TO_VALUES;
+    request.table = table;
+    request.trackerId = trackerId;
+    return enqueue(request);
+}
+
+void
+SqlReader::requestFinished(quint64 clientId, SqlReadResult result)
+{
+    if (clientId != mClientId)
+        return;
+
+    emit finished(result);
+}
@@ -0,0 +1,61 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLREADER_H
+#define SQLREADER_H
+
+#include <QObject>
+
+#include "SqlReaderThread.h"
+
+// The asynchronous counterpart of the SqlUtilities read helpers.  Each
+// call queues the read on the shared SqlReaderThread and returns the id
+// that the matching finished() signal will carry.
+class SqlReader : public QObject
+{
+Q_OBJECT
+public:
+    SqlReader(QObject *parent = 0);
+    ~SqlReader();
+
+    // Description, comments, shadow comments and attachments of one bug
+    int loadBugComments(const QString &table,
+                        const QString &trackerId,
+                        const QString &bugId);
+    int hasPendingChanges();
+    int fieldValues(const QString &trackerId, const QString &fieldName);
+    int assignedToValues(const QString &table, const QString &trackerId);
+
+signals:
+    void finished(SqlReadResult result);
+
+private slots:
+    void requestFinished(quint64 clientId, SqlReadResult result);
+
+private:
+    int enqueue(SqlReadRequest &request);
+
+    quint64 mClientId;
+};
+
+#endif // SQLREADER_H
@@ -0,0 +1,144 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QCoreApplication>
+#include <QSqlError>
+#include <QDebug>
+#include "SqlReaderThread.h"
+#include "SqlUtilities.h"
+#include "SqlStatementCache.h"
+
+SqlReaderThread *
+SqlReaderThread::instance()
+{
+    static SqlReaderThread *reader = NULL;
+    if (reader == NULL)
+    {
+        qRegisterMetaType<SqlReadResult>("SqlReadResult");
+        reader = new SqlReaderThread(QCoreApplication::instance());
+        reader->start();
+    }
+    return reader;
+}
+
+SqlReaderThread::SqlReaderThread(QObject *parent) :
+    QThread(parent)
+{
+    mStopping = false;
+    mNextClientId = 1;
+    mNextRequestId = 1;
+}
+
+// Reads nobody is going to look at are dropped on exit
+SqlReaderThread::~SqlReaderThread()
+{
+    mMutex.lock();
+    mStopping = true;
+    mQueue.clear();
+    mCondition.wakeAll();
+    mMutex.unlock();
+    QThread::wait();
+}
+
+quint64
+SqlReaderThread::registerClient()
+{
+    QMutexLocker locker(&mMutex);
+    return mNextClientId++;
+}
+
+// Returns the id the result will carry
+int
+SqlReaderThread::enqueue(SqlReadRequest request)
+{
+    QMutexLocker locker(&mMutex);
+    request.id = mNextRequestId++;
+    mQueue.enqueue(request);
+    mCondition.wakeOne();
+    return request.id;
+}
+
+void
+SqlReaderThread::run()
+{
+    QString name = "entomologist-reader";
+    mDatabase = QSqlDatabase::cloneDatabase(QSqlDatabase::database(QSqlDatabase::defaultConnection, false), name);
+    if (!mDatabase.open())
+        qDebug() << "SqlReaderThread: Couldn't open " << name << ": " << mDatabase.lastError().text();
+    else
+        SqlUtilities::configureConnection(mDatabase);
+    qDebug() << "SqlReaderThread starting up...";
+
+    forever
+    {
+        mMutex.lock();
+        while (mQueue.isEmpty() && !mStopping)
+            mCondition.wait(&mMutex);
+
+        if (mStopping)
+        {
+            mMutex.unlock();
+            break;
+        }
+
+        SqlReadRequest request = mQueue.dequeue();
+        mMutex.unlock();
+
+        emit requestFinished(request.clientId, execute(request));
+    }
+
+    SqlStatementCache::clear(name);
+    mDatabase.close();
+    mDatabase = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
+}
+
+SqlReadResult
+SqlReaderThread::execute(const SqlReadRequest &request)
+{
+    SqlReadResult result;
+    result.type = request.type;
+    result.id = request.id;
+    switch (request.type)
+    {
+        case SqlReadRequest::BUG_COMMENTS:
+            result.text = SqlUtilities::getBugDescription(request.table, request.bugId, mDatabase);
+            result.comments = SqlUtilities::loadComments(request.trackerId, request.bugId, false, mDatabase);
+            result.shadowComments = SqlUtilities::loadComments(request.trackerId, request.bugId, true, mDatabase);
+            result.attachments = SqlUtilities::loadAttachments(request.trackerId, request.bugId, mDatabase);
+            break;
+        case SqlReadRequest::PENDING_CHANGES:
+            result.flag = SqlUtilities::hasPendingChanges(mDatabase);
+            break;
+        case SqlReadRequest::FIELD_VALUES:
+            result.values = SqlUtilities::fieldValues(request.trackerId, request.field, mDatabase);
+            break;
+        case SqlReadRequest::ASSIGNED_TO_VALUES:
+            result.values = SqlUtilities::assignedToValues(request.table, request.trackerId, mDatabase);
+            break;
+        default:
+            qDebug() << "SqlReaderThread: Unknown request type " << request.type;
+            break;
+    }
+    return result;
+}
@@ -0,0 +1,107 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLREADERTHREAD_H
+#define SQLREADERTHREAD_H
+
+#include <QThread>
+#include <QMap>
+#include <QStringList>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMetaType>
+#include <QSqlDatabase>
+
+// A single read queued by one of the SqlReader handles
+struct SqlReadRequest
+{
+    enum {
+        BUG_COMMENTS = 1,
+        PENDING_CHANGES,
+        FIELD_VALUES,
+        ASSIGNED_TO_VALUES
+    };
+
+    SqlReadRequest() : type(0), id(0), clientId(0) {}
+
+    int type;
+    int id;
+    quint64 clientId;
+    QString table;
+    QString trackerId;
+    QString bugId;
+    QString field;
+};
+
+// The rows a read produced.  Which members are filled in depends on the
+// request type.
+struct SqlReadResult
+{
+    SqlReadResult() : type(0), id(0), flag(false) {}
+
+    int type;
+    int id;
+    QString text;
+    QStringList values;
+    bool flag;
+    QList< QMap<QString, QString> > comments;
+    QList< QMap<QString, QString> > shadowComments;
+    QList< QMap<QString, QString> > attachments;
+};
+
+Q_DECLARE_METATYPE(SqlReadResult)
+
+// The process-wide database reader.  It runs the SqlUtilities read helpers
+// on its own connection, so the GUI thread never waits on SQLite while the
+// writer thread has a sync transaction open.  WAL lets the reads see the
+// last committed state without blocking on the writer.
+class SqlReaderThread : public QThread
+{
+Q_OBJECT
+public:
+    static SqlReaderThread *instance();
+
+    ~SqlReaderThread();
+    void run();
+
+    quint64 registerClient();
+    int enqueue(SqlReadRequest request);
+
+signals:
+    void requestFinished(quint64 clientId, SqlReadResult result);
+
+private:
+    SqlReaderThread(QObject *parent = 0);
+    SqlReadResult execute(const SqlReadRequest &request);
+
+    QSqlDatabase mDatabase;
+    QMutex mMutex;
+    QWaitCondition mCondition;
+    QQueue<SqlReadRequest> mQueue;
+    bool mStopping;
+    quint64 mNextClientId;
+    int mNextRequestId;
+};
+
+#endif // SQLREADERTHREAD_H
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDebug>
+#include "SqlRecordBatch.h"
+
+// Indexed by the COLUMN_* enum
+static const char *columnNames[SqlRecordBatch::COLUMN_COUNT] = {
+    "tracker_id",
+    "bug_id",
+    "highlight_type",
+    "severity",
+    "priority",
+    "assigned_to",
+    "status",
+    "summary",
+    "description",
+    "component",
+    "product",
+    "bug_type",
+    "bug_state",
+    "resolution",
+    "last_modified",
+    "milestone",
+    "version",
+    "category",
+    "project",
+    "product_version",
+    "reproducibility",
+    "os",
+    "os_version",
+    "comment_id",
+    "author",
+    "comment",
+    "timestamp",
+    "private",
+    "attachment_id",
+    "file_size",
+    "filename",
+    "content_type",
+    "creator",
+    "field_name",
+    "value",
+    "tracker_name"
+};
+
+SqlRecordBatch::SqlRecordBatch() :
+    mColumns(COLUMN_COUNT),
+    mRows(0)
+{
+}
+
+SqlRecordBatch
+SqlRecordBatch::fromMaps(const QList<QMap<QString, QString> > &list)
+{
+    SqlRecordBatch batch;
+    for (int i = 0; i < list.size(); ++i)
+    {
+        batch.appendRow();
+        QMapIterator<QString, QString> j(list.at(i));
+        while (j.hasNext())
+        {
+            j.next();
+            int column = columnId(j.key());
+            if (column == -1)
+            {
+                qDebug() << "SqlRecordBatch: Unknown column " << j.key();
+                continue;
+            }
+            batch.setValue(column, j.value());
+        }
+    }
+    return batch;
+}
+
+QString
+SqlRecordBatch::columnName(int column)
+{
+    if ((column < 0) || (column >= COLUMN_COUNT))
+        return QString();
+    return QString(columnNames[column]);
+}
+
+int
+SqlRecordBatch::columnId(const QString &name)
+{
+    for (int i = 0; i < COLUMN_COUNT; ++i)
+    {
+        if (name == QLatin1String(columnNames[i]))
+            return i;
+    }
+    return -1;
+}
+
+void
+SqlRecordBatch::appendRow()
+{
+    ++mRows;
+    for (int i = 0; i < mUsed.size(); ++i)
+        mColumns[mUsed.at(i)].append(QVariant());
+}
+
+void
+SqlRecordBatch::setValue(int column, const QVariant &value)
+{
+    Q_ASSERT(mRows > 0);
+    Q_ASSERT((column >= 0) && (column < COLUMN_COUNT));
+
+    // A column that's used for the first time has to be padded
+    // out with NULLs for the rows that came before it
+    QVariantList &values = mColumns[column];
+    if (!mUsed.contains(column))
+        mUsed << column;
+    while (values.size() < mRows)
+        values.append(QVariant());
+    values[mRows - 1] = value;
+}
+
+void
+SqlRecordBatch::setValues(int column, const QVariantList &values)
+{
+    Q_ASSERT(values.size() == mRows);
+    Q_ASSERT((column >= 0) && (column < COLUMN_COUNT));
+
+    if (!mUsed.contains(column))
+        mUsed << column;
+    mColumns[column] = values;
+}
+
+bool
+SqlRecordBatch::hasColumn(int column) const
+{
+    return mUsed.contains(column);
+}
+
+QStringList
+SqlRecordBatch::columnNames() const
+{
+    QStringList ret;
+    for (int i = 0; i < mUsed.size(); ++i)
+        ret << columnName(mUsed.at(i));
+    return ret;
+}
+
+QVariant
+SqlRecordBatch::value(int row, int column) const
+{
+    const QVariantList &values = mColumns.at(column);
+    if (row >= values.size())
+        return QVariant();
+    return values.at(row);
+}
+
+QVariantList
+SqlRecordBatch::values(int column) const
+{
+    QVariantList ret = mColumns.at(column);
+    while (ret.size() < mRows)
+        ret.append(QVariant());
+    return ret;
+}
+
+SqlRecordBatch
+SqlRecordBatch::rows(const QList<int> &rowList) const
+{
+    SqlRecordBatch ret;
+    ret.mUsed = mUsed;
+    ret.mRows = rowList.size();
+    for (int i = 0; i < mUsed.size(); ++i)
+    {
+        const QVariantList &source = mColumns.at(mUsed.at(i));
+        QVariantList &dest = ret.mColumns[mUsed.at(i)];
+        for (int j = 0; j < rowList.size(); ++j)
+            dest.append(source.at(rowList.at(j)));
+    }
+    return ret;
+}
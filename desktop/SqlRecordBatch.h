@@ -0,0 +1,119 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLRECORDBATCH_H
+#define SQLRECORDBATCH_H
+
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QStringList>
+#include <QVariant>
+#include <QVector>
+
+// A column-oriented set of rows headed for one of the cache tables.
+// Each column is kept as a QVariantList so it can be handed straight to
+// QSqlQuery::addBindValue() and run with execBatch().  The containers are
+// implicitly shared, so passing a batch to the writer thread doesn't copy
+// any of the row data.
+class SqlRecordBatch
+{
+public:
+    enum {
+        COLUMN_TRACKER_ID = 0,
+        COLUMN_BUG_ID,
+        COLUMN_HIGHLIGHT_TYPE,
+        COLUMN_SEVERITY,
+        COLUMN_PRIORITY,
+        COLUMN_ASSIGNED_TO,
+        COLUMN_STATUS,
+        COLUMN_SUMMARY,
+        COLUMN_DESCRIPTION,
+        COLUMN_COMPONENT,
+        COLUMN_PRODUCT,
+        COLUMN_BUG_TYPE,
+        COLUMN_BUG_STATE,
+        COLUMN_RESOLUTION,
+        COLUMN_LAST_MODIFIED,
+        COLUMN_MILESTONE,
+        COLUMN_VERSION,
+        COLUMN_CATEGORY,
+        COLUMN_PROJECT,
+        COLUMN_PRODUCT_VERSION,
+        COLUMN_REPRODUCIBILITY,
+        COLUMN_OS,
+        COLUMN_OS_VERSION,
+        COLUMN_COMMENT_ID,
+        COLUMN_AUTHOR,
+        COLUMN_COMMENT,
+        COLUMN_TIMESTAMP,
+        COLUMN_PRIVATE,
+        COLUMN_ATTACHMENT_ID,
+        COLUMN_FILE_SIZE,
+        COLUMN_FILENAME,
+        COLUMN_CONTENT_TYPE,
+        COLUMN_CREATOR,
+        COLUMN_FIELD_NAME,
+        COLUMN_VALUE,
+        COLUMN_TRACKER_NAME,
+        COLUMN_COUNT
+    };
+
+    SqlRecordBatch();
+
+    // Converts the QMap-per-row lists the backends used to build.
+    // Keys that don't name a known column are dropped.
+    static SqlRecordBatch fromMaps(const QList<QMap<QString, QString> > &list);
+
+    static QString columnName(int column);
+    static int columnId(const QString &name);
+
+    // Starts a new row.  setValue() always writes to the last row, and any
+    // column that isn't set on a row is NULL.
+    void appendRow();
+    void setValue(int column, const QVariant &value);
+    // Replaces a whole column, one value per row
+    void setValues(int column, const QVariantList &values);
+
+    int size() const { return mRows; }
+    bool isEmpty() const { return mRows == 0; }
+    bool hasColumn(int column) const;
+
+    // The columns that have been set, in the order they were first used
+    QList<int> columns() const { return mUsed; }
+    QStringList columnNames() const;
+
+    QVariant value(int row, int column) const;
+    QVariantList values(int column) const;
+
+    // A new batch holding just the given rows, in that order
+    SqlRecordBatch rows(const QList<int> &rowList) const;
+
+private:
+    QVector<QVariantList> mColumns;
+    QList<int> mUsed;
+    int mRows;
+};
+
+Q_DECLARE_METATYPE(SqlRecordBatch)
+
+#endif // SQLRECORDBATCH_H
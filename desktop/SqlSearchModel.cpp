@@ -26,8 +26,11 @@
 #include <QDir>
 #include <QPixmap>
 #include <QDebug>
+#include <QSqlQuery>
+#include <QTime>
 
 #include "SqlSearchModel.h"
+#include "SqlProfiler.h"
 
 SqlSearchModel::SqlSearchModel(QObject *parent)
     : QSqlTableModel(parent)
@@ -54,3 +57,18 @@ SqlSearchModel::data(const QModelIndex &item,
      }
      return value;
 }
+
+bool
+SqlSearchModel::select()
+{
+    if (!SqlProfiler::enabled())
+        return QSqlTableModel::select();
+
+    QTime timer;
+    timer.start();
+    bool ret = QSqlTableModel::select();
+    QSqlQuery q = query();
+    int rows = ret ? SqlProfiler::countRows(q) : -1;
+    SqlProfiler::record(selectStatement(), timer.elapsed(), rows, database());
+    return ret;
+}
@@ -33,6 +33,9 @@ class SqlSearchModel : public QSqlTableModel
 public:
     SqlSearchModel(QObject *parent = 0);
     QVariant data(const QModelIndex &item, int role) const;
+
+public slots:
+    bool select();
 };
 
 #endif // SQLSEARCHMODEL_H
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QStringList>
+#include "SqlStatementCache.h"
+
+// Number of statements kept per connection
+#define STATEMENT_CACHE_SIZE 64
+
+QMutex SqlStatementCache::sMutex;
+QMap<QString, SqlStatementCache *> SqlStatementCache::sCaches;
+
+SqlStatementCache::SqlStatementCache() :
+    mStatements(STATEMENT_CACHE_SIZE),
+    mHits(0),
+    mMisses(0)
+{
+}
+
+SqlStatementCache *
+SqlStatementCache::cacheFor(const QString &connectionName)
+{
+    QMutexLocker locker(&sMutex);
+    SqlStatementCache *cache = sCaches.value(connectionName, NULL);
+    if (cache == NULL)
+    {
+        cache = new SqlStatementCache();
+        sCaches.insert(connectionName, cache);
+    }
+    return cache;
+}
+
+bool
+SqlStatementCache::prepare(QSqlQuery &query,
+                           const QString &sql,
+                           QSqlDatabase db)
+{
+    SqlStatementCache *cache = cacheFor(db.connectionName());
+
+    // QSqlQuery copies share the underlying statement, so handing out a
+    // copy of the cached query reuses the prepared statement
+    QSqlQuery *cached = cache->mStatements.object(sql);
+    if (cached != NULL)
+    {
+        cache->mHits++;
+        cached->finish();
+        query = *cached;
+        return true;
+    }
+
+    cache->mMisses++;
+    QSqlQuery *statement = new QSqlQuery(db);
+    if (!statement->prepare(sql))
+    {
+        query = *statement;
+        delete statement;
+        return false;
+    }
+
+    query = *statement;
+    cache->mStatements.insert(sql, statement);
+    return true;
+}
+
+void
+SqlStatementCache::clear(const QString &connectionName)
+{
+    QMutexLocker locker(&sMutex);
+    SqlStatementCache *cache = sCaches.take(connectionName);
+    if (cache == NULL)
+        return;
+
+    qDebug() << "SqlStatementCache:" << connectionName
+             << "hits:" << cache->mHits
+             << "misses:" << cache->mMisses;
+    delete cache;
+}
+
+QString
+SqlStatementCache::report()
+{
+    QMutexLocker locker(&sMutex);
+    QStringList lines;
+    QMapIterator<QString, SqlStatementCache *> i(sCaches);
+    while (i.hasNext())
+    {
+        i.next();
+        lines << QString("%1: %2 hits, %3 misses, %4 statements cached")
+                 .arg(i.key())
+                 .arg(i.value()->mHits)
+                 .arg(i.value()->mMisses)
+                 .arg(i.value()->mStatements.size());
+    }
+    return lines.join("\n");
+}
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLSTATEMENTCACHE_H
+#define SQLSTATEMENTCACHE_H
+
+#include <QCache>
+#include <QMap>
+#include <QMutex>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+
+// Keeps recently used prepared statements around per connection so the
+// helpers in SqlUtilities that run in per-bug loops don't re-parse the
+// same SQL every time.  Each connection is only ever used from one thread,
+// so a cache is too; only the list of caches is shared.
+class SqlStatementCache
+{
+public:
+    // Equivalent to query.prepare(sql) on db, except that the statement is
+    // reused if it's been prepared on that connection before.  Callers that
+    // don't read a SELECT to the end should finish() it, otherwise the
+    // statement keeps the connection's read snapshot open.
+    static bool prepare(QSqlQuery &query,
+                        const QString &sql,
+                        QSqlDatabase db = QSqlDatabase::database());
+
+    // Drops every statement prepared on the connection.  Has to be called
+    // before the connection is closed.
+    static void clear(const QString &connectionName);
+
+    // Hit/miss counters for every connection, for the log
+    static QString report();
+
+private:
+    SqlStatementCache();
+    static SqlStatementCache *cacheFor(const QString &connectionName);
+
+    QCache<QString, QSqlQuery> mStatements;
+    int mHits;
+    int mMisses;
+
+    static QMutex sMutex;
+    static QMap<QString, SqlStatementCache *> sCaches;
+};
+
+#endif // SQLSTATEMENTCACHE_H
@@ -22,6 +22,9 @@
 
 #include "SqlUtilities.h"
 #include "ErrorHandler.h"
+#include "SqlStatementCache.h"
+#include "SqlProfiler.h"
+#include "SqlWatchdog.h"
 
 #include <QSqlQuery>
 #include <QStringList>
@@ -30,15 +33,37 @@
 #include <QDebug>
 #include <QSqlDatabase>
 #include <QRegExp>
-
+#include <QSettings>
+#include <QAtomicInt>
+#include <QHash>
+#include <QDateTime>
+#include <QDataStream>
+
+// Each SqlUtilities instance lives in a writer thread, and QSqlDatabase
+// connections can't be shared across threads, so clone the GUI thread's
+// default connection under a unique name.
 SqlUtilities::SqlUtilities()
 {
-    mDatabase = QSqlDatabase::database();
+    mBatchActive = false;
+    static QAtomicInt connectionCount(0);
+    QString name = QString("entomologist-writer-%1").arg(connectionCount.fetchAndAddOrdered(1));
+    mDatabase = QSqlDatabase::cloneDatabase(QSqlDatabase::database(QSqlDatabase::defaultConnection, false), name);
+    if (!mDatabase.open())
+    {
+        qDebug() << "SqlUtilities: Couldn't open " << name << ": " << mDatabase.lastError().text();
+        return;
+    }
+
+    configureConnection(mDatabase);
 }
 
 SqlUtilities::~SqlUtilities()
 {
+    QString name = mDatabase.connectionName();
+    SqlStatementCache::clear(name);
     mDatabase.close();
+    mDatabase = QSqlDatabase();
+    QSqlDatabase::removeDatabase(name);
 }
 
 void
@@ -59,38 +84,147 @@ SqlUtilities::openDb(const QString &dbPath)
         ErrorHandler::handleError("Error creating database.", db.lastError().text());
         exit(1);
     }
+
+    // Only takes effect on a new database.  Older ones are converted once,
+    // when SqlMaintenance starts.
+    QSqlQuery q(db);
+    if (!q.exec("PRAGMA auto_vacuum=INCREMENTAL"))
+        qDebug() << "openDb: Couldn't set auto_vacuum: " << q.lastError().text();
+
+    // WAL lets the GUI thread's models read a consistent snapshot while a
+    // writer thread is in the middle of a sync transaction.
+    if (!q.exec("PRAGMA journal_mode=WAL"))
+        qDebug() << "openDb: Couldn't enable WAL: " << q.lastError().text();
+
+    configureConnection(db);
+}
+
+// journal_mode is persistent, but these settings are per connection
+// so they have to be applied to every connection that's opened.
+void
+SqlUtilities::configureConnection(QSqlDatabase db)
+{
+    QSettings settings("Entomologist");
+    int cacheSize = settings.value("db-cache-size", 4000).toInt();
+    qlonglong mmapSize = settings.value("db-mmap-size", 0).toLongLong();
+
+    QSqlQuery q(db);
+    if (!q.exec("PRAGMA synchronous=NORMAL"))
+        qDebug() << "configureConnection: synchronous: " << q.lastError().text();
+    if (!q.exec(QString("PRAGMA cache_size=%1").arg(cacheSize)))
+        qDebug() << "configureConnection: cache_size: " << q.lastError().text();
+    if (mmapSize > 0)
+    {
+        if (!q.exec(QString("PRAGMA mmap_size=%1").arg(mmapSize)))
+            qDebug() << "configureConnection: mmap_size: " << q.lastError().text();
+    }
 }
 
 void
 SqlUtilities::closeDb()
 {
     QSqlDatabase db = QSqlDatabase::database();
+    SqlStatementCache::clear(db.connectionName());
     db.close();
 }
 
+// SqlWriterThread groups queued requests into a single transaction.  While
+// a batch is open each request runs inside its own savepoint instead, so one
+// failing request is rolled back without taking the rest of the batch with it.
+bool
+SqlUtilities::beginBatch()
+{
+    mBatchActive = mDatabase.transaction();
+    if (!mBatchActive)
+        qDebug() << "beginBatch: Couldn't start a transaction: " << mDatabase.lastError().text();
+    return mBatchActive;
+}
+
+bool
+SqlUtilities::commitBatch()
+{
+    if (!mBatchActive)
+        return true;
+
+    mBatchActive = false;
+    if (!mDatabase.commit())
+    {
+        qDebug() << "commitBatch: Couldn't commit: " << mDatabase.lastError().text();
+        mDatabase.rollback();
+        return false;
+    }
+    return true;
+}
+
+void
+SqlUtilities::beginWrite()
+{
+    if (mBatchActive)
+    {
+        QSqlQuery q(mDatabase);
+        if (!q.exec("SAVEPOINT write_request"))
+            qDebug() << "beginWrite: " << q.lastError().text();
+    }
+    else
+    {
+        mDatabase.transaction();
+    }
+}
+
+void
+SqlUtilities::endWrite(bool commit)
+{
+    if (mBatchActive)
+    {
+        QSqlQuery q(mDatabase);
+        if (!commit)
+            q.exec("ROLLBACK TO write_request");
+        q.exec("RELEASE write_request");
+    }
+    else if (commit)
+    {
+        mDatabase.commit();
+    }
+    else
+    {
+        mDatabase.rollback();
+    }
+}
+
 
 void
 SqlUtilities::multiInsert(const QString &tableName,
-                         QList< QMap<QString, QString> > list,
+                          SqlRecordBatch batch,
                           int operation)
 {
-    if (list.size() == 0)
+    // Bug rows need their last_modified converted to epoch seconds and have
+    // to be upserted on (tracker_id, bug_id), which is insertBugs()'s job
+    QString baseTable = tableName;
+    baseTable.remove(QRegExp("^shadow_"));
+    if ((baseTable == "bugzilla") || (baseTable == "trac") || (baseTable == "mantis"))
+    {
+        qDebug() << "multiInsert: " << tableName << " has to go through insertBugs";
+        emit failure(QString("Can't multiInsert into %1").arg(tableName));
+        return;
+    }
+
+    if (batch.isEmpty())
     {
         emit success(operation);
         return;
     }
 
     QSqlQuery q(mDatabase);
-    QStringList keys = list.at(0).keys();
+    QList<int> columns = batch.columns();
     QStringList placeholder;
     bool error = false;
     // TODO find a more clever way to do this
-    for (int i = 0; i < keys.size(); ++i)
+    for (int i = 0; i < columns.size(); ++i)
         placeholder << "?";
 
     QString query = QString("INSERT INTO %1 (%2) VALUES (%3)")
                     .arg(tableName)
-                    .arg(keys.join(","))
+                    .arg(batch.columnNames().join(","))
                     .arg(placeholder.join(","));
 
     if (!q.prepare(query))
@@ -100,82 +234,115 @@ SqlUtilities::multiInsert(const QString &tableName,
         return;
     }
 
-    mDatabase.transaction();
-    for (int a = 0; a < list.size(); ++a)
+    beginWrite();
+    for (int i = 0; i < columns.size(); ++i)
+        q.addBindValue(batch.values(columns.at(i)));
+
+    if (!SqlProfiler::execBatch(q, mDatabase))
     {
-        QMap<QString, QString> data = list.at(a);
-        for (int i = 0; i < keys.size(); ++i)
-        {
-            q.bindValue(i, data.value(keys.at(i)));
-        }
-        if (!q.exec())
-        {
-            qDebug() << "multiInsert failed: " << q.lastError().text();
-            qDebug() << q.lastQuery();
-            emit failure(q.lastError().text());
-            error = true;
-            break;
-        }
+        qDebug() << "multiInsert failed: " << q.lastError().text();
+        qDebug() << q.lastQuery();
+        emit failure(q.lastError().text());
+        error = true;
     }
 
+    endWrite(!error);
     if (!error)
-    {
-        mDatabase.commit();
         emit success(operation);
-    }
-    else
-    {
-        mDatabase.rollback();
-    }
 
     return;
 }
 
 
 // Because Mantis can't search on modified time, we have to fetch all bugs.
-// If trackerId is passed in to insertBugs, all bugs in the tables are removed
-// in order to accomodate that.
+// If trackerId is passed in to insertBugs, the batch is the tracker's whole
+// bug list and is merged in by mergeBugs().
+//
+// The bugs in removeBatch are deleted in the same transaction, and are
+// reported in bugsFinished's idList along with the ones written.
 void
 SqlUtilities::insertBugs(const QString &tableName,
-                         QList< QMap<QString, QString> > list,
+                         SqlRecordBatch batch,
                          const QString &trackerId,
-                         int operation)
+                         int operation,
+                         const SqlRecordBatch &removeBatch)
 {
     QStringList idList;
-    if (list.size() == 0)
+    if (batch.isEmpty())
     {
-        emit bugsFinished(idList, operation);
+        bool removed = true;
+        if (!removeBatch.isEmpty())
+        {
+            beginWrite();
+            removed = removeBugs(tableName, removeBatch, idList);
+            endWrite(removed);
+        }
+        if (removed)
+            emit bugsFinished(idList, operation);
+        return;
+    }
+
+    // Normalize before comparing, so an unchanged bug matches what's stored
+    if (batch.hasColumn(SqlRecordBatch::COLUMN_LAST_MODIFIED))
+        batch.setValues(SqlRecordBatch::COLUMN_LAST_MODIFIED,
+                        toEpoch(batch.values(SqlRecordBatch::COLUMN_LAST_MODIFIED)));
+
+    if (trackerId != "-1")
+    {
+        mergeBugs(tableName, batch, trackerId, operation);
         return;
     }
 
-    QSqlQuery q(mDatabase), bugQuery(mDatabase), commentQuery(mDatabase);
-    QStringList keys = list.at(0).keys();
+    QSqlQuery insertQuery(mDatabase), selectQuery(mDatabase), updateQuery(mDatabase), commentQuery(mDatabase);
+    QList<int> columns = batch.columns();
+    QStringList keys = batch.columnNames();
     QStringList placeholder;
-    QStringList rmIdList;
+    QStringList assignments;
     bool error = false;
 
     // TODO find a more clever way to do this
     for (int i = 0; i < keys.size(); ++i)
+    {
         placeholder << "?";
+        assignments << QString("%1=?").arg(keys.at(i));
+    }
+
+    // Bugs are unique on (tracker_id, bug_id), so existing rows are updated in
+    // place rather than deleted and re-inserted.  The current row is read back
+    // first so that unchanged bugs aren't written at all, and cached comments
+    // are only thrown away when the bug's last_modified has moved.  A searched
+    // bug only replaces an earlier searched copy: one a sync cached would
+    // otherwise lose its bug_type, and the next sync brings it up to date.
+    QString insertSql = QString("INSERT INTO %1 (%2) VALUES (%3)")
+                        .arg(tableName)
+                        .arg(keys.join(","))
+                        .arg(placeholder.join(","));
+    QString selectSql = QString("SELECT %1 FROM %2 WHERE tracker_id=? AND bug_id=?")
+                        .arg(keys.join(","))
+                        .arg(tableName);
+    QString updateSql = QString("UPDATE %1 SET %2 WHERE tracker_id=? AND bug_id=?")
+                        .arg(tableName)
+                        .arg(assignments.join(","));
+    QString commentDeleteSql = "DELETE FROM comments WHERE bug_id=? AND tracker_id=?";
+
+    if (!insertQuery.prepare(insertSql))
+    {
+        qDebug() << "insertBugs: Could not prepare " << insertSql << " :" << insertQuery.lastError().text();
+        emit failure(insertQuery.lastError().text());
+        return;
+    }
 
-    QString query = QString("INSERT INTO %1 (%2) VALUES (%3)")
-                    .arg(tableName)
-                    .arg(keys.join(","))
-                    .arg(placeholder.join(","));
-    QString bugDeleteSql= QString("DELETE FROM %1 WHERE bug_id=:bug_id AND tracker_id=:tracker_id").arg(tableName);
-    QString commentDeleteSql = "DELETE FROM comments WHERE bug_id=:bug_id AND tracker_id=:tracker_id";
-
-    if (!q.prepare(query))
+    if (!selectQuery.prepare(selectSql))
     {
-        qDebug() << "insertBugs: Could not prepare " << query << " :" << q.lastError().text();
-        emit failure(q.lastError().text());
+        qDebug() << "insertBugs: Could not prepare " << selectSql << " :" << selectQuery.lastError().text();
+        emit failure(selectQuery.lastError().text());
         return;
     }
 
-    if (!bugQuery.prepare(bugDeleteSql))
+    if (!updateQuery.prepare(updateSql))
     {
-        qDebug() << "insertBugs: Could not prepare " << bugDeleteSql << " :" << bugQuery.lastError().text();
-        emit failure(bugQuery.lastError().text());
+        qDebug() << "insertBugs: Could not prepare " << updateSql << " :" << updateQuery.lastError().text();
+        emit failure(updateQuery.lastError().text());
         return;
     }
 
@@ -185,95 +352,257 @@ SqlUtilities::insertBugs(const QString &tableName,
         emit failure(commentQuery.lastError().text());
         return;
     }
-    mDatabase.transaction();
-    if (trackerId != "-1")
+    beginWrite();
+
+    // Sort the incoming rows into new, changed and untouched bugs, then
+    // write each group out with a single execBatch()
+    QList<int> newRows, changedRows, modifiedRows;
+    QHash<QString, int> newRowIndex;
+    int bugTypeIndex = columns.indexOf(SqlRecordBatch::COLUMN_BUG_TYPE);
+    for (int row = 0; row < batch.size(); ++row)
     {
-        for (int rm = 0; rm < list.size(); ++rm)
+        QVariant trackerValue = batch.value(row, SqlRecordBatch::COLUMN_TRACKER_ID);
+        QVariant bugValue = batch.value(row, SqlRecordBatch::COLUMN_BUG_ID);
+        selectQuery.bindValue(0, trackerValue);
+        selectQuery.bindValue(1, bugValue);
+        if (!SqlProfiler::exec(selectQuery, mDatabase))
         {
-            QMap<QString, QString> rmData = list.at(rm);
-            rmIdList << rmData["bug_id"];
+            qDebug() << "insertBugs: selectQuery failed: " << selectQuery.lastError().text();
+            emit failure(selectQuery.lastError().text());
+            error = true;
+            break;
         }
 
-        QSqlQuery rmShadow;
-
-        if (!rmShadow.exec(QString("DELETE FROM %1 WHERE tracker_id = %2 AND bug_type != \'Searched\' AND bug_type != \'SearchedTemp\'").arg(tableName).arg(trackerId)))
+        if (selectQuery.next()
+            && (operation == BUGS_INSERT_SEARCH)
+            && (bugTypeIndex >= 0)
+            && !selectQuery.value(bugTypeIndex).toString().startsWith("Searched"))
         {
-            qDebug() << "insertBugs: Couldn't delete mantis bugs: " << rmShadow.lastError().text();
+            // Cached by a sync, so leave it be
         }
-        if (!rmShadow.exec(QString("DELETE FROM shadow_%1 WHERE tracker_id = %2 AND bug_id NOT IN (%3)")
-                            .arg(tableName)
-                            .arg(trackerId)
-                           .arg(rmIdList.join(","))))
+        else if (selectQuery.isValid())
         {
-            qDebug() << "insertBugs: Couldn't delete shadow_mantis bugs: " << rmShadow.lastError().text();
+            bool changed = false;
+            for (int i = 0; i < columns.size(); ++i)
+            {
+                if (selectQuery.value(i).toString() != batch.value(row, columns.at(i)).toString())
+                {
+                    changed = true;
+                    if (columns.at(i) == SqlRecordBatch::COLUMN_LAST_MODIFIED)
+                        modifiedRows << row;
+                }
+            }
+            if (changed)
+                changedRows << row;
         }
-
-        if (!rmShadow.exec(QString("DELETE FROM comments WHERE tracker_id = %1").arg(trackerId)))
+        else if (newRowIndex.contains(bugValue.toString()))
         {
-            qDebug() << "insertBugs: Couldn't delete comments: " << rmShadow.lastError().text();
+            // Listed twice in the same batch, so the later copy wins
+            newRows[newRowIndex.value(bugValue.toString())] = row;
         }
-
-        if (!rmShadow.exec(QString("DELETE FROM shadow_comments WHERE tracker_id = %2").arg(trackerId)))
+        else
         {
-            qDebug() << "insertBugs: Couldn't delete shadow_comments: " << rmShadow.lastError().text();
+            newRowIndex.insert(bugValue.toString(), newRows.size());
+            newRows << row;
+            modifiedRows << row;
         }
+        selectQuery.finish();
 
+        idList << bugValue.toString();
     }
 
-    for (int a = 0; a < list.size(); ++a)
+    if (!error && !modifiedRows.isEmpty())
     {
-        QMap<QString, QString> data = list.at(a);
-        bugQuery.bindValue(":bug_id", data["bug_id"]);
-        bugQuery.bindValue(":tracker_id", data["tracker_id"]);
-        commentQuery.bindValue(":bug_id", data["bug_id"]);
-        commentQuery.bindValue(":tracker_id", data["tracker_id"]);
-
-        if (trackerId == "-1")
+        SqlRecordBatch modified = batch.rows(modifiedRows);
+        commentQuery.addBindValue(modified.values(SqlRecordBatch::COLUMN_BUG_ID));
+        commentQuery.addBindValue(modified.values(SqlRecordBatch::COLUMN_TRACKER_ID));
+        if (!SqlProfiler::execBatch(commentQuery, mDatabase))
         {
-            if (!bugQuery.exec())
-            {
-                qDebug() << "insertBugs: bugQuery failed: " << q.lastError().text();
-                emit failure(q.lastError().text());
-                error = true;
-                break;
-            }
-
-            if (!commentQuery.exec())
-            {
-                qDebug() << "insertBugs: commentQuery failed: " << q.lastError().text();
-                emit failure(q.lastError().text());
-                error = true;
-                break;
-            }
+            qDebug() << "insertBugs: commentQuery failed: " << commentQuery.lastError().text();
+            emit failure(commentQuery.lastError().text());
+            error = true;
         }
+    }
 
-        for (int i = 0; i < keys.size(); ++i)
+    if (!error && !changedRows.isEmpty())
+    {
+        SqlRecordBatch changed = batch.rows(changedRows);
+        for (int i = 0; i < columns.size(); ++i)
+            updateQuery.addBindValue(changed.values(columns.at(i)));
+        updateQuery.addBindValue(changed.values(SqlRecordBatch::COLUMN_TRACKER_ID));
+        updateQuery.addBindValue(changed.values(SqlRecordBatch::COLUMN_BUG_ID));
+        if (!SqlProfiler::execBatch(updateQuery, mDatabase))
         {
-            q.bindValue(i, data.value(keys.at(i)));
+            qDebug() << "insertBugs: update failed: " << updateQuery.lastError().text();
+            qDebug() << updateQuery.lastQuery();
+            emit failure(updateQuery.lastError().text());
+            error = true;
         }
-        if (!q.exec())
+    }
+
+    if (!error && !newRows.isEmpty())
+    {
+        SqlRecordBatch inserted = batch.rows(newRows);
+        for (int i = 0; i < columns.size(); ++i)
+            insertQuery.addBindValue(inserted.values(columns.at(i)));
+        if (!SqlProfiler::execBatch(insertQuery, mDatabase))
         {
-            qDebug() << "insertBugs failed: " << q.lastError().text();
-            qDebug() << q.lastQuery();
-            emit failure(q.lastError().text());
+            qDebug() << "insertBugs failed: " << insertQuery.lastError().text();
+            qDebug() << insertQuery.lastQuery();
+            emit failure(insertQuery.lastError().text());
             error = true;
-            break;
         }
-
-        idList << data["bug_id"];
     }
 
+    if (!error && !removeBatch.isEmpty())
+        error = !removeBugs(tableName, removeBatch, idList);
+
+    endWrite(!error);
     if (!error)
-    {
-        mDatabase.commit();
         emit bugsFinished(idList, operation);
+
+    return;
+}
+
+// Must be called inside beginWrite()
+bool
+SqlUtilities::removeBugs(const QString &tableName,
+                         const SqlRecordBatch &removeBatch,
+                         QStringList &idList)
+{
+    QSqlQuery q(mDatabase);
+    QString sql = QString("DELETE FROM %1 WHERE tracker_id=? AND bug_id=?").arg(tableName);
+    if (!q.prepare(sql))
+    {
+        qDebug() << "removeBugs: Could not prepare " << sql << " :" << q.lastError().text();
+        emit failure(q.lastError().text());
+        return false;
     }
-    else
+
+    q.addBindValue(removeBatch.values(SqlRecordBatch::COLUMN_TRACKER_ID));
+    q.addBindValue(removeBatch.values(SqlRecordBatch::COLUMN_BUG_ID));
+    if (!SqlProfiler::execBatch(q, mDatabase))
     {
-        mDatabase.rollback();
+        qDebug() << "removeBugs failed: " << q.lastError().text();
+        emit failure(q.lastError().text());
+        return false;
     }
 
-    return;
+    QVariantList bugIds = removeBatch.values(SqlRecordBatch::COLUMN_BUG_ID);
+    for (int i = 0; i < bugIds.size(); ++i)
+        idList << bugIds.at(i).toString();
+    return true;
+}
+
+// The batch is bulk loaded into a temporary table and merged with a
+// handful of set operations: bugs that are no longer listed are deleted,
+// changed bugs are updated, new ones inserted, and cached comments are only
+// thrown away for bugs whose last_modified moved.  Re-syncing a tracker
+// where nothing changed therefore writes nothing but the temporary table.
+// Searched bugs aren't part of the list, so they're left alone.
+void
+SqlUtilities::mergeBugs(const QString &tableName,
+                        const SqlRecordBatch &batch,
+                        const QString &trackerId,
+                        int operation)
+{
+    QStringList idList;
+    QList<int> columns = batch.columns();
+    QStringList keys = batch.columnNames();
+    QStringList placeholder, assignments, changed;
+    for (int i = 0; i < keys.size(); ++i)
+    {
+        placeholder << "?";
+        QString key = keys.at(i);
+        if ((key == "tracker_id") || (key == "bug_id"))
+            continue;
+        assignments << QString("%1 = (SELECT %1 FROM incoming_bugs WHERE incoming_bugs.bug_id = %2.bug_id)")
+                       .arg(key).arg(tableName);
+        changed << QString("incoming_bugs.%1 IS NOT %2.%1").arg(key).arg(tableName);
+    }
+
+    for (int row = 0; row < batch.size(); ++row)
+        idList << batch.value(row, SqlRecordBatch::COLUMN_BUG_ID).toString();
+
+    // Bugs the tracker no longer lists for us
+    QString vanished = QString("SELECT bug_id FROM %1 WHERE tracker_id = %2 "
+                               "AND bug_type != 'Searched' AND bug_type != 'SearchedTemp' "
+                               "AND bug_id NOT IN (SELECT bug_id FROM incoming_bugs)")
+                               .arg(tableName).arg(trackerId);
+    // ...plus the ones that changed since the comments were cached
+    QString stale = vanished;
+    if (batch.hasColumn(SqlRecordBatch::COLUMN_LAST_MODIFIED))
+        stale += QString(" UNION SELECT incoming_bugs.bug_id FROM incoming_bugs JOIN %1 "
+                         "ON %1.tracker_id = %2 AND %1.bug_id = incoming_bugs.bug_id "
+                         "WHERE incoming_bugs.last_modified IS NOT %1.last_modified")
+                         .arg(tableName).arg(trackerId);
+
+    QStringList setup;
+    setup << "DROP TABLE IF EXISTS temp.incoming_bugs"
+          << QString("CREATE TEMP TABLE incoming_bugs AS SELECT %1 FROM %2 WHERE 0")
+                     .arg(keys.join(",")).arg(tableName)
+          << "CREATE INDEX temp.incoming_bugs_idx ON incoming_bugs (bug_id)";
+
+    QStringList merge, labels;
+    merge << QString("DELETE FROM comments WHERE tracker_id = %1 AND bug_id IN (%2)").arg(trackerId).arg(stale)
+          << QString("DELETE FROM shadow_comments WHERE tracker_id = %1 AND bug_id IN (%2)").arg(trackerId).arg(vanished)
+          << QString("DELETE FROM shadow_%1 WHERE tracker_id = %2 AND bug_id IN (%3)").arg(tableName).arg(trackerId).arg(vanished)
+          << QString("DELETE FROM %1 WHERE tracker_id = %2 AND bug_id IN (%3)").arg(tableName).arg(trackerId).arg(vanished);
+    labels << "stale comments" << "shadow comments" << "shadow bugs" << "removed";
+    if (!changed.isEmpty())
+    {
+        merge << QString("UPDATE %1 SET %2 WHERE tracker_id = %3 AND EXISTS "
+                         "(SELECT 1 FROM incoming_bugs WHERE incoming_bugs.bug_id = %1.bug_id AND (%4))")
+                         .arg(tableName).arg(assignments.join(", ")).arg(trackerId).arg(changed.join(" OR "));
+        labels << "updated";
+    }
+    merge << QString("INSERT INTO %1 (%2) SELECT %2 FROM incoming_bugs WHERE bug_id NOT IN "
+                     "(SELECT bug_id FROM %1 WHERE tracker_id = %3) GROUP BY bug_id")
+                     .arg(tableName).arg(keys.join(",")).arg(trackerId);
+    labels << "inserted";
+
+    QSqlQuery q(mDatabase);
+    QString errorText;
+    beginWrite();
+    for (int i = 0; (i < setup.size()) && errorText.isEmpty(); ++i)
+    {
+        if (!q.exec(setup.at(i)))
+        {
+            qDebug() << "mergeBugs: " << setup.at(i) << ": " << q.lastError().text();
+            errorText = q.lastError().text();
+        }
+    }
+
+    if (errorText.isEmpty())
+    {
+        QSqlQuery load(mDatabase);
+        load.prepare(QString("INSERT INTO incoming_bugs (%1) VALUES (%2)")
+                     .arg(keys.join(",")).arg(placeholder.join(",")));
+        for (int i = 0; i < columns.size(); ++i)
+            load.addBindValue(batch.values(columns.at(i)));
+        if (!SqlProfiler::execBatch(load, mDatabase))
+        {
+            qDebug() << "mergeBugs: loading failed: " << load.lastError().text();
+            errorText = load.lastError().text();
+        }
+    }
+
+    for (int i = 0; (i < merge.size()) && errorText.isEmpty(); ++i)
+    {
+        if (!SqlProfiler::exec(q, merge.at(i), mDatabase))
+        {
+            qDebug() << "mergeBugs: " << labels.at(i) << " failed: " << q.lastError().text();
+            qDebug() << merge.at(i);
+            errorText = q.lastError().text();
+        }
+    }
+
+    q.exec("DROP TABLE IF EXISTS temp.incoming_bugs");
+    endWrite(errorText.isEmpty());
+    if (errorText.isEmpty())
+        emit bugsFinished(idList, operation);
+    else
+        emit failure(errorText);
 }
 
 int
@@ -292,7 +621,7 @@ SqlUtilities::simpleInsert(const QString &tableName,
                     .arg(tableName)
                     .arg(keys.join(","))
                     .arg(placeholder.join(","));
-    q.prepare(query);
+    SqlStatementCache::prepare(q, query);
     for (int i = 0; i < keys.size(); ++i)
         q.bindValue(i,data.value(keys.at(i)));
 
@@ -333,7 +662,7 @@ SqlUtilities::simpleUpdate(const QString &tableName, QMap<QString, QString> upda
                      .arg(tableName)
                      .arg(updateList.join(","))
                      .arg(whereList.join(" AND "));
-    if(!q.prepare(query))
+    if (!SqlStatementCache::prepare(q, query))
     {
         qDebug() << "Could not prepare simpleUpdate: " << q.lastError().text();
         qDebug() << q.lastQuery();
@@ -367,14 +696,17 @@ SqlUtilities::simpleUpdate(const QString &tableName, QMap<QString, QString> upda
 }
 
 QStringList
-SqlUtilities::fieldValues(const QString &tracker_id, const QString &fieldName)
+SqlUtilities::fieldValues(const QString &tracker_id,
+                          const QString &fieldName,
+                          QSqlDatabase db)
 {
+    SQL_WATCHDOG("fieldValues");
     QStringList ret;
-    QSqlQuery q;
-    q.prepare("SELECT value FROM fields WHERE tracker_id = :tracker AND field_name = :name");
+    QSqlQuery q(db);
+    SqlStatementCache::prepare(q, "SELECT value FROM fields WHERE tracker_id = :tracker AND field_name = :name", db);
     q.bindValue(":tracker", tracker_id);
     q.bindValue(":name", fieldName);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q, db))
     {
         qDebug() << "fieldValues error: " << q.lastError().text();
         return(ret);
@@ -392,7 +724,7 @@ SqlUtilities::removeFieldValues(const QString &trackerId,
                                 const QString &fieldName)
 {
     QSqlQuery q;
-    q.prepare("DELETE FROM fields WHERE tracker_id = :tracker AND field_name = :name");
+    SqlStatementCache::prepare(q, "DELETE FROM fields WHERE tracker_id = :tracker AND field_name = :name");
     q.bindValue(":tracker", trackerId);
     q.bindValue(":name", fieldName);
     if (!q.exec())
@@ -422,54 +754,44 @@ SqlUtilities::updateDbVersion(int version)
 }
 
 bool
-SqlUtilities::hasPendingChanges()
+SqlUtilities::hasPendingChanges(QSqlDatabase db)
 {
-    QSqlQuery q;
-    q.exec("SELECT COUNT(id) FROM shadow_trac");
-    q.next();
-    if (q.value(0).toInt() > 0)
-        return true;
-
-    q.exec("SELECT COUNT(id) FROM shadow_bugzilla");
-    q.next();
-    if (q.value(0).toInt() > 0)
-        return true;
-
-    q.exec("SELECT COUNT(id) FROM shadow_mantis");
-    q.next();
-    if (q.value(0).toInt() > 0)
-        return true;
-
-    q.exec("SELECT COUNT(id) FROM shadow_comments");
-    q.next();
-    if (q.value(0).toInt() > 0)
-        return true;
+    SQL_WATCHDOG("hasPendingChanges");
+    QSqlQuery q(db);
+    if (!SqlProfiler::exec(q, "SELECT EXISTS (SELECT 1 FROM pending_changes)", db) || !q.next())
+    {
+        qDebug() << "hasPendingChanges: " << q.lastError().text();
+        return false;
+    }
 
-    return false;
+    return(q.value(0).toInt() > 0);
 }
 
 bool
 SqlUtilities::hasPendingChanges(const QString &shadowTable,
                                 const QString &trackerId)
 {
-    QString shadowQuery = QString("SELECT COUNT(id) FROM %1 WHERE tracker_id = %2").arg(shadowTable).arg(trackerId);
+    SQL_WATCHDOG("hasPendingChanges");
+    QString sql = "SELECT EXISTS (SELECT 1 FROM pending_changes WHERE tracker_id = :tracker_id "
+                  "AND tracker_table IN (:table, 'shadow_comments'))";
     QSqlQuery q;
-    q.exec(shadowQuery);
-    if (q.next())
+    if (!SqlStatementCache::prepare(q, sql))
     {
-        if (q.value(0).toInt() > 0)
-            return true;
+        qDebug() << "hasPendingChanges: could not prepare: " << q.lastError().text();
+        return false;
     }
 
-    QString commentQuery = QString("SELECT COUNT(id) FROM shadow_comments WHERE tracker_id = %1").arg(trackerId);
-    q.exec(commentQuery);
-    if (q.next())
+    q.bindValue(":tracker_id", trackerId);
+    q.bindValue(":table", shadowTable);
+    if (!SqlProfiler::exec(q) || !q.next())
     {
-        if (q.value(0).toInt() > 0)
-            return true;
+        qDebug() << "hasPendingChanges: " << q.lastError().text();
+        return false;
     }
 
-    return false;
+    bool ret = (q.value(0).toInt() > 0);
+    q.finish();
+    return ret;
 }
 
 // sqlite starts autoincrementing primary keys at 1,
@@ -480,12 +802,13 @@ SqlUtilities::trackerNameExists(const QString &name)
 {
     int ret = 0;
     QSqlQuery q;
-    q.prepare("SELECT id FROM trackers WHERE name = :name");
+    SqlStatementCache::prepare(q, "SELECT id FROM trackers WHERE name = :name");
     q.bindValue(":name", name);
-    if (q.exec())
+    if (SqlProfiler::exec(q))
     {
         q.next();
         ret = q.value(0).toInt();
+        q.finish();
     }
     return ret;
 }
@@ -495,20 +818,133 @@ SqlUtilities::hasShadowBug(const QString &tableName,
                            const QString &bugId,
                            const QString &trackerId)
 {
-    QString sql = QString("SELECT id FROM %1 WHERE bug_id = \'%2\' AND tracker_id=\'%3\'")
-                  .arg(tableName)
-                  .arg(bugId)
-                  .arg(trackerId);
+    SQL_WATCHDOG("hasShadowBug");
+    QString sql = QString("SELECT id FROM %1 WHERE bug_id = :bug_id AND tracker_id = :tracker_id")
+                  .arg(tableName);
     QSqlQuery q;
     int val;
-    q.exec(sql);
+    SqlStatementCache::prepare(q, sql);
+    q.bindValue(":bug_id", bugId);
+    q.bindValue(":tracker_id", trackerId);
+    SqlProfiler::exec(q);
     if (q.next())
         val = q.value(0).toInt();
     else
         val = 0;
+    q.finish();
     return val;
 }
 
+QMap<QString, int>
+SqlUtilities::trackerStats(const QString &trackerId)
+{
+    SQL_WATCHDOG("trackerStats");
+    QMap<QString, int> ret;
+    QSqlQuery q;
+    SqlStatementCache::prepare(q, "SELECT total, open_bugs, recent, assigned, pending "
+                                  "FROM tracker_stats WHERE tracker_id = :tracker_id");
+    q.bindValue(":tracker_id", trackerId);
+    if (!SqlProfiler::exec(q))
+    {
+        qDebug() << "trackerStats: " << q.lastError().text();
+        return ret;
+    }
+
+    if (q.next())
+    {
+        ret["total"] = q.value(0).toInt();
+        ret["open"] = q.value(1).toInt();
+        ret["recent"] = q.value(2).toInt();
+        ret["assigned"] = q.value(3).toInt();
+        ret["pending"] = q.value(4).toInt();
+    }
+    q.finish();
+    return ret;
+}
+
+QVariantMap
+SqlUtilities::syncSchedule(const QString &trackerId)
+{
+    QVariantMap ret;
+    QSqlQuery q;
+    SqlStatementCache::prepare(q, "SELECT sync_interval, next_sync, sync_failures, tab_views "
+                                  "FROM trackers WHERE id = :id");
+    q.bindValue(":id", trackerId);
+    if (!SqlProfiler::exec(q))
+    {
+        qDebug() << "syncSchedule: " << q.lastError().text();
+        return ret;
+    }
+
+    if (q.next())
+    {
+        ret["sync_interval"] = q.value(0).toInt();
+        ret["next_sync"] = q.value(1).toLongLong();
+        ret["sync_failures"] = q.value(2).toInt();
+        ret["tab_views"] = q.value(3).toDouble();
+    }
+    q.finish();
+    return ret;
+}
+
+void
+SqlUtilities::saveSyncSchedule(const QString &trackerId,
+                               const QVariantMap &schedule)
+{
+    QSqlQuery q;
+    SqlStatementCache::prepare(q, "UPDATE trackers SET sync_interval = :sync_interval, "
+                                  "next_sync = :next_sync, sync_failures = :sync_failures, "
+                                  "tab_views = :tab_views WHERE id = :id");
+    q.bindValue(":sync_interval", schedule.value("sync_interval"));
+    q.bindValue(":next_sync", schedule.value("next_sync"));
+    q.bindValue(":sync_failures", schedule.value("sync_failures"));
+    q.bindValue(":tab_views", schedule.value("tab_views"));
+    q.bindValue(":id", trackerId);
+    if (!SqlProfiler::exec(q))
+        qDebug() << "saveSyncSchedule: " << q.lastError().text();
+    q.finish();
+}
+
+QVariantMap
+SqlUtilities::syncCheckpoints(const QString &trackerId,
+                              const QString &since,
+                              QString &started)
+{
+    QVariantMap ret;
+    QSqlQuery q;
+    SqlStatementCache::prepare(q, "SELECT phase, started, data FROM sync_checkpoints "
+                                  "WHERE tracker_id = :tracker_id AND since = :since "
+                                  "ORDER BY phase, chunk");
+    q.bindValue(":tracker_id", trackerId);
+    q.bindValue(":since", since);
+    if (!SqlProfiler::exec(q))
+    {
+        qDebug() << "syncCheckpoints: " << q.lastError().text();
+        return ret;
+    }
+
+    while (q.next())
+    {
+        QByteArray bytes = qUncompress(q.value(2).toByteArray());
+        QDataStream in(&bytes, QIODevice::ReadOnly);
+        QVariant data;
+        in >> data;
+        if (in.status() != QDataStream::Ok)
+        {
+            qDebug() << "syncCheckpoints: couldn't read " << q.value(0).toString();
+            continue;
+        }
+
+        QString phase = q.value(0).toString();
+        QVariantList chunks = ret.value(phase).toList();
+        chunks << data;
+        ret[phase] = chunks;
+        started = q.value(1).toString();
+    }
+    q.finish();
+    return ret;
+}
+
 QList< QMap<QString, QString> >
 SqlUtilities::loadTrackers()
 {
@@ -556,20 +992,763 @@ SqlUtilities::migrateTables(int dbVersion)
         case 5:
         q.exec(QString(attachmentsTable).arg("attachments"));
         q.exec(QString(attachmentsTable).arg("shadow_attachments"));
+        case 6:
+        createIndexes();
+        case 7:
+        createUniqueBugIndexes();
+        case 8:
+        convertTimestamps();
+        createTimestampIndexes();
+        case 9:
+        createSearchIndex();
+        case 10:
+        createAllBugsView();
+        case 11:
+        createPendingChanges();
+        case 12:
+        createCompressedComments();
+        case 13:
+        createSearchRetention();
+        case 14:
+        createTrackerStats();
+        case 15:
+        createSyncSchedule();
+        case 16:
+        createSyncCheckpoints();
+        case 17:
+        createAllBugsIndexes();
+        case 18:
+        // Checkpoints are saved a chunk per row now
+        createSyncCheckpoints();
         default:
         break;
     }
 }
 
-
+// The tracker UIs join the bug tables against their shadow tables on bug_id,
+// and the writer deletes and looks up rows by (tracker_id, bug_id), so
+// without these every one of those is a full table scan.
 void
-SqlUtilities::createTables(int dbVersion)
+SqlUtilities::createIndexes()
 {
-    QString createMetaSql = "CREATE TABLE entomologist(db_version INT)";
-    QString createTrackerSql = "CREATE TABLE trackers(id INTEGER PRIMARY KEY,"
-                                                      "type TEXT,"
-                                                      "name TEXT,"
-                                                      "url TEXT,"
+    QString bugIndexSql = "CREATE INDEX IF NOT EXISTS %1_tracker_bug_idx ON %1 (tracker_id, bug_id)";
+    QString typeIndexSql = "CREATE INDEX IF NOT EXISTS %1_tracker_type_idx ON %1 (tracker_id, bug_type)";
+    QStringList bugTables, childTables;
+    bugTables << "bugzilla" << "shadow_bugzilla"
+              << "trac" << "shadow_trac"
+              << "mantis" << "shadow_mantis";
+    childTables << "comments" << "shadow_comments"
+                << "attachments" << "shadow_attachments";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        if (!q.exec(QString(bugIndexSql).arg(bugTables.at(i))))
+            qDebug() << "createIndexes: " << bugTables.at(i) << ": " << q.lastError().text();
+        if (!q.exec(QString(typeIndexSql).arg(bugTables.at(i))))
+            qDebug() << "createIndexes: " << bugTables.at(i) << ": " << q.lastError().text();
+    }
+
+    for (int i = 0; i < childTables.size(); ++i)
+    {
+        if (!q.exec(QString(bugIndexSql).arg(childTables.at(i))))
+            qDebug() << "createIndexes: " << childTables.at(i) << ": " << q.lastError().text();
+    }
+}
+
+
+// insertBugs relies on there only being one row per (tracker_id, bug_id),
+// so collapse any duplicates left behind by older versions before adding
+// the constraint.  The unique index replaces the plain one from createIndexes.
+void
+SqlUtilities::createUniqueBugIndexes()
+{
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        QString table = bugTables.at(i);
+        if (!q.exec(QString("DELETE FROM %1 WHERE id NOT IN (SELECT MAX(id) FROM %1 GROUP BY tracker_id, bug_id)").arg(table)))
+            qDebug() << "createUniqueBugIndexes: " << table << ": " << q.lastError().text();
+        if (!q.exec(QString("CREATE UNIQUE INDEX IF NOT EXISTS %1_tracker_bug_unique ON %1 (tracker_id, bug_id)").arg(table)))
+            qDebug() << "createUniqueBugIndexes: " << table << ": " << q.lastError().text();
+        if (!q.exec(QString("DROP INDEX IF EXISTS %1_tracker_bug_idx").arg(table)))
+            qDebug() << "createUniqueBugIndexes: " << table << ": " << q.lastError().text();
+    }
+}
+
+// Older databases kept last_modified and the comment timestamps as TEXT in
+// whatever format the tracker handed back, so sorting on them was a string
+// sort.  SQLite can't change a column's type in place, so each table is
+// rebuilt from its own schema with an INTEGER column, and the old strings
+// are then parsed and rewritten as epochs.
+void
+SqlUtilities::convertTimestamps()
+{
+    QMap<QString, QString> tables;
+    tables["bugzilla"] = "last_modified";
+    tables["shadow_bugzilla"] = "last_modified";
+    tables["trac"] = "last_modified";
+    tables["shadow_trac"] = "last_modified";
+    tables["mantis"] = "last_modified";
+    tables["shadow_mantis"] = "last_modified";
+    tables["comments"] = "timestamp";
+    tables["shadow_comments"] = "timestamp";
+
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery q(db);
+    bool rebuilt = false;
+    db.transaction();
+    QMapIterator<QString, QString> i(tables);
+    while (i.hasNext())
+    {
+        i.next();
+        QString table = i.key();
+        QString column = i.value();
+
+        QString columnType;
+        q.exec(QString("PRAGMA table_info(%1)").arg(table));
+        while (q.next())
+        {
+            if (q.value(1).toString() == column)
+                columnType = q.value(2).toString().toUpper();
+        }
+
+        if (columnType.isEmpty() || (columnType == "INTEGER"))
+            continue;
+
+        q.exec(QString("SELECT sql FROM sqlite_master WHERE type='table' AND name='%1'").arg(table));
+        if (!q.next())
+            continue;
+        QString createSql = q.value(0).toString();
+        q.finish();
+        createSql.replace(QRegExp("^CREATE TABLE \\w+"), QString("CREATE TABLE %1_epoch").arg(table));
+        createSql.replace(QString("%1 TEXT").arg(column), QString("%1 INTEGER").arg(column));
+
+        qDebug() << "convertTimestamps: rebuilding " << table;
+        if (!q.exec(createSql)
+            || !q.exec(QString("INSERT INTO %1_epoch SELECT * FROM %1").arg(table))
+            || !q.exec(QString("DROP TABLE %1").arg(table))
+            || !q.exec(QString("ALTER TABLE %1_epoch RENAME TO %1").arg(table)))
+        {
+            qDebug() << "convertTimestamps: " << table << ": " << q.lastError().text();
+            db.rollback();
+            return;
+        }
+        rebuilt = true;
+
+        // Anything that still isn't a number after the copy is one of the
+        // old date strings
+        QVariantList ids, epochs;
+        q.exec(QString("SELECT id, %1 FROM %2 WHERE typeof(%1) = 'text'").arg(column).arg(table));
+        while (q.next())
+        {
+            QVariant epoch = toEpoch(q.value(1));
+            if (epoch.type() != QVariant::LongLong)
+                continue;
+            ids << q.value(0);
+            epochs << epoch;
+        }
+
+        if (ids.isEmpty())
+            continue;
+
+        QSqlQuery update(db);
+        update.prepare(QString("UPDATE %1 SET %2 = ? WHERE id = ?").arg(table).arg(column));
+        update.addBindValue(epochs);
+        update.addBindValue(ids);
+        if (!update.execBatch())
+            qDebug() << "convertTimestamps: " << table << ": " << update.lastError().text();
+    }
+    db.commit();
+
+    // The indexes went with the old tables
+    if (rebuilt)
+    {
+        createIndexes();
+        createUniqueBugIndexes();
+    }
+}
+
+// Sorting a tracker's bugs on Last Modified, or asking for what changed
+// since a given time, is then a range scan on this index
+void
+SqlUtilities::createTimestampIndexes()
+{
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        if (!q.exec(QString("CREATE INDEX IF NOT EXISTS %1_tracker_modified_idx ON %1 (tracker_id, last_modified)").arg(bugTables.at(i))))
+            qDebug() << "createTimestampIndexes: " << bugTables.at(i) << ": " << q.lastError().text();
+    }
+}
+
+// Full text indexes over the cached bugs and comments, so the search tab
+// can answer from the local cache before (or instead of) asking the servers.
+// Each index uses the row id of the table it covers as its docid, and
+// triggers keep it current, so the indexing happens incrementally inside
+// the writer thread's transactions.
+//
+// search_results is rebuilt with a unique key because local and remote
+// results for the same bug now land in it together.
+void
+SqlUtilities::createSearchIndex()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    directExec(db, "DROP TABLE IF EXISTS search_results");
+    directExec(db, "CREATE TABLE search_results (id INTEGER PRIMARY KEY,"
+                                                "tracker_name TEXT,"
+                                                "bug_id TEXT,"
+                                                "summary TEXT,"
+                                                "UNIQUE (tracker_name, bug_id) ON CONFLICT IGNORE)");
+
+    QMap<QString, QStringList> tables;
+    tables["bugzilla"] = QStringList() << "summary" << "description";
+    tables["trac"] = QStringList() << "summary" << "description";
+    tables["mantis"] = QStringList() << "summary" << "description";
+    tables["comments"] = QStringList() << "comment";
+
+    QSqlQuery q(db);
+    db.transaction();
+    QMapIterator<QString, QStringList> i(tables);
+    while (i.hasNext())
+    {
+        i.next();
+        QString table = i.key();
+        QString columns = i.value().join(", ");
+        QString newColumns = "new." + i.value().join(", new.");
+        QStringList assignments;
+        for (int c = 0; c < i.value().size(); ++c)
+            assignments << QString("%1 = new.%1").arg(i.value().at(c));
+
+        QStringList sql;
+        sql << QString("CREATE VIRTUAL TABLE %1_fts USING fts4(%2)").arg(table).arg(columns)
+            << QString("INSERT INTO %1_fts (docid, %2) SELECT id, %2 FROM %1").arg(table).arg(columns)
+            << QString("CREATE TRIGGER %1_fts_insert AFTER INSERT ON %1 BEGIN "
+                       "INSERT INTO %1_fts (docid, %2) VALUES (new.id, %3); END")
+                       .arg(table).arg(columns).arg(newColumns)
+            << QString("CREATE TRIGGER %1_fts_update AFTER UPDATE OF %2 ON %1 BEGIN "
+                       "UPDATE %1_fts SET %3 WHERE docid = old.id; END")
+                       .arg(table).arg(columns).arg(assignments.join(", "))
+            << QString("CREATE TRIGGER %1_fts_delete AFTER DELETE ON %1 BEGIN "
+                       "DELETE FROM %1_fts WHERE docid = old.id; END").arg(table);
+
+        for (int s = 0; s < sql.size(); ++s)
+        {
+            if (!q.exec(sql.at(s)))
+            {
+                // Most likely SQLite was built without FTS, in which case
+                // searches just go to the servers as before
+                qDebug() << "createSearchIndex: " << table << ": " << q.lastError().text();
+                break;
+            }
+        }
+    }
+    db.commit();
+}
+
+// Fills search_results from the full text indexes.  Bugs matching on the
+// summary come first, then the description, then the cached comments, with
+// the most recently modified first within each group.  Returns the number
+// of bugs found, or -1 if the index isn't available.
+int
+SqlUtilities::localSearch(const QString &search,
+                          const QString &trackerName)
+{
+    SQL_WATCHDOG("localSearch");
+    // Quote each word so that characters the user types aren't taken
+    // as FTS query syntax
+    QStringList terms;
+    QStringList words = search.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    for (int i = 0; i < words.size(); ++i)
+    {
+        QString word = words.at(i);
+        word.remove('"');
+        if (!word.isEmpty())
+            terms << QString("\"%1\"").arg(word);
+    }
+    if (terms.isEmpty())
+        return 0;
+
+    QString trackerFilter;
+    if (!trackerName.isEmpty())
+        trackerFilter = " AND trackers.name = ?";
+
+    QString bugSql = "SELECT trackers.name AS name, %1.bug_id AS bug_id, %1.summary AS summary, "
+                     "%1.last_modified AS last_modified, %3 AS rank "
+                     "FROM %1_fts JOIN %1 ON %1.id = %1_fts.docid "
+                     "JOIN trackers ON trackers.id = %1.tracker_id "
+                     "WHERE %1_fts.%2 MATCH ?" + trackerFilter;
+    QString commentSql = "SELECT trackers.name AS name, %1.bug_id AS bug_id, %1.summary AS summary, "
+                         "%1.last_modified AS last_modified, 2 AS rank "
+                         "FROM comments_fts JOIN comments ON comments.id = comments_fts.docid "
+                         "JOIN %1 ON %1.tracker_id = comments.tracker_id AND %1.bug_id = comments.bug_id "
+                         "JOIN trackers ON trackers.id = %1.tracker_id "
+                         "WHERE comments_fts MATCH ?" + trackerFilter;
+
+    QStringList branches;
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        branches << QString(bugSql).arg(bugTables.at(i)).arg("summary").arg(0)
+                 << QString(bugSql).arg(bugTables.at(i)).arg("description").arg(1)
+                 << QString(commentSql).arg(bugTables.at(i));
+    }
+
+    QString sql = QString("INSERT INTO search_results (tracker_name, bug_id, summary) "
+                          "SELECT name, bug_id, summary FROM (%1) "
+                          "GROUP BY name, bug_id ORDER BY MIN(rank), MAX(last_modified) DESC")
+                          .arg(branches.join(" UNION ALL "));
+
+    QSqlQuery q;
+    if (!SqlStatementCache::prepare(q, sql))
+    {
+        qDebug() << "localSearch: could not prepare: " << q.lastError().text();
+        return -1;
+    }
+
+    QString match = terms.join(" ");
+    int bind = 0;
+    for (int i = 0; i < branches.size(); ++i)
+    {
+        q.bindValue(bind++, match);
+        if (!trackerName.isEmpty())
+            q.bindValue(bind++, trackerName);
+    }
+
+    if (!SqlProfiler::exec(q))
+    {
+        qDebug() << "localSearch failed: " << q.lastError().text();
+        return -1;
+    }
+
+    return q.numRowsAffected();
+}
+
+// all_bugs is the column subset the three bug tables share, for the
+// cross-tracker tab.  SQLite flattens the UNION ALL into the outer query,
+// so the filter and ORDER BY are applied to each table separately.
+void
+SqlUtilities::createAllBugsView()
+{
+    QString columns = "id AS row_id, tracker_id, bug_id, highlight_type, last_modified, "
+                      "severity, priority, assigned_to, status, summary, bug_type";
+    QStringList bugTables, selects;
+    bugTables << "bugzilla" << "trac" << "mantis";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+        selects << QString("SELECT '%1' AS tracker_type, %2 FROM %1").arg(bugTables.at(i)).arg(columns);
+
+    if (!q.exec("DROP VIEW IF EXISTS all_bugs")
+        || !q.exec(QString("CREATE VIEW all_bugs AS %1").arg(selects.join(" UNION ALL "))))
+        qDebug() << "createAllBugsView: " << q.lastError().text();
+
+    createAllBugsIndexes();
+}
+
+// The All Bugs tab opens sorted by last_modified, filtered on bug_type, so
+// that's the one order worth an index: each table of the flattened view can
+// then be read in order and merged instead of sorted.  last_modified leads
+// because an IN list on a leading bug_type would lose the order.  The other
+// sort columns are left to a sort: every index here is one more B-tree the
+// writer updates for every bug a sync touches.
+void
+SqlUtilities::createAllBugsIndexes()
+{
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        QString table = bugTables.at(i);
+        if (!q.exec(QString("DROP INDEX IF EXISTS %1_all_bugs_idx").arg(table))
+            || !q.exec(QString("CREATE INDEX IF NOT EXISTS %1_last_modified_sort_idx ON %1 (last_modified, bug_type)").arg(table)))
+            qDebug() << "createAllBugsIndexes: " << table << ": " << q.lastError().text();
+    }
+}
+
+// The columns a user can change on each kind of bug, as column name and
+// changelog label pairs
+QMap<QString, QStringList>
+SqlUtilities::changelogFields()
+{
+    QMap<QString, QStringList> fields;
+    fields["trac"] = QStringList() << "severity" << "Severity"
+                                   << "priority" << "Priority"
+                                   << "assigned_to" << "Assigned To"
+                                   << "status" << "Status"
+                                   << "summary" << "Summary"
+                                   << "component" << "Component"
+                                   << "milestone" << "Milestone"
+                                   << "version" << "Version"
+                                   << "resolution" << "Resolution";
+    fields["bugzilla"] = QStringList() << "severity" << "Severity"
+                                       << "priority" << "Priority"
+                                       << "assigned_to" << "Assigned To"
+                                       << "status" << "Status"
+                                       << "summary" << "Summary"
+                                       << "component" << "Component"
+                                       << "product" << "Product"
+                                       << "resolution" << "Resolution";
+    fields["mantis"] = QStringList() << "severity" << "Severity"
+                                     << "priority" << "Priority"
+                                     << "assigned_to" << "Assigned To"
+                                     << "status" << "Status"
+                                     << "summary" << "Summary"
+                                     << "category" << "Category"
+                                     << "project" << "Project"
+                                     << "product_version" << "Product Version"
+                                     << "reproducibility" << "Reproducibility"
+                                     << "os" << "OS"
+                                     << "os_version" << "OS Version"
+                                     << "resolution" << "Resolution";
+    return fields;
+}
+
+// pending_changes holds one row per field the user has changed and not yet
+// uploaded.  Triggers on the shadow tables keep it current, so the upload
+// button, the changelog window and the upload code only ever read this
+// small table.
+void
+SqlUtilities::createPendingChanges()
+{
+    QMap<QString, QStringList> fields = changelogFields();
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery q(db);
+    QStringList sql;
+    sql << "CREATE TABLE pending_changes (id INTEGER PRIMARY KEY,"
+                                         "tracker_table TEXT,"
+                                         "shadow_id INTEGER,"
+                                         "tracker_id INTEGER,"
+                                         "bug_id INTEGER,"
+                                         "column_label TEXT,"
+                                         "new_value TEXT)"
+        << "CREATE INDEX pending_changes_shadow_idx ON pending_changes (tracker_table, shadow_id)"
+        << "CREATE INDEX pending_changes_tracker_idx ON pending_changes (tracker_id)";
+
+    // %1 is where the shadow row's values come from: "new." inside a
+    // trigger, or the shadow table itself when filling in existing rows
+    QString insertSql = "INSERT INTO pending_changes (tracker_table, shadow_id, tracker_id, bug_id, "
+                        "column_label, new_value) "
+                        "SELECT '%2', %1id, %1tracker_id, %1bug_id, '%3', %1%4 "
+                        "%5WHERE %1%4 IS NOT NULL";
+    QMapIterator<QString, QStringList> i(fields);
+    while (i.hasNext())
+    {
+        i.next();
+        QString table = i.key();
+        QString shadow = "shadow_" + table;
+        QStringList triggerBody, backfill;
+        for (int f = 0; f < i.value().size(); f += 2)
+        {
+            QString column = i.value().at(f);
+            QString label = i.value().at(f + 1);
+            triggerBody << QString(insertSql).arg("new.").arg(shadow)
+                                             .arg(label).arg(column).arg("") + ";";
+            backfill << QString(insertSql).arg(shadow + ".").arg(shadow)
+                                          .arg(label).arg(column).arg(QString("FROM %1 ").arg(shadow));
+        }
+
+        QString deleteSql = QString("DELETE FROM pending_changes WHERE tracker_table = '%1' AND shadow_id = old.id;").arg(shadow);
+        sql << QString("CREATE TRIGGER %1_pending_insert AFTER INSERT ON %1 BEGIN %2 END")
+                       .arg(shadow).arg(triggerBody.join(" "))
+            << QString("CREATE TRIGGER %1_pending_update AFTER UPDATE ON %1 BEGIN %2 %3 END")
+                       .arg(shadow).arg(deleteSql).arg(triggerBody.join(" "))
+            << QString("CREATE TRIGGER %1_pending_delete AFTER DELETE ON %1 BEGIN %2 END")
+                       .arg(shadow).arg(deleteSql);
+        sql << backfill;
+    }
+
+    QString commentSql = "INSERT INTO pending_changes (tracker_table, shadow_id, tracker_id, bug_id, "
+                         "column_label, new_value) "
+                         "SELECT 'shadow_comments', %1id, %1tracker_id, %1bug_id, 'Comment', %1comment %2";
+    QString commentDeleteSql = "DELETE FROM pending_changes WHERE tracker_table = 'shadow_comments' AND shadow_id = old.id;";
+    sql << QString("CREATE TRIGGER shadow_comments_pending_insert AFTER INSERT ON shadow_comments BEGIN %1; END")
+                   .arg(QString(commentSql).arg("new.").arg(""))
+        << QString("CREATE TRIGGER shadow_comments_pending_update AFTER UPDATE ON shadow_comments BEGIN %1 %2; END")
+                   .arg(commentDeleteSql).arg(QString(commentSql).arg("new.").arg(""))
+        << QString("CREATE TRIGGER shadow_comments_pending_delete AFTER DELETE ON shadow_comments BEGIN %1 END")
+                   .arg(commentDeleteSql)
+        << QString(commentSql).arg("shadow_comments.").arg("FROM shadow_comments");
+
+    db.transaction();
+    for (int s = 0; s < sql.size(); ++s)
+    {
+        if (!q.exec(sql.at(s)))
+        {
+            qDebug() << "createPendingChanges: " << q.lastError().text();
+            qDebug() << sql.at(s);
+            db.rollback();
+            return;
+        }
+    }
+    db.commit();
+}
+
+// Compressed comment bodies are stored as BLOBs, which the full text index
+// can't read.  The triggers now only index plain TEXT rows, and
+// execCommentBatch() indexes the original text of the compressed ones.
+void
+SqlUtilities::createCompressedComments()
+{
+    QSqlQuery q;
+    QStringList sql;
+    sql << "DROP TRIGGER IF EXISTS comments_fts_insert"
+        << "DROP TRIGGER IF EXISTS comments_fts_update"
+        << "CREATE TRIGGER comments_fts_insert AFTER INSERT ON comments "
+           "WHEN typeof(new.comment) = 'text' BEGIN "
+           "INSERT INTO comments_fts (docid, comment) VALUES (new.id, new.comment); END"
+        << "CREATE TRIGGER comments_fts_update AFTER UPDATE OF comment ON comments "
+           "WHEN typeof(new.comment) = 'text' BEGIN "
+           "UPDATE comments_fts SET comment = new.comment WHERE docid = old.id; END";
+    for (int i = 0; i < sql.size(); ++i)
+    {
+        if (!q.exec(sql.at(i)))
+        {
+            // No FTS in this SQLite, so there is nothing to keep in step
+            qDebug() << "createCompressedComments: " << q.lastError().text();
+            break;
+        }
+    }
+}
+
+// searched_at records when a bug was last pulled in by a search, so
+// pruneSearches() can age out the Searched and SearchedTemp rows.  Triggers
+// stamp it, since those rows arrive through the same insert paths as
+// everything else.  clearRecentBugs() looks rows up by highlight_type.
+void
+SqlUtilities::createSearchRetention()
+{
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+    QString searched = "('Searched', 'SearchedTemp')";
+
+    QSqlQuery q;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        QString table = bugTables.at(i);
+        QStringList sql;
+        sql << QString("ALTER TABLE %1 ADD COLUMN searched_at INTEGER").arg(table)
+            << QString("UPDATE %1 SET searched_at = strftime('%s', 'now') WHERE bug_type IN %2")
+                       .arg(table).arg(searched)
+            << QString("CREATE INDEX IF NOT EXISTS %1_searched_idx ON %1 (bug_type, searched_at)").arg(table)
+            << QString("CREATE INDEX IF NOT EXISTS %1_highlight_idx ON %1 (highlight_type)").arg(table)
+            << QString("CREATE TRIGGER %1_searched_insert AFTER INSERT ON %1 "
+                       "WHEN new.bug_type IN %2 BEGIN "
+                       "UPDATE %1 SET searched_at = strftime('%s', 'now') WHERE id = new.id; END")
+                       .arg(table).arg(searched)
+            << QString("CREATE TRIGGER %1_searched_update AFTER UPDATE OF bug_type ON %1 "
+                       "WHEN new.bug_type IN %2 BEGIN "
+                       "UPDATE %1 SET searched_at = strftime('%s', 'now') WHERE id = new.id; END")
+                       .arg(table).arg(searched);
+
+        for (int s = 0; s < sql.size(); ++s)
+        {
+            if (!q.exec(sql.at(s)))
+                qDebug() << "createSearchRetention: " << table << ": " << q.lastError().text();
+        }
+    }
+}
+
+// tracker_stats keeps the per-tracker counts the tab captions and the tray
+// notification show.  Triggers on the bug tables and pending_changes adjust
+// them row by row as the writer inserts, merges and deletes bugs and as
+// the user edits them, so nothing ever has to count over a bug table.
+void
+SqlUtilities::createTrackerStats()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    QStringList sql;
+    sql << "CREATE TABLE tracker_stats (tracker_id INTEGER PRIMARY KEY,"
+                                      "total INTEGER DEFAULT 0,"
+                                      "open_bugs INTEGER DEFAULT 0,"
+                                      "recent INTEGER DEFAULT 0,"
+                                      "assigned INTEGER DEFAULT 0,"
+                                      "pending INTEGER DEFAULT 0)";
+
+    // %1 is the row (new or old) and %2 + or -
+    QString adjust = "INSERT OR IGNORE INTO tracker_stats (tracker_id) VALUES (%1.tracker_id); "
+                     "UPDATE tracker_stats SET total = total %2 1, "
+                     "open_bugs = open_bugs %2 (%1.bug_state IS 'open'), "
+                     "recent = recent %2 (%1.highlight_type IS %3), "
+                     "assigned = assigned %2 (%1.bug_type IS 'Assigned') "
+                     "WHERE tracker_id = %1.tracker_id;";
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+    QStringList backfill;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        QString table = bugTables.at(i);
+        QString added = QString(adjust).arg("new", "+", QString::number(HIGHLIGHT_RECENT));
+        QString removed = QString(adjust).arg("old", "-", QString::number(HIGHLIGHT_RECENT));
+        sql << QString("CREATE TRIGGER %1_stats_insert AFTER INSERT ON %1 BEGIN %2 END").arg(table, added)
+            << QString("CREATE TRIGGER %1_stats_delete AFTER DELETE ON %1 BEGIN %2 END").arg(table, removed)
+            << QString("CREATE TRIGGER %1_stats_update AFTER UPDATE OF tracker_id, bug_state, highlight_type, bug_type "
+                       "ON %1 BEGIN %2 %3 END").arg(table, removed, added);
+        backfill << QString("SELECT tracker_id, count(*) AS total, total(bug_state IS 'open') AS open_bugs, "
+                            "total(highlight_type IS %2) AS recent, total(bug_type IS 'Assigned') AS assigned "
+                            "FROM %1 GROUP BY tracker_id").arg(table).arg(HIGHLIGHT_RECENT);
+    }
+
+    sql << QString("INSERT INTO tracker_stats (tracker_id, total, open_bugs, recent, assigned) "
+                   "SELECT tracker_id, sum(total), sum(open_bugs), sum(recent), sum(assigned) "
+                   "FROM (%1) GROUP BY tracker_id").arg(backfill.join(" UNION ALL "))
+        << "INSERT OR IGNORE INTO tracker_stats (tracker_id) SELECT DISTINCT tracker_id FROM pending_changes"
+        << "UPDATE tracker_stats SET pending = (SELECT count(*) FROM pending_changes "
+           "WHERE pending_changes.tracker_id = tracker_stats.tracker_id)"
+        << "CREATE TRIGGER pending_changes_stats_insert AFTER INSERT ON pending_changes BEGIN "
+           "INSERT OR IGNORE INTO tracker_stats (tracker_id) VALUES (new.tracker_id); "
+           "UPDATE tracker_stats SET pending = pending + 1 WHERE tracker_id = new.tracker_id; END"
+        << "CREATE TRIGGER pending_changes_stats_delete AFTER DELETE ON pending_changes BEGIN "
+           "UPDATE tracker_stats SET pending = pending - 1 WHERE tracker_id = old.tracker_id; END";
+
+    QSqlQuery q(db);
+    db.transaction();
+    for (int i = 0; i < sql.size(); ++i)
+    {
+        if (!q.exec(sql.at(i)))
+            qDebug() << "createTrackerStats: " << q.lastError().text();
+    }
+    db.commit();
+}
+
+// What a sync has fetched so far: one row per finished phase, or one per
+// chunk for a phase that saves its progress as it goes.  since is
+// the last_sync the sync started from: rows for any other value are left
+// over from before the last successful sync, and are ignored.
+void
+SqlUtilities::createSyncCheckpoints()
+{
+    QSqlQuery q;
+    if (!q.exec("DROP TABLE IF EXISTS sync_checkpoints")
+        || !q.exec("CREATE TABLE sync_checkpoints (tracker_id INTEGER,"
+                                                 "phase TEXT,"
+                                                 "chunk INTEGER,"
+                                                 "since TEXT,"
+                                                 "started TEXT,"
+                                                 "data BLOB,"
+                                                 "PRIMARY KEY (tracker_id, phase, chunk))"))
+        qDebug() << "createSyncCheckpoints: " << q.lastError().text();
+}
+
+void
+SqlUtilities::createSyncSchedule()
+{
+    QStringList columns;
+    columns << "sync_interval INTEGER DEFAULT 0"
+            << "next_sync INTEGER DEFAULT 0"
+            << "sync_failures INTEGER DEFAULT 0"
+            << "tab_views REAL DEFAULT 0";
+
+    QSqlQuery q;
+    for (int i = 0; i < columns.size(); ++i)
+    {
+        if (!q.exec(QString("ALTER TABLE trackers ADD COLUMN %1").arg(columns.at(i))))
+            qDebug() << "createSyncSchedule: " << q.lastError().text();
+    }
+}
+
+// Timestamps without a zone are in the server's time, offset seconds ahead
+// of UTC; the XML-RPC interfaces mostly send UTC, so offset is usually 0.
+// Zone abbreviations (Bugzilla can send "EDT") are ignored.  Anything that
+// isn't a date is stored as NULL rather than as text in an INTEGER column.
+QVariant
+SqlUtilities::toEpoch(const QVariant &time,
+                      int offset)
+{
+    QVariant invalid(QVariant::LongLong);
+    if (time.isNull() || time.toString().trimmed().isEmpty())
+        return invalid;
+
+    if (time.type() == QVariant::DateTime)
+    {
+        QDateTime dt = time.toDateTime();
+        if (!dt.isValid())
+        {
+            qDebug() << "toEpoch: invalid date";
+            return invalid;
+        }
+        dt.setTimeSpec(Qt::UTC);
+        return qlonglong(dt.toTime_t()) - offset;
+    }
+
+    QString str = time.toString().trimmed();
+    bool ok = false;
+    qlonglong epoch = str.toLongLong(&ok);
+    if (ok)
+        return epoch;
+
+    QRegExp rx("^(\\d{4}-\\d{2}-\\d{2})(?:[T ](\\d{2}:\\d{2})(:\\d{2})?)?(?:\\.\\d+)?\\s*(Z|[+-]\\d{2}:?\\d{2})?");
+    if (rx.indexIn(str) == -1)
+    {
+        qDebug() << "toEpoch: can't parse " << str;
+        return invalid;
+    }
+
+    QDate date = QDate::fromString(rx.cap(1), "yyyy-MM-dd");
+    QTime clock(0, 0, 0);
+    if (!rx.cap(2).isEmpty())
+        clock = QTime::fromString(rx.cap(2) + (rx.cap(3).isEmpty() ? ":00" : rx.cap(3)), "hh:mm:ss");
+    if (!date.isValid() || !clock.isValid())
+    {
+        qDebug() << "toEpoch: can't parse " << str;
+        return invalid;
+    }
+
+    epoch = QDateTime(date, clock, Qt::UTC).toTime_t();
+    QString zone = rx.cap(4);
+    if (zone.length() > 1)
+    {
+        zone.remove(':');
+        int zoneOffset = zone.mid(1, 2).toInt() * 3600 + zone.mid(3, 2).toInt() * 60;
+        if (zone.at(0) == '-')
+            zoneOffset = -zoneOffset;
+        epoch -= zoneOffset;
+    }
+    else if (zone.isEmpty())
+    {
+        epoch -= offset;
+    }
+    return epoch;
+}
+
+QVariantList
+SqlUtilities::toEpoch(const QVariantList &times,
+                      int offset)
+{
+    QVariantList ret;
+    for (int i = 0; i < times.size(); ++i)
+        ret << toEpoch(times.at(i), offset);
+    return ret;
+}
+
+QString
+SqlUtilities::formatEpoch(const QVariant &epoch,
+                          const QString &format)
+{
+    bool ok = false;
+    uint seconds = epoch.toString().toUInt(&ok);
+    if (!ok)
+        return epoch.toString();
+    return QDateTime::fromTime_t(seconds).toLocalTime().toString(format);
+}
+
+void
+SqlUtilities::createTables(int dbVersion)
+{
+    QString createMetaSql = "CREATE TABLE entomologist(db_version INT)";
+    QString createTrackerSql = "CREATE TABLE trackers(id INTEGER PRIMARY KEY,"
+                                                      "type TEXT,"
+                                                      "name TEXT,"
+                                                      "url TEXT,"
                                                       "username TEXT,"
                                                       "password TEXT,"
                                                       "last_sync TEXT,"
@@ -616,7 +1795,8 @@ SqlUtilities::createTables(int dbVersion)
     QString createSearchSql = "CREATE TABLE search_results (id INTEGER PRIMARY KEY,"
                                                             "tracker_name TEXT,"
                                                             "bug_id TEXT,"
-                                                            "summary TEXT)";
+                                                            "summary TEXT,"
+                                                            "UNIQUE (tracker_name, bug_id) ON CONFLICT IGNORE)";
 
     QString createBugzillaSql = "CREATE TABLE %1 (id INTEGER PRIMARY KEY,"
                                               "highlight_type INTEGER DEFAULT 0,"
@@ -633,7 +1813,7 @@ SqlUtilities::createTables(int dbVersion)
                                               "bug_type TEXT,"
                                               "bug_state TEXT,"
                                               "resolution TEXT,"
-                                              "last_modified TEXT)";
+                                              "last_modified INTEGER)";
 
     QString createTracSql = "CREATE TABLE %1 (id INTEGER PRIMARY KEY,"
                                               "highlight_type INTEGER DEFAULT 0,"
@@ -651,7 +1831,7 @@ SqlUtilities::createTables(int dbVersion)
                                               "bug_type TEXT,"
                                               "bug_state TEXT,"
                                               "description TEXT,"
-                                              "last_modified TEXT)";
+                                              "last_modified INTEGER)";
 
     QString createMantisSql = "CREATE TABLE %1 (id INTEGER PRIMARY KEY,"
                                               "highlight_type INTEGER DEFAULT 0,"
@@ -672,7 +1852,7 @@ SqlUtilities::createTables(int dbVersion)
                                               "bug_type TEXT,"
                                               "bug_state TEXT,"
                                               "resolution TEXT,"
-                                              "last_modified TEXT)";
+                                              "last_modified INTEGER)";
 
     QString createCommentsSql = "CREATE TABLE %1 (id INTEGER PRIMARY KEY,"
                                "tracker_id INTEGER,"
@@ -680,7 +1860,7 @@ SqlUtilities::createTables(int dbVersion)
                                "comment_id INTEGER,"
                                "author TEXT,"
                                "comment TEXT,"
-                               "timestamp TEXT,"
+                               "timestamp INTEGER,"
                                "private INTEGER)";
 
     qDebug() << "Creating tables";
@@ -705,163 +1885,462 @@ SqlUtilities::createTables(int dbVersion)
     directExec(db, QString("INSERT INTO entomologist (db_version) VALUES (%1)").arg(dbVersion));
 }
 
-void
-SqlUtilities::clearSearch()
+void
+SqlUtilities::clearSearch()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    directExec(db, "DELETE FROM search_results");
+}
+
+void
+SqlUtilities::clearRecentBugs(const QString &tableName,
+                              const QString &trackerId)
+{
+    QString sql = QString("UPDATE %1 SET highlight_type = 0 WHERE highlight_type = %2 AND tracker_id = :tracker_id")
+                  .arg(tableName)
+                  .arg(QString::number(HIGHLIGHT_RECENT));
+    QSqlQuery q(mDatabase);
+    q.prepare(sql);
+    q.bindValue(":tracker_id", trackerId);
+    beginWrite();
+    bool ok = SqlProfiler::exec(q, mDatabase);
+    if (!ok)
+    {
+        qDebug() << "clearRecentBugs: " << q.lastError().text();
+        emit failure(q.lastError().text());
+    }
+    endWrite(ok);
+}
+
+void
+SqlUtilities::directExec(QSqlDatabase db, const QString &sql)
+{
+    QSqlQuery query(db);
+    if (!query.exec(sql))
+    {
+        qDebug() << "directExec failed: " << db.lastError().text();
+        qDebug() << "directExec: Failed SQL: " << sql;
+        ErrorHandler::handleError("Couldn't execute SQL.", db.lastError().text());
+        exit(1);
+    }
+}
+
+void
+SqlUtilities::saveCredentials(int id,
+                           const QString &username,
+                           const QString &password)
+{
+    QSqlQuery q(mDatabase);
+    q.prepare("UPDATE trackers SET username=:username, password=:password WHERE id=:id");
+    q.bindValue(":id", id);
+    q.bindValue(":username", username);
+    q.bindValue(":password", password);
+    if (!q.exec())
+    {
+        qDebug() << "saveCredentials: Couldn't update credentials: " << q.lastError().text();
+        emit failure(q.lastError().text());
+    }
+}
+void
+SqlUtilities::insertBugComments(SqlRecordBatch commentBatch)
+{
+    if (commentBatch.isEmpty())
+    {
+        emit commentFinished();
+        return;
+    }
+
+    QSqlQuery q(mDatabase);
+    bool error = false;
+    beginWrite();
+    QString sql = "DELETE FROM comments WHERE bug_id=:bug_id AND tracker_id=:tracker_id";
+    q.prepare(sql);
+    q.bindValue(":bug_id", commentBatch.value(0, SqlRecordBatch::COLUMN_BUG_ID));
+    q.bindValue(":tracker_id", commentBatch.value(0, SqlRecordBatch::COLUMN_TRACKER_ID));
+    q.exec();
+
+    if (!execCommentBatch(commentBatch))
+        error = true;
+
+    endWrite(!error);
+    emit commentFinished();
+
+}
+
+void
+SqlUtilities::insertComments(SqlRecordBatch commentBatch)
+{
+    bool error = false;
+    beginWrite();
+    if (!execCommentBatch(commentBatch))
+        error = true;
+    endWrite(!error);
+    emit commentFinished();
+}
+
+bool
+SqlUtilities::execCommentBatch(const SqlRecordBatch &commentBatch)
+{
+    if (commentBatch.isEmpty())
+        return true;
+
+    QSettings settings("Entomologist");
+    int threshold = settings.value("comment-compress-threshold", 4096).toInt();
+    QVariantList comments = commentBatch.values(SqlRecordBatch::COLUMN_COMMENT);
+    QVariantList stored;
+    QList<int> indexRows;
+    QVariantList indexText;
+    for (int i = 0; i < comments.size(); ++i)
+    {
+        QVariant value = compressText(comments.at(i).toString(), threshold);
+        stored << value;
+        if (value.type() == QVariant::ByteArray)
+        {
+            indexRows << i;
+            indexText << comments.at(i);
+        }
+    }
+
+    QSqlQuery q(mDatabase);
+    qlonglong lastId = 0;
+    if (!indexRows.isEmpty())
+    {
+        if (!q.exec("SELECT MAX(id) FROM comments") || !q.next())
+        {
+            qDebug() << "execCommentBatch: couldn't read the last comment id: " << q.lastError().text();
+            emit failure(q.lastError().text());
+            return false;
+        }
+        lastId = q.value(0).toLongLong();
+    }
+
+    QString sql = "INSERT INTO comments (tracker_id, bug_id, comment_id, author, comment, timestamp, private)"
+                  " VALUES (?, ?, ?, ?, ?, ?, ?)";
+    q.prepare(sql);
+    q.addBindValue(commentBatch.values(SqlRecordBatch::COLUMN_TRACKER_ID));
+    q.addBindValue(commentBatch.values(SqlRecordBatch::COLUMN_BUG_ID));
+    q.addBindValue(commentBatch.values(SqlRecordBatch::COLUMN_COMMENT_ID));
+    q.addBindValue(commentBatch.values(SqlRecordBatch::COLUMN_AUTHOR));
+    q.addBindValue(stored);
+    q.addBindValue(toEpoch(commentBatch.values(SqlRecordBatch::COLUMN_TIMESTAMP)));
+    q.addBindValue(commentBatch.values(SqlRecordBatch::COLUMN_PRIVATE));
+    if (!SqlProfiler::execBatch(q, mDatabase))
+    {
+        qDebug() << "execCommentBatch failed: " << q.lastError().text();
+        emit failure(q.lastError().text());
+        return false;
+    }
+
+    // The FTS triggers skip compressed rows, so index their plain text here.
+    // comments.id has no AUTOINCREMENT, so each row got MAX(id) + 1 and the
+    // batch's rows are numbered in order from lastId + 1.  comment_id can't
+    // be used to find them: it isn't unique, and Bugzilla leaves it empty.
+    if (!indexRows.isEmpty() && mDatabase.tables().contains("comments_fts"))
+    {
+        if (q.lastInsertId().toLongLong() != lastId + comments.size())
+        {
+            qDebug() << "execCommentBatch: the comment ids aren't contiguous";
+            emit failure("Couldn't index the compressed comments");
+            return false;
+        }
+
+        QVariantList indexIds;
+        for (int i = 0; i < indexRows.size(); ++i)
+            indexIds << lastId + 1 + indexRows.at(i);
+
+        QSqlQuery fts(mDatabase);
+        fts.prepare("INSERT INTO comments_fts (docid, comment) VALUES (?, ?)");
+        fts.addBindValue(indexIds);
+        fts.addBindValue(indexText);
+        if (!SqlProfiler::execBatch(fts, mDatabase))
+        {
+            qDebug() << "execCommentBatch: couldn't index compressed comments: " << fts.lastError().text();
+            emit failure(fts.lastError().text());
+            return false;
+        }
+    }
+    return true;
+}
+
+QVariant
+SqlUtilities::compressText(const QString &text, int threshold)
 {
-    QSqlDatabase db = QSqlDatabase::database();
-    directExec(db, "DELETE FROM search_results");
+    QByteArray utf8 = text.toUtf8();
+    if ((threshold <= 0) || (utf8.size() < threshold))
+        return text;
+
+    QByteArray compressed = qCompress(utf8);
+    if (compressed.size() >= utf8.size())
+        return text;
+    return compressed;
 }
 
-void
-SqlUtilities::clearRecentBugs(const QString &tableName)
+QString
+SqlUtilities::expandText(const QVariant &value)
 {
-    QSqlDatabase db = QSqlDatabase::database();
-    QString sql = QString("UPDATE %1 SET highlight_type = 0 WHERE highlight_type = %2")
-                  .arg(tableName)
-                  .arg(QString::number(HIGHLIGHT_RECENT));
-    directExec(db, sql);
+    if (value.type() != QVariant::ByteArray)
+        return value.toString();
+    return QString::fromUtf8(qUncompress(value.toByteArray()));
 }
 
-void
-SqlUtilities::directExec(QSqlDatabase db, const QString &sql)
+int
+SqlUtilities::pragmaValue(const QString &pragma)
 {
-    QSqlQuery query(db);
-    if (!query.exec(sql))
+    QSqlQuery q(mDatabase);
+    if (!q.exec(QString("PRAGMA %1").arg(pragma)) || !q.next())
     {
-        qDebug() << "directExec failed: " << db.lastError().text();
-        qDebug() << "directExec: Failed SQL: " << sql;
-        ErrorHandler::handleError("Couldn't execute SQL.", db.lastError().text());
-        exit(1);
+        qDebug() << "pragmaValue: " << pragma << ": " << q.lastError().text();
+        return -1;
     }
+    return q.value(0).toInt();
 }
 
-void
-SqlUtilities::saveCredentials(int id,
-                           const QString &username,
-                           const QString &password)
+// Removes up to one batch of the rows matching condition from a bug table,
+// along with their cached comments and attachments, in its own short
+// transaction.  Returns false once there is nothing left to remove.
+bool
+SqlUtilities::pruneSearchBatch(const QString &table,
+                               const QString &condition,
+                               int &removed)
 {
-    QSqlQuery q;
-    q.prepare("UPDATE trackers SET username=:username, password=:password WHERE id=:id");
-    q.bindValue(":id", id);
-    q.bindValue(":username", username);
-    q.bindValue(":password", password);
-    if (!q.exec())
+    QString select = QString("INSERT INTO pruned_bugs SELECT id, tracker_id, bug_id FROM %1 "
+                             "WHERE bug_type IN ('Searched', 'SearchedTemp') AND %2 "
+                             "AND NOT EXISTS (SELECT 1 FROM shadow_%1 WHERE shadow_%1.tracker_id = %1.tracker_id "
+                             "AND shadow_%1.bug_id = %1.bug_id) LIMIT 500")
+                     .arg(table).arg(condition);
+    QString children = "DELETE FROM %1 WHERE id IN (SELECT %1.id FROM pruned_bugs "
+                       "JOIN %1 ON %1.tracker_id = pruned_bugs.tracker_id AND %1.bug_id = pruned_bugs.bug_id)";
+
+    QSqlQuery q(mDatabase);
+    beginWrite();
+    bool ok = q.exec("DELETE FROM pruned_bugs") && q.exec(select);
+    int batch = ok ? q.numRowsAffected() : 0;
+    if (ok && (batch > 0))
     {
-        qDebug() << "saveCredentials: Couldn't update credentials: " << q.lastError().text();
-        emit failure(q.lastError().text());
+        ok = q.exec(QString(children).arg("comments"))
+             && q.exec(QString(children).arg("attachments"))
+             && q.exec(QString("DELETE FROM %1 WHERE id IN (SELECT id FROM pruned_bugs)").arg(table));
+    }
+
+    if (!ok)
+    {
+        qDebug() << "pruneSearchBatch: " << table << ": " << q.lastError().text();
+        endWrite(false);
+        return false;
     }
+
+    endWrite(true);
+    removed += batch;
+    return batch == 500;
 }
-void
-SqlUtilities::insertBugComments(QList<QMap<QString, QString> >commentList)
+
+// Searched bugs are kept for the search-retention-days setting, and each
+// bug table keeps at most search-retention-max-rows of them.  Bugs with
+// unsent changes are kept either way.  The deletes go in batches of 500
+// so a large backlog doesn't hold the write lock for long.
+int
+SqlUtilities::pruneSearches(int days, int maxRows)
 {
-    if (commentList.size() == 0)
+    QSqlQuery q(mDatabase);
+    if (!q.exec("CREATE TEMP TABLE IF NOT EXISTS pruned_bugs (id INTEGER PRIMARY KEY, tracker_id INTEGER, bug_id INTEGER)"))
     {
-        emit commentFinished();
-        return;
+        qDebug() << "pruneSearches: " << q.lastError().text();
+        return 0;
     }
 
-    QSqlQuery q;
-    QString sql = "DELETE FROM comments WHERE bug_id=:bug_id AND tracker_id=:tracker_id";
-    q.prepare(sql);
-    q.bindValue(":bug_id", commentList.at(0).value("bug_id"));
-    q.bindValue(":tracker_id", commentList.at(0).value("tracker_id"));
-    q.exec();
-
-    sql = "INSERT INTO comments (tracker_id, bug_id, comment_id, author, comment, timestamp, private)"
-                  " VALUES (:tracker_id, :bug_id, :comment_id, :author, :comment, :timestamp, :private)";
-    q.prepare(sql);
-    for (int i = 0; i < commentList.size(); ++i)
-    {
-        QMap<QString,QString> parameterMap = commentList.at(i);
-        q.bindValue(":tracker_id", parameterMap["tracker_id"]);
-        q.bindValue(":bug_id", parameterMap["bug_id"]);
-        q.bindValue(":comment_id", parameterMap["comment_id"]);
-        q.bindValue(":author", parameterMap["author"]);
-        q.bindValue(":comment", parameterMap["comment"]);
-        q.bindValue(":timestamp", parameterMap["timestamp"]);
-        q.bindValue(":private", parameterMap["private"].toInt());
-        if (!q.exec())
-        {
-            emit failure(q.lastError().text());
-            break;
-        }
+    QStringList bugTables;
+    bugTables << "bugzilla" << "trac" << "mantis";
+    QString expired = QString("searched_at < strftime('%s', 'now') - %1").arg(days * 86400);
+    QString overCap = "id IN (SELECT id FROM %1 WHERE bug_type IN ('Searched', 'SearchedTemp') "
+                      "ORDER BY searched_at DESC LIMIT -1 OFFSET %2)";
+    int removed = 0;
+    for (int i = 0; i < bugTables.size(); ++i)
+    {
+        QString table = bugTables.at(i);
+        while (pruneSearchBatch(table, expired, removed)) {}
+        if (maxRows > 0)
+            while (pruneSearchBatch(table, QString(overCap).arg(table).arg(maxRows), removed)) {}
     }
-    emit commentFinished();
 
+    if (removed > 0)
+        qDebug() << "pruneSearches: removed " << removed << " searched bugs";
+    return removed;
 }
 
+// Run by SqlMaintenance while nothing is syncing.  The request is never
+// grouped with others, so this isn't inside a transaction and can VACUUM.
 void
-SqlUtilities::insertComments(QList<QMap<QString, QString> > commentList)
+SqlUtilities::maintainDatabase(int slicePages, int tasks)
 {
-    QSqlQuery q;
-    QString sql = "INSERT INTO comments (tracker_id, bug_id, comment_id, author, comment, timestamp, private)"
-                  " VALUES (:tracker_id, :bug_id, :comment_id, :author, :comment, :timestamp, :private)";
-    q.prepare(sql);
-    for (int i = 0; i < commentList.size(); ++i)
-    {
-        QMap<QString,QString> parameterMap = commentList.at(i);
-        q.bindValue(":tracker_id", parameterMap["tracker_id"]);
-        q.bindValue(":bug_id", parameterMap["bug_id"]);
-        q.bindValue(":comment_id", parameterMap["comment_id"]);
-        q.bindValue(":author", parameterMap["author"]);
-        q.bindValue(":comment", parameterMap["comment"]);
-        q.bindValue(":timestamp", parameterMap["timestamp"]);
-        q.bindValue(":private", parameterMap["private"].toInt());
-        if (!q.exec())
+    int pageSize = pragmaValue("page_size");
+    int pagesBefore = pragmaValue("page_count");
+    int freeBefore = pragmaValue("freelist_count");
+    bool worked = false;
+    QSqlQuery q(mDatabase);
+
+    // Pruning goes first, so the pages it frees are reclaimed below
+    if (tasks & MAINTAIN_PRUNE_SEARCHES)
+    {
+        QSettings settings("Entomologist");
+        if (pruneSearches(settings.value("search-retention-days", 30).toInt(),
+                          settings.value("search-retention-max-rows", 1000).toInt()) > 0)
         {
-            emit failure(q.lastError().text());
-            break;
+            worked = true;
+            freeBefore = pragmaValue("freelist_count");
         }
     }
-    emit commentFinished();
+
+    int autoVacuum = pragmaValue("auto_vacuum");
+    if ((tasks & MAINTAIN_CONVERT) && (autoVacuum != 2))
+    {
+        // The full VACUUM holds up the writer for as long as it takes, so
+        // a conversion that doesn't work is recorded and not tried again
+        qDebug() << "maintainDatabase: converting to auto_vacuum=INCREMENTAL";
+        if (!q.exec("PRAGMA auto_vacuum=INCREMENTAL") || !q.exec("VACUUM"))
+            qDebug() << "maintainDatabase: VACUUM failed: " << q.lastError().text();
+        if (pragmaValue("auto_vacuum") != 2)
+        {
+            qDebug() << "maintainDatabase: couldn't convert to auto_vacuum=INCREMENTAL, giving up";
+            QSettings settings("Entomologist");
+            settings.setValue("db-auto-vacuum-failed", true);
+        }
+        worked = true;
+    }
+    else if ((tasks & MAINTAIN_VACUUM) && (autoVacuum == 2) && (freeBefore > 0))
+    {
+        if (!q.exec(QString("PRAGMA incremental_vacuum(%1)").arg(slicePages)))
+            qDebug() << "maintainDatabase: incremental_vacuum failed: " << q.lastError().text();
+        while (q.next()) {}
+        worked = true;
+    }
+
+    if (tasks & MAINTAIN_ANALYZE)
+    {
+        if (!q.exec("ANALYZE"))
+            qDebug() << "maintainDatabase: ANALYZE failed: " << q.lastError().text();
+        worked = true;
+    }
+
+    if (tasks & MAINTAIN_INTEGRITY)
+    {
+        if (!q.exec("PRAGMA integrity_check(20)"))
+        {
+            qDebug() << "maintainDatabase: integrity_check failed: " << q.lastError().text();
+        }
+        else
+        {
+            while (q.next())
+            {
+                QString result = q.value(0).toString();
+                if (result != "ok")
+                    qDebug() << "maintainDatabase: integrity_check: " << result;
+            }
+        }
+        worked = true;
+    }
+
+    if (!worked)
+        return;
+
+    // Hand the freed pages back to the main database file
+    if (!q.exec("PRAGMA wal_checkpoint"))
+        qDebug() << "maintainDatabase: wal_checkpoint failed: " << q.lastError().text();
+    q.finish();
+
+    int pagesAfter = pragmaValue("page_count");
+    int freeAfter = pragmaValue("freelist_count");
+    qDebug() << "maintainDatabase: size " << qlonglong(pagesBefore) * pageSize
+             << " -> " << qlonglong(pagesAfter) * pageSize
+             << " bytes, free pages " << freeBefore << " -> " << freeAfter;
 }
 
 void
 SqlUtilities::deleteBugs(const QString &trackerId)
 {
     QString sql = QString("DELETE FROM bugs WHERE tracker_id=%1").arg(trackerId);
-    QSqlQuery q;
+    QSqlQuery q(mDatabase);
     if (!q.exec())
         emit failure(q.lastError().text());
 }
 
+// Runs on the writer thread, so the serializing and compressing stay off
+// the GUI thread too
+void
+SqlUtilities::saveSyncCheckpoint(const QString &trackerId,
+                                 const QString &phase,
+                                 int chunk,
+                                 const QString &since,
+                                 const QString &started,
+                                 const QVariant &data)
+{
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out << data;
+
+    QSqlQuery q(mDatabase);
+    q.prepare("INSERT OR REPLACE INTO sync_checkpoints (tracker_id, phase, chunk, since, started, data) "
+              "VALUES (:tracker_id, :phase, :chunk, :since, :started, :data)");
+    q.bindValue(":tracker_id", trackerId);
+    q.bindValue(":phase", phase);
+    q.bindValue(":chunk", chunk);
+    q.bindValue(":since", since);
+    q.bindValue(":started", started);
+    q.bindValue(":data", qCompress(bytes));
+    // A lost checkpoint only means redoing some of the sync
+    if (!SqlProfiler::exec(q, mDatabase))
+        qDebug() << "saveSyncCheckpoint: " << q.lastError().text();
+}
+
 void
 SqlUtilities::syncDB(int id, const QString &timestamp)
 {
     QString sql = "UPDATE trackers SET last_sync = :last_sync WHERE id = :id";
-    QSqlQuery q;
+    QSqlQuery q(mDatabase);
     q.prepare(sql);
     q.bindValue(":last_sync", timestamp);
     q.bindValue(":id", id);
     if (!q.exec())
+    {
         emit failure(q.lastError().text());
+        return;
+    }
+
+    // The sync they were for is done
+    q.prepare("DELETE FROM sync_checkpoints WHERE tracker_id = :id");
+    q.bindValue(":id", id);
+    if (!q.exec())
+        qDebug() << "syncDB: couldn't clear the checkpoints: " << q.lastError().text();
 }
 
 QString
-SqlUtilities::getBugDescription(const QString &table, const QString &bugId)
+SqlUtilities::getBugDescription(const QString &table,
+                                const QString &bugId,
+                                QSqlDatabase db)
 {
-    QSqlQuery q;
+    SQL_WATCHDOG("getBugDescription");
+    QSqlQuery q(db);
     QString ret;
-    if (!q.prepare(QString("SELECT description FROM %1 WHERE bug_id=:bug").arg(table)))    {
+    if (!SqlStatementCache::prepare(q, QString("SELECT description FROM %1 WHERE bug_id=:bug").arg(table), db))    {
         qDebug() << "getBugDescription: Could not prepare: " << q.lastError().text();
         return "";
     }
 
-    q.bindValue(":table", table);
     q.bindValue(":bug", bugId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q, db))
     {
         qDebug() << "getBugDescription: Could not exec: " << q.lastError().text();
         return "";
     }
     q.next();
     ret = q.value(0).toString();
+    q.finish();
     return ret;
 }
 
 QMap<QString, QString>
 SqlUtilities::tracBugDetail(const QString &rowId)
 {
+    SQL_WATCHDOG("tracBugDetail");
     QMap<QString, QString> ret;
     QRegExp removeFont("<[^>]*>");
 
@@ -887,7 +2366,7 @@ SqlUtilities::tracBugDetail(const QString &rowId)
     }
 
     q.bindValue(":id", rowId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q))
     {
         qDebug() << "Could not exec tracBugDetails: " << q.lastError().text();
         qDebug() << q.lastQuery();
@@ -915,6 +2394,7 @@ SqlUtilities::tracBugDetail(const QString &rowId)
 QMap<QString, QString>
 SqlUtilities::bugzillaBugDetail(const QString &rowId)
 {
+    SQL_WATCHDOG("bugzillaBugDetail");
     QMap<QString, QString> ret;
     QRegExp removeFont("<[^>]*>");
     QString details = "SELECT bugzilla.tracker_id, trackers.name, bugzilla.bug_id, bugzilla.last_modified,"
@@ -939,7 +2419,7 @@ SqlUtilities::bugzillaBugDetail(const QString &rowId)
     }
 
     q.bindValue(":id", rowId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q))
     {
         qDebug() << "Could not exec bugzillaBugDetails: " << q.lastError().text();
         qDebug() << q.lastQuery();
@@ -966,6 +2446,7 @@ SqlUtilities::bugzillaBugDetail(const QString &rowId)
 QMap<QString, QString>
 SqlUtilities::mantisBugDetail(const QString &rowId)
 {
+    SQL_WATCHDOG("mantisBugDetail");
     QMap<QString, QString> ret;
     QRegExp removeFont("<[^>]*>");
 
@@ -994,7 +2475,7 @@ SqlUtilities::mantisBugDetail(const QString &rowId)
     }
 
     q.bindValue(":id", rowId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q))
     {
         qDebug() << "Could not exec mantisBugDetails: " << q.lastError().text();
         qDebug() << q.lastQuery();
@@ -1025,12 +2506,13 @@ SqlUtilities::mantisBugDetail(const QString &rowId)
 QMap<QString, QString>
 SqlUtilities::attachmentDetails(int rowId)
 {
+    SQL_WATCHDOG("attachmentDetails");
     QSqlQuery q;
     QMap<QString, QString> ret;
     QString sql = QString("SELECT id, attachment_id, file_size,"
                           "filename, last_modified, summary, content_type, creator, private, bug_id "
                           "FROM attachments WHERE id = %1").arg(rowId);
-    if (!q.exec(sql))
+    if (!SqlProfiler::exec(q, sql))
     {
         qDebug() << "Error executing attachmentDetails: " << q.lastError().text();
     }
@@ -1055,17 +2537,22 @@ SqlUtilities::attachmentDetails(int rowId)
 
 QList< QMap<QString, QString> >
 SqlUtilities::loadAttachments(const QString &trackerId,
-                              const QString &bugId)
+                              const QString &bugId,
+                              QSqlDatabase db)
 {
-    QSqlQuery q;
+    SQL_WATCHDOG("loadAttachments");
+    QSqlQuery q(db);
     QList< QMap<QString, QString> > ret;
 
-    QString sql = QString("SELECT id, attachment_id, file_size,"
-                          "filename, last_modified, summary, content_type, creator, private "
-                          "FROM attachments WHERE tracker_id = %1 AND bug_id = %2").arg(trackerId, bugId);
-    if (!q.exec(sql))
+    QString sql = "SELECT id, attachment_id, file_size,"
+                  "filename, last_modified, summary, content_type, creator, private "
+                  "FROM attachments WHERE tracker_id = :tracker_id AND bug_id = :bug_id";
+    SqlStatementCache::prepare(q, sql, db);
+    q.bindValue(":tracker_id", trackerId);
+    q.bindValue(":bug_id", bugId);
+    if (!SqlProfiler::exec(q, db))
     {
-        qDebug() << "Error preparing loadComments: " << q.lastError().text();
+        qDebug() << "Error executing loadAttachments: " << q.lastError().text();
     }
 
     while (q.next())
@@ -1098,9 +2585,11 @@ SqlUtilities::clearAttachments(int trackerId, int bugId)
 QList< QMap<QString, QString> >
 SqlUtilities::loadComments(const QString &trackerId,
                            const QString &bugId,
-                           bool shadow)
+                           bool shadow,
+                           QSqlDatabase db)
 {
-    QSqlQuery q;
+    SQL_WATCHDOG("loadComments");
+    QSqlQuery q(db);
     QList< QMap<QString, QString> > ret;
     QString prefix = "";
     if (shadow)
@@ -1109,7 +2598,7 @@ SqlUtilities::loadComments(const QString &trackerId,
                           "FROM %1comments WHERE tracker_id=:tracker AND bug_id=:bug_id")
                           .arg(prefix);
 
-    if (!q.prepare(sql))
+    if (!SqlStatementCache::prepare(q, sql, db))
     {
         qDebug() << "Error preparing loadComments: " << q.lastError().text();
         return ret;
@@ -1117,7 +2606,7 @@ SqlUtilities::loadComments(const QString &trackerId,
 
     q.bindValue(":tracker", trackerId);
     q.bindValue(":bug_id", bugId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q, db))
     {
         qDebug() << "Error executing loadComments: " << q.lastError().text();
         return ret;
@@ -1128,7 +2617,7 @@ SqlUtilities::loadComments(const QString &trackerId,
         QMap<QString, QString> val;
         val["comment_id"] = q.value(0).toString();
         val["author"] = q.value(1).toString();
-        val["comment"] = q.value(2).toString();
+        val["comment"] = expandText(q.value(2));
         val["timestamp"] = q.value(3).toString();
         val["private"] = q.value(4).toString();
         ret << val;
@@ -1140,6 +2629,7 @@ SqlUtilities::loadComments(const QString &trackerId,
 QList< QMap<QString, QString> >
 SqlUtilities::getCommentsChangelog()
 {
+    SQL_WATCHDOG("getCommentsChangelog");
     QList< QMap<QString, QString> > ret;
     QString commentsQuery = "SELECT trackers.name, "
                             "shadow_comments.bug_id, "
@@ -1148,7 +2638,7 @@ SqlUtilities::getCommentsChangelog()
                             "shadow_comments.private "
                             "from shadow_comments join trackers ON shadow_comments.tracker_id = trackers.id";
     QSqlQuery q(commentsQuery);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q))
     {
         qDebug() << "Error loading comments changelog: " << q.lastError().text();
         return ret;
@@ -1170,461 +2660,85 @@ SqlUtilities::getCommentsChangelog()
 QVariantList
 SqlUtilities::getTracChangelog()
 {
-    QVariantList retVal;
-    QString bugsQuery = "SELECT trackers.name, "
-                   "shadow_trac.bug_id, "
-                   "trac.severity, "
-                   "shadow_trac.severity, "
-                   "trac.priority, "
-                   "shadow_trac.priority, "
-                   "trac.assigned_to, "
-                   "shadow_trac.assigned_to, "
-                   "trac.status, "
-                   "shadow_trac.status, "
-                   "trac.summary, "
-                   "shadow_trac.summary, "
-                   "trac.component, "
-                   "shadow_trac.component,"
-                   "trac.milestone,"
-                   "shadow_trac.milestone,"
-                   "trac.version,"
-                   "shadow_trac.version, "
-                   "trac.resolution,"
-                   "shadow_trac.resolution,"
-                   "shadow_trac.id "
-                   "from shadow_trac left outer join trac on shadow_trac.bug_id = trac.bug_id AND shadow_trac.tracker_id = trac.tracker_id "
-                   "join trackers ON shadow_trac.tracker_id = trackers.id";
-    QSqlQuery q(bugsQuery);
-    if (!q.exec())
-    {
-        qDebug() << "getTracChangelog error: " << q.lastError().text();
-        qDebug() << "getTracChangelog error: " << q.lastQuery();
-        return retVal;
-    }
-
-    while (q.next())
-    {
-        QVariantList ret;
-        if (!q.value(3).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Severity",
-                                     q.value(2).toString(),
-                                     q.value(3).toString());
-        }
-
-        if (!q.value(5).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Priority",
-                                     q.value(4).toString(),
-                                     q.value(5).toString());
-        }
-
-        if (!q.value(7).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Assigned To",
-                                     q.value(6).toString(),
-                                     q.value(7).toString());
-        }
-
-        if (!q.value(9).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Status",
-                                     q.value(8).toString(),
-                                     q.value(9).toString());
-        }
-
-        if (!q.value(11).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Summary",
-                                     q.value(10).toString(),
-                                     q.value(11).toString());
-        }
-
-        if (!q.value(13).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Component",
-                                     q.value(12).toString(),
-                                     q.value(13).toString());
-        }
-
-        if (!q.value(15).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Milestone",
-                                     q.value(14).toString(),
-                                     q.value(15).toString());
-        }
-
-        if (!q.value(17).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Version",
-                                     q.value(16).toString(),
-                                     q.value(17).toString());
-        }
-
-        if (!q.value(19).isNull())
-        {
-            ret << newChangelogEntry("shadow_trac",
-                                     q.value(20).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Resolution",
-                                     q.value(18).toString(),
-                                     q.value(19).toString());
-        }
-
-        if (ret.size() > 0)
-            retVal.prepend(ret);
-    }
-
-    return(retVal);
+    return(pendingChangelog("shadow_trac"));
 }
 
 QVariantList
 SqlUtilities::getBugzillaChangelog()
 {
-    QVariantList retVal;
-    QString bugsQuery = "SELECT trackers.name, "
-                   "shadow_bugzilla.bug_id, "
-                   "bugzilla.severity, "
-                   "shadow_bugzilla.severity, "
-                   "bugzilla.priority, "
-                   "shadow_bugzilla.priority, "
-                   "bugzilla.assigned_to, "
-                   "shadow_bugzilla.assigned_to, "
-                   "bugzilla.status, "
-                   "shadow_bugzilla.status, "
-                   "bugzilla.summary, "
-                   "shadow_bugzilla.summary, "
-                   "bugzilla.component, "
-                   "shadow_bugzilla.component,"
-                   "bugzilla.product,"
-                   "shadow_bugzilla.product,"
-                   "shadow_bugzilla.id, "
-                   "bugzilla.resolution,"
-                   "shadow_bugzilla.resolution "
-                   "from shadow_bugzilla left outer join bugzilla on shadow_bugzilla.bug_id = bugzilla.bug_id AND shadow_bugzilla.tracker_id = bugzilla.tracker_id "
-                   "join trackers ON shadow_bugzilla.tracker_id = trackers.id";
-    QSqlQuery q(bugsQuery);
-    if (!q.exec())
-    {
-        qDebug() << "getBugzillaChangelog error: " << q.lastError().text();
-        qDebug() << "getBugzillaChangelog error: " << q.lastQuery();
-        return retVal;
-    }
-
-    while (q.next())
-    {
-        QVariantList ret;
-        if (!q.value(3).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Severity",
-                                     q.value(2).toString(),
-                                     q.value(3).toString());
-        }
-
-        if (!q.value(5).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Priority",
-                                     q.value(4).toString(),
-                                     q.value(5).toString());
-        }
-
-        if (!q.value(7).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Assigned To",
-                                     q.value(6).toString(),
-                                     q.value(7).toString());
-        }
-
-        if (!q.value(9).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Status",
-                                     q.value(8).toString(),
-                                     q.value(9).toString());
-        }
-
-        if (!q.value(11).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Summary",
-                                     q.value(10).toString(),
-                                     q.value(11).toString());
-        }
-
-        if (!q.value(13).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Component",
-                                     q.value(12).toString(),
-                                     q.value(13).toString());
-        }
-
-        if (!q.value(15).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Product",
-                                     q.value(14).toString(),
-                                     q.value(15).toString());
-        }
-
-        if (!q.value(18).isNull())
-        {
-            ret << newChangelogEntry("shadow_bugzilla",
-                                     q.value(16).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Resolution",
-                                     q.value(17).toString(),
-                                     q.value(18).toString());
-        }
-
-        if (ret.size() > 0)
-            retVal.prepend(ret);
-
-    }
-
-    return(retVal);
-
+    return(pendingChangelog("shadow_bugzilla"));
 }
 
 QVariantList
 SqlUtilities::getMantisChangelog()
 {
+    return(pendingChangelog("shadow_mantis"));
+}
+
+// Returns one list of changelog entries per shadow bug, read from
+// pending_changes rather than by scanning the shadow table.  The "from"
+// value is what the bug has now, which a sync may have changed since the
+// edit was made.
+QVariantList
+SqlUtilities::pendingChangelog(const QString &shadowTable)
+{
+    SQL_WATCHDOG("pendingChangelog");
     QVariantList retVal;
-    QString bugsQuery = "SELECT trackers.name, "
-                   "shadow_mantis.bug_id, "
-                   "mantis.severity, "
-                   "shadow_mantis.severity, "
-                   "mantis.priority, "
-                   "shadow_mantis.priority, "
-                   "mantis.assigned_to, "
-                   "shadow_mantis.assigned_to, "
-                   "mantis.status, "
-                   "shadow_mantis.status, "
-                   "mantis.summary, "
-                   "shadow_mantis.summary, "
-                   "mantis.category, "
-                   "shadow_mantis.category,"
-                   "mantis.project,"
-                   "shadow_mantis.project,"
-                   "mantis.product_version,"
-                   "shadow_mantis.product_version,"
-                   "mantis.reproducibility,"
-                   "shadow_mantis.reproducibility,"
-                   "mantis.os,"
-                   "shadow_mantis.os, "
-                   "mantis.os_version,"
-                   "shadow_mantis.os_version,"
-                   "shadow_mantis.id, "
-                   "mantis.resolution,"
-                   "shadow_mantis.resolution "
-                   "from shadow_mantis left outer join mantis on shadow_mantis.bug_id = mantis.bug_id AND shadow_mantis.tracker_id = mantis.tracker_id "
-                   "join trackers ON shadow_mantis.tracker_id = trackers.id";
-    QSqlQuery q(bugsQuery);
-    if (!q.exec())
+    QString table = shadowTable.mid(QString("shadow_").length());
+    QStringList fields = changelogFields().value(table);
+    QString current = "NULL";
+    if (!fields.isEmpty())
+    {
+        QStringList cases;
+        for (int f = 0; f < fields.size(); f += 2)
+            cases << QString("WHEN '%1' THEN %2.%3").arg(fields.at(f + 1)).arg(table).arg(fields.at(f));
+        current = QString("CASE pending_changes.column_label %1 END").arg(cases.join(" "));
+    }
+
+    QString sql = QString("SELECT pending_changes.shadow_id, trackers.name, pending_changes.bug_id, "
+                          "pending_changes.column_label, %2, pending_changes.new_value "
+                          "FROM pending_changes JOIN trackers ON pending_changes.tracker_id = trackers.id "
+                          "LEFT JOIN %1 ON %1.tracker_id = pending_changes.tracker_id "
+                          "AND %1.bug_id = pending_changes.bug_id "
+                          "WHERE pending_changes.tracker_table = :table "
+                          "ORDER BY pending_changes.shadow_id, pending_changes.id")
+                  .arg(table).arg(current);
+    QSqlQuery q;
+    if (!SqlStatementCache::prepare(q, sql))
     {
-        qDebug() << "getMantisChangelog error: " << q.lastError().text();
-        qDebug() << "getMantisChangelog error: " << q.lastQuery();
+        qDebug() << "pendingChangelog: could not prepare: " << q.lastError().text();
         return retVal;
     }
 
-    while (q.next())
+    q.bindValue(":table", shadowTable);
+    if (!SqlProfiler::exec(q))
     {
-        QVariantList ret;
-        if (!q.value(3).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Severity",
-                                     q.value(2).toString(),
-                                     q.value(3).toString());
-        }
-
-        if (!q.value(5).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Priority",
-                                     q.value(4).toString(),
-                                     q.value(5).toString());
-        }
-
-        if (!q.value(7).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Assigned To",
-                                     q.value(6).toString(),
-                                     q.value(7).toString());
-        }
-
-        if (!q.value(9).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Status",
-                                     q.value(8).toString(),
-                                     q.value(9).toString());
-        }
-
-        if (!q.value(11).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Summary",
-                                     q.value(10).toString(),
-                                     q.value(11).toString());
-        }
-
-        if (!q.value(13).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Category",
-                                     q.value(12).toString(),
-                                     q.value(13).toString());
-        }
-
-        if (!q.value(15).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Project",
-                                     q.value(14).toString(),
-                                     q.value(15).toString());
-        }
-
-        if (!q.value(17).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Product Version",
-                                     q.value(16).toString(),
-                                     q.value(17).toString());
-        }
-
-        if (!q.value(19).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Reproducibility",
-                                     q.value(18).toString(),
-                                     q.value(19).toString());
-        }
-
-        if (!q.value(21).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "OS",
-                                     q.value(20).toString(),
-                                     q.value(21).toString());
-        }
-
-        if (!q.value(23).isNull())
-        {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "OS Version",
-                                     q.value(22).toString(),
-                                     q.value(23).toString());
-        }
+        qDebug() << "pendingChangelog error: " << q.lastError().text();
+        return retVal;
+    }
 
-        if (!q.value(26).isNull())
+    QVariantList ret;
+    QString shadowId;
+    while (q.next())
+    {
+        if ((q.value(0).toString() != shadowId) && (ret.size() > 0))
         {
-            ret << newChangelogEntry("shadow_mantis",
-                                     q.value(24).toString(),
-                                     q.value(0).toString(),
-                                     q.value(1).toString(),
-                                     "Resolution",
-                                     q.value(25).toString(),
-                                     q.value(26).toString());
-        }
-
-        if (ret.size() > 0)
             retVal.prepend(ret);
-
+            ret.clear();
+        }
+        shadowId = q.value(0).toString();
+        ret << newChangelogEntry(shadowTable,
+                                 shadowId,
+                                 q.value(1).toString(),
+                                 q.value(2).toString(),
+                                 q.value(3).toString(),
+                                 q.value(4).toString(),
+                                 q.value(5).toString());
     }
 
+    if (ret.size() > 0)
+        retVal.prepend(ret);
+
     return(retVal);
 }
 
@@ -1674,6 +2788,9 @@ SqlUtilities::removeTracker(const QString &trackerId, const QString &trackerName
     q.exec(QString("DELETE FROM mantis WHERE tracker_id=%1").arg(trackerId));
     q.exec(QString("DELETE FROM shadow_mantis WHERE tracker_id=%1").arg(trackerId));
     q.exec(QString("DELETE FROM search_results WHERE tracker_name=\'%1\'").arg(trackerName));
+    q.exec(QString("DELETE FROM sync_checkpoints WHERE tracker_id=%1").arg(trackerId));
+    // After the bug rows, whose delete triggers would otherwise recreate it
+    q.exec(QString("DELETE FROM tracker_stats WHERE tracker_id=%1").arg(trackerId));
 }
 
 void
@@ -1715,9 +2832,10 @@ SqlUtilities::removeShadowBug(const QString &shadowTable,
                               const QString &bugId,
                               const QString &trackerId)
 {
+    SQL_WATCHDOG("removeShadowBug");
     QString query = QString("DELETE FROM %1 WHERE bug_id = :bug_id AND tracker_id = :tracker_id").arg(shadowTable);
     QSqlQuery q;
-    q.prepare(query);
+    SqlStatementCache::prepare(q, query);
     q.bindValue(":bug_id", bugId);
     q.bindValue(":tracker_id", trackerId);
     if (!q.exec())
@@ -1732,7 +2850,7 @@ SqlUtilities::removeShadowComment(const QString &bugId,
 {
     QString query = "DELETE FROM shadow_comments WHERE bug_id = :bug_id AND tracker_id = :tracker_id";
     QSqlQuery q;
-    q.prepare(query);
+    SqlStatementCache::prepare(q, query);
     q.bindValue(":bug_id", bugId);
     q.bindValue(":tracker_id", trackerId);
     if (!q.exec())
@@ -1749,7 +2867,7 @@ SqlUtilities::getMonitoredComponents(const QString &trackerId)
     QSqlQuery q;
     q.prepare(query);
     q.bindValue(":id", trackerId);
-    if (!q.exec())
+    if (!SqlProfiler::exec(q))
     {
         qDebug() << "getMonitoredComponents failed: " << q.lastError().text();
         return(ret);
@@ -1777,7 +2895,7 @@ SqlUtilities::getChangedBugzillaIds(const QString &trackerId)
     QStringList ret;
     QString query = QString("SELECT bug_id FROM shadow_bugzilla WHERE tracker_id = %1").arg(trackerId);
     QSqlQuery q;
-    if (!q.exec(query))
+    if (!SqlProfiler::exec(q, query))
     {
         qDebug() << "getChangedBugzillaIds SELECT failed: " << q.lastError().text();
         return ret;
@@ -1820,14 +2938,16 @@ SqlUtilities::updateSearchedBug(const QString &tableName,
 
 QStringList
 SqlUtilities::assignedToValues(const QString &table,
-                               const QString &trackerId)
+                               const QString &trackerId,
+                               QSqlDatabase db)
 {
+    SQL_WATCHDOG("assignedToValues");
     QString query = QString("SELECT DISTINCT assigned_to FROM %1 WHERE tracker_id = %2 "
                             "UNION SELECT DISTINCT assigned_to FROM shadow_%1 WHERE tracker_id = %2")
                     .arg(table, trackerId);
     QStringList ret;
-    QSqlQuery q;
-    if (!q.exec(query))
+    QSqlQuery q(db);
+    if (!SqlProfiler::exec(q, query, db))
     {
         qDebug() << "SqlUtilities::assignedToValues failed: " << q.lastError().text();
         qDebug() << q.lastQuery();
@@ -1848,7 +2968,7 @@ SqlUtilities::getTimezoneOffset(const QString &trackerId)
     QString query = QString("SELECT timezone_offset_in_seconds FROM trackers WHERE id = %1").arg(trackerId);
     QSqlQuery q;
     int ret = 0;
-    if (!q.exec(query))
+    if (!SqlProfiler::exec(q, query))
     {
         qDebug() << "SqlUtilities::getTimezoneOffset failed: " << q.lastError().text();
         return(0);
@@ -29,6 +29,8 @@
 #include <QSqlDatabase>
 #include <QStringList>
 #include <QVariant>
+
+#include "SqlRecordBatch.h"
 class QString;
 
 class SqlUtilities : public QObject
@@ -45,22 +47,44 @@ public:
         MULTI_INSERT_COMPONENTS = 1,
         MULTI_INSERT_SEARCH,
         MULTI_INSERT_ATTACHMENTS,
-        BUGS_INSERT_SEARCH
+        BUGS_INSERT_SEARCH,
+        // One page of a sync that's still going
+        BUGS_INSERT_PAGE
+    };
+
+    // Tasks for maintainDatabase(), OR'd together
+    enum {
+        MAINTAIN_VACUUM = 1,
+        MAINTAIN_ANALYZE = 2,
+        MAINTAIN_INTEGRITY = 4,
+        MAINTAIN_PRUNE_SEARCHES = 8,
+        // Switches an older database to incremental auto_vacuum, which
+        // takes one full VACUUM
+        MAINTAIN_CONVERT = 16
     };
 
     SqlUtilities();
     ~SqlUtilities();
 
+    // Used by SqlWriterThread to commit several requests at once
+    bool beginBatch();
+    bool commitBatch();
+
     // Returns the version of the schema
     static int dbVersion();
     static void updateDbVersion(int version);
 
     static void openDb(const QString &dbPath);
+    // Applies the per-connection pragmas (synchronous, cache_size, mmap_size)
+    static void configureConnection(QSqlDatabase db);
     static void closeDb();
 
     // Checks the various shadow tables to see
     // if the user has modified anything
-    static bool hasPendingChanges();
+    //
+    // The read helpers that take a QSqlDatabase are also run by
+    // SqlReaderThread on its own connection.
+    static bool hasPendingChanges(QSqlDatabase db = QSqlDatabase::database());
     static bool hasPendingChanges(const QString &shadowTable,
                                   const QString &trackerId);
 
@@ -80,16 +104,66 @@ public:
     // Create the tables
     static void createTables(int dbVersion);
     static void migrateTables(int dbVersion);
+    static void createIndexes();
+    static void createUniqueBugIndexes();
+    static void convertTimestamps();
+    static void createTimestampIndexes();
+    static void createSearchIndex();
+    static void createAllBugsView();
+    static void createAllBugsIndexes();
+    static void createPendingChanges();
+    static void createCompressedComments();
+    static void createSearchRetention();
+    static void createTrackerStats();
+    static void createSyncSchedule();
+    static void createSyncCheckpoints();
+
+    // last_modified and comment timestamps are stored as UTC seconds since
+    // the epoch.  toEpoch() accepts the various date strings the trackers
+    // send back, and returns NULL if it can't parse one.  offset is the
+    // server's distance from UTC in seconds, for trackers that send their
+    // local time without a zone (timezone_offset_in_seconds).
+    static QVariant toEpoch(const QVariant &time, int offset = 0);
+    static QVariantList toEpoch(const QVariantList &times, int offset = 0);
+    // Formats a stored timestamp in local time for display
+    static QString formatEpoch(const QVariant &epoch,
+                               const QString &format = "yyyy-MM-dd hh:mm:ss");
+
+    // Comment bodies longer than the comment-compress-threshold setting are
+    // stored as qCompress()ed BLOBs.  expandText() takes either form.
+    static QVariant compressText(const QString &text, int threshold);
+    static QString expandText(const QVariant &value);
 
     // Return a list of the tracker details
     static QList< QMap<QString, QString> > loadTrackers();
 
+    // Counts kept up to date by triggers, so reading them is a single row
+    // lookup: "total", "open", "recent" (changed in the last sync),
+    // "assigned" and "pending" (unsent changes)
+    static QMap<QString, int> trackerStats(const QString &trackerId);
+
+    // Per-tracker sync schedule kept by SyncScheduler: "sync_interval" (in
+    // seconds), "next_sync" (seconds since the epoch), "sync_failures" and
+    // "tab_views"
+    static QVariantMap syncSchedule(const QString &trackerId);
+    static void saveSyncSchedule(const QString &trackerId,
+                                 const QVariantMap &schedule);
+
+    // What an interrupted sync from since got through, by phase: a list of
+    // the chunks each phase saved, in order.  started is set to when that
+    // sync first started.
+    static QVariantMap syncCheckpoints(const QString &trackerId,
+                                       const QString &since,
+                                       QString &started);
+
     // Get all comments for a particular bugs
     static QList< QMap<QString, QString> > loadComments(const QString &trackerId,
                                                         const QString &bugId,
-                                                        bool shadow);
+                                                        bool shadow,
+                                                        QSqlDatabase db = QSqlDatabase::database());
     static QList< QMap<QString, QString> > loadAttachments(const QString &trackerId,
-                                                           const QString &bugId);
+                                                           const QString &bugId,
+                                                           QSqlDatabase db = QSqlDatabase::database());
     static QMap<QString, QString> attachmentDetails(int rowId);
 
     // A generic insertion function that converts the QMap keys into the column names
@@ -102,11 +176,13 @@ public:
                              const QString &tableName);
 
     static QString getBugDescription(const QString &table,
-                                     const QString &bugId);
+                                     const QString &bugId,
+                                     QSqlDatabase db = QSqlDatabase::database());
     static void directExec(QSqlDatabase db,
                            const QString &sql);
     static QStringList fieldValues(const QString &tracker_id,
-                                   const QString &fieldName);
+                                   const QString &fieldName,
+                                   QSqlDatabase db = QSqlDatabase::database());
     static void removeFieldValues(const QString &trackerId,
                                   const QString &fieldName);
     static QList< QMap<QString, QString> > getCommentsChangelog();
@@ -118,14 +194,15 @@ public:
 
     // Deletes all entries in the search table
     static void clearSearch();
+    // Searches the cached bugs and comments into the search table
+    static int localSearch(const QString &search,
+                           const QString &trackerName = QString());
     static void renameSearchTracker(const QString &oldName, const QString &newName);
     static bool renameTracker(const QString &id,
                               const QString &name,
                               const QString &username,
                               const QString &password);
 
-    // Clears the highlight_type when highlight_type is HIGHLIGHT_RECENT
-    static void clearRecentBugs(const QString &tableName);
     static void clearAttachments(int trackerId, int bugId);
     static void removeTracker(const QString &trackerId,
                               const QString &trackerName);
@@ -144,7 +221,8 @@ public:
     static QMap<QString, QString> bugzillaBugDetail(const QString &rowId);
 
     static QStringList assignedToValues(const QString &table,
-                                        const QString &trackerId);
+                                        const QString &trackerId,
+                                        QSqlDatabase db = QSqlDatabase::database());
 signals:
     void success(int operation);
     void failure(QString message);
@@ -153,18 +231,39 @@ signals:
 
 public slots:
     void deleteBugs(const QString &trackerId);
-    void insertBugs(const QString &tableName, QList< QMap<QString, QString> > list, const QString &trackerId, int operation);
-    void multiInsert(const QString &tableName, QList< QMap<QString, QString> > list, int operation);
+    void insertBugs(const QString &tableName, SqlRecordBatch batch, const QString &trackerId, int operation,
+                    const SqlRecordBatch &removeBatch = SqlRecordBatch());
+    void multiInsert(const QString &tableName, SqlRecordBatch batch, int operation);
 
     // insertComments inserts comments for a number of different bugs.
     // insertBugComments inserts comments for just one bug
-    void insertComments(QList<QMap<QString, QString> > commentList);
-    void insertBugComments(QList<QMap<QString, QString> > commentList);
+    void insertComments(SqlRecordBatch commentBatch);
+    void insertBugComments(SqlRecordBatch commentBatch);
 
     void syncDB(int id, const QString &timestamp);
     void saveCredentials(int id, const QString &username, const QString &password);
+    // Clears the tracker's highlight_type where it's HIGHLIGHT_RECENT
+    void clearRecentBugs(const QString &tableName, const QString &trackerId);
+    void saveSyncCheckpoint(const QString &trackerId, const QString &phase, int chunk,
+                            const QString &since, const QString &started, const QVariant &data);
+    void maintainDatabase(int slicePages, int tasks);
 
 private:
+    static QMap<QString, QStringList> changelogFields();
+    static QVariantList pendingChangelog(const QString &shadowTable);
+    int pragmaValue(const QString &pragma);
+    int pruneSearches(int days, int maxRows);
+    bool pruneSearchBatch(const QString &table, const QString &condition, int &removed);
+    bool removeBugs(const QString &tableName, const SqlRecordBatch &removeBatch, QStringList &idList);
+
+    void beginWrite();
+    void endWrite(bool commit);
+    bool execCommentBatch(const SqlRecordBatch &commentBatch);
+    void mergeBugs(const QString &tableName,
+                   const SqlRecordBatch &batch,
+                   const QString &trackerId,
+                   int operation);
+
     static QVariantMap newChangelogEntry(const QString &trackerTable,
                                                     const QString &id,
                                                     const QString &trackerName,
@@ -173,6 +272,7 @@ private:
                                                     const QString &oldValue,
                                                     const QString &newValue);
     QSqlDatabase mDatabase;
+    bool mBatchActive;
 };
 
 #endif // SQLUTILITIES_H
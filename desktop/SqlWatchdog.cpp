@@ -0,0 +1,56 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#include <QCoreApplication>
+#include <QSettings>
+#include <QThread>
+#include <QDebug>
+#include "SqlWatchdog.h"
+
+SqlWatchdog::SqlWatchdog(const QString &name)
+{
+    QCoreApplication *app = QCoreApplication::instance();
+    mActive = (app != NULL) && (QThread::currentThread() == app->thread());
+    if (!mActive)
+        return;
+
+    mName = name.simplified();
+    mTimer.start();
+}
+
+SqlWatchdog::~SqlWatchdog()
+{
+    if (!mActive)
+        return;
+
+    static int threshold = -1;
+    if (threshold < 0)
+    {
+        QSettings settings("Entomologist");
+        threshold = settings.value("sql-watchdog-threshold", 50).toInt();
+    }
+
+    int elapsed = mTimer.elapsed();
+    if (elapsed > threshold)
+        qDebug() << "SqlWatchdog: " << mName << " blocked the GUI thread for " << elapsed << "ms";
+}
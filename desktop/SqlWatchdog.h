@@ -0,0 +1,54 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#ifndef SQLWATCHDOG_H
+#define SQLWATCHDOG_H
+
+#include <QString>
+#include <QTime>
+
+// Debug builds log any SQL that keeps the GUI thread busy for longer than
+// the sql-watchdog-threshold setting (in ms, default 50).  Every statement
+// that goes through SqlProfiler or a SqlBugModel is timed under its SQL;
+// the SqlUtilities helpers are tagged by name as well, so a helper that
+// runs several short statements still shows up.  Anything it flags is a
+// candidate for SqlReader.
+class SqlWatchdog
+{
+public:
+    SqlWatchdog(const QString &name);
+    ~SqlWatchdog();
+
+private:
+    QString mName;
+    bool mActive;
+    QTime mTimer;
+};
+
+#ifdef QT_NO_DEBUG
+#define SQL_WATCHDOG(name)
+#else
+#define SQL_WATCHDOG(name) SqlWatchdog sqlWatchdog(name)
+#endif
+
+#endif // SQLWATCHDOG_H
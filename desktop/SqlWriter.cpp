@@ -0,0 +1,195 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDebug>
+#include "SqlWriter.h"
+
+SqlWriter::SqlWriter(QObject *parent) :
+    QObject(parent)
+{
+    SqlWriterThread *writer = SqlWriterThread::instance();
+    mClientId = writer->registerClient();
+    connect(writer, SIGNAL(requestFinished(quint64, SqlWriteResult)),
+            this, SLOT(requestFinished(quint64, SqlWriteResult)));
+}
+
+SqlWriter::~SqlWriter()
+{
+}
+
+void
+SqlWriter::enqueue(SqlWriteRequest &request)
+{
+    request.clientId = mClientId;
+    SqlWriterThread::instance()->enqueue(request);
+}
+
+void
+SqlWriter::multiInsert(const QString &table, SqlRecordBatch batch, int operation)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::MULTI_INSERT;
+    request.table = table;
+    request.batch = batch;
+    request.operation = operation;
+    enqueue(request);
+}
+
+void
+SqlWriter::insertBugs(const QString &table, SqlRecordBatch batch, const QString &trackerId, int operation,
+                      SqlRecordBatch removeBatch)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::INSERT_BUGS;
+    request.table = table;
+    request.batch = batch;
+    request.removeBatch = removeBatch;
+    request.trackerId = trackerId;
+    request.operation = operation;
+    enqueue(request);
+}
+
+void
+SqlWriter::insertComments(SqlRecordBatch commentBatch)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::INSERT_COMMENTS;
+    request.batch = commentBatch;
+    enqueue(request);
+}
+
+void
+SqlWriter::insertBugComments(SqlRecordBatch commentBatch,
+                             int priority)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::INSERT_BUG_COMMENTS;
+    request.priority = priority;
+    request.batch = commentBatch;
+    enqueue(request);
+}
+
+void
+SqlWriter::multiInsert(const QString &table, QList<QMap<QString, QString> > list, int operation)
+{
+    multiInsert(table, SqlRecordBatch::fromMaps(list), operation);
+}
+
+void
+SqlWriter::insertBugs(const QString &table, QList<QMap<QString, QString> > list, const QString &trackerId, int operation)
+{
+    insertBugs(table, SqlRecordBatch::fromMaps(list), trackerId, operation);
+}
+
+void
+SqlWriter::insertComments(QList<QMap<QString, QString> > commentList)
+{
+    insertComments(SqlRecordBatch::fromMaps(commentList));
+}
+
+void
+SqlWriter::insertBugComments(QList<QMap<QString, QString> > commentList,
+                             int priority)
+{
+    insertBugComments(SqlRecordBatch::fromMaps(commentList), priority);
+}
+
+void
+SqlWriter::updateSync(int id, const QString &timestamp)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::SYNC_DB;
+    request.id = id;
+    request.timestamp = timestamp;
+    enqueue(request);
+}
+
+void
+SqlWriter::updateCredentials(int id, const QString &username, const QString &password)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::SAVE_CREDENTIALS;
+    request.priority = SqlWriterThread::PRIORITY_HIGH;
+    request.id = id;
+    request.username = username;
+    request.password = password;
+    enqueue(request);
+}
+
+void
+SqlWriter::saveCheckpoint(const QString &trackerId,
+                          const QString &phase,
+                          int chunk,
+                          const QString &since,
+                          const QString &started,
+                          const QVariant &data)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::SAVE_CHECKPOINT;
+    request.trackerId = trackerId;
+    request.phase = phase;
+    request.chunk = chunk;
+    request.timestamp = since;
+    request.started = started;
+    request.data = data;
+    enqueue(request);
+}
+
+void
+SqlWriter::clearBugs(const QString &trackerId)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::DELETE_BUGS;
+    request.trackerId = trackerId;
+    enqueue(request);
+}
+
+void
+SqlWriter::clearRecentBugs(const QString &table,
+                           const QString &trackerId)
+{
+    SqlWriteRequest request;
+    request.type = SqlWriteRequest::CLEAR_RECENT;
+    request.table = table;
+    request.trackerId = trackerId;
+    enqueue(request);
+}
+
+// requestFinished is broadcast to every SqlWriter, so ignore the ones
+// that were queued by somebody else
+void
+SqlWriter::requestFinished(quint64 clientId, SqlWriteResult result)
+{
+    if (clientId != mClientId)
+        return;
+
+    for (int i = 0; i < result.failures.size(); ++i)
+        emit failure(result.failures.at(i));
+
+    if (result.success)
+        emit success(result.operation);
+    if (result.commentFinished)
+        emit commentFinished();
+    if (result.bugsFinished)
+        emit bugsFinished(result.idList, result.operation);
+}
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SQLWRITER_H
+#define SQLWRITER_H
+
+#include <QObject>
+#include <QMap>
+#include <QStringList>
+
+#include "SqlWriterThread.h"
+
+// Each backend owns one of these.  It queues writes on the shared
+// SqlWriterThread and re-emits the results that belong to it.
+class SqlWriter : public QObject
+{
+Q_OBJECT
+public:
+    SqlWriter(QObject *parent = 0);
+    ~SqlWriter();
+
+    void clearBugs(const QString &trackerId);
+    // Queued ahead of a sync's bugs, so only the ones it brings in are recent
+    void clearRecentBugs(const QString &table, const QString &trackerId);
+    // For Mantis, we need to remove *all* bugs in the tables before inserting the new bugs,
+    // as there's no way to filter results based on the last modifed time values.  If trackerId
+    // is not -1, then the bugs will be removed before inserting the new list.
+    // The bugs in removeBatch (tracker_id and bug_id) are deleted in the same
+    // transaction, e.g. ones that were closed since the last sync.
+    void insertBugs(const QString &table, SqlRecordBatch batch, const QString &trackerId = "-1", int operation = 0,
+                    SqlRecordBatch removeBatch = SqlRecordBatch());
+    void insertComments(SqlRecordBatch commentBatch);
+    // Comments for a single bug are usually fetched because the user opened it,
+    // so they jump ahead of queued sync data
+    void insertBugComments(SqlRecordBatch commentBatch,
+                           int priority = SqlWriterThread::PRIORITY_HIGH);
+    void multiInsert(const QString &table, SqlRecordBatch batch, int operation = 0);
+
+    // The sync hot paths build SqlRecordBatches directly; everything else
+    // can keep passing a QMap per row
+    void insertBugs(const QString &table, QList<QMap<QString, QString> > list, const QString &trackerId = "-1", int operation = 0);
+    void insertComments(QList<QMap<QString, QString> > commentList);
+    void insertBugComments(QList<QMap<QString, QString> > commentList,
+                           int priority = SqlWriterThread::PRIORITY_HIGH);
+    void multiInsert(const QString &table, QList<QMap<QString, QString> > list, int operation = 0);
+
+    void updateSync(int id, const QString &timestamp);
+    void updateCredentials(int id, const QString &username, const QString &password);
+    // since is the last_sync the sync started from, started when it started
+    void saveCheckpoint(const QString &trackerId, const QString &phase, int chunk,
+                        const QString &since, const QString &started, const QVariant &data);
+
+signals:
+    void success(int operation);
+    void failure(QString message);
+    void commentFinished();
+    void bugsFinished(QStringList idList, int operation);
+
+private slots:
+    void requestFinished(quint64 clientId, SqlWriteResult result);
+
+private:
+    void enqueue(SqlWriteRequest &request);
+
+    quint64 mClientId;
+};
+
+#endif // SQLWRITER_H
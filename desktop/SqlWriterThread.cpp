@@ -22,96 +22,263 @@
  */
 
 #include <QMetaType>
+#include <QCoreApplication>
+#include <QSet>
 #include <QDebug>
 #include "SqlWriterThread.h"
 #include "SqlUtilities.h"
 
+// Upper bound on how many requests get folded into a single transaction,
+// so a flood of sync data can't starve the high priority queue for long.
+#define MAX_BATCH_SIZE 32
+
+SqlWriterThread *
+SqlWriterThread::instance()
+{
+    static SqlWriterThread *writer = NULL;
+    if (writer == NULL)
+    {
+        qRegisterMetaType<SqlWriteResult>("SqlWriteResult");
+        qRegisterMetaType<SqlRecordBatch>("SqlRecordBatch");
+        writer = new SqlWriterThread(QCoreApplication::instance());
+        writer->start();
+    }
+    return writer;
+}
+
 SqlWriterThread::SqlWriterThread(QObject *parent) :
     QThread(parent)
 {
+    pWriter = NULL;
+    mStopping = false;
+    mNextClientId = 1;
 }
 
+// Anything still queued is written out before the thread exits
 SqlWriterThread::~SqlWriterThread()
 {
-     QThread::quit();
-     QThread::wait();
+    mMutex.lock();
+    mStopping = true;
+    mCondition.wakeAll();
+    mMutex.unlock();
+    QThread::wait();
+}
+
+quint64
+SqlWriterThread::registerClient()
+{
+    QMutexLocker locker(&mMutex);
+    return mNextClientId++;
+}
+
+// A client's requests are written in the order it queued them, whatever
+// their priority.  So a high priority request takes the client's low
+// priority ones that are still waiting along with it, ahead of itself.
+void
+SqlWriterThread::enqueue(const SqlWriteRequest &request)
+{
+    QMutexLocker locker(&mMutex);
+    if (request.priority == PRIORITY_HIGH)
+    {
+        int i = 0;
+        while (i < mLowQueue.size())
+        {
+            if (mLowQueue.at(i).clientId == request.clientId)
+                mHighQueue.enqueue(mLowQueue.takeAt(i));
+            else
+                ++i;
+        }
+        mHighQueue.enqueue(request);
+    }
+    else
+    {
+        mLowQueue.enqueue(request);
+    }
+    mCondition.wakeOne();
 }
 
-// In order to have asynchronous writing to the DB (which is important,
-// otherwise the UI freezes when inserting new bugs) we have to redirect
-// the signals
 void
 SqlWriterThread::run()
 {
     pWriter = new SqlUtilities();
     qDebug() << "SqlWriterThread starting up...";
-    qRegisterMetaType< QMap<QString,QString> >("QMap<QString,QString>");
-    qRegisterMetaType< QList<QMap<QString,QString> > >("QList<QMap<QString,QString> >");
-    connect(this, SIGNAL(multiRowInsert(QString, QList<QMap<QString,QString> >, int)),
-            pWriter, SLOT(multiInsert(QString, QList<QMap<QString,QString> >, int)));
-    connect(this, SIGNAL(bugsInsert(QString,QList<QMap<QString,QString> >, QString, int)),
-            pWriter, SLOT(insertBugs(QString,QList<QMap<QString,QString> >, QString, int)));
-    connect(this, SIGNAL(newComments(QList<QMap<QString,QString> >)),
-            pWriter, SLOT(insertComments(QList<QMap<QString,QString> >)));
-    connect(this, SIGNAL(newBugComments(QList<QMap<QString,QString> >)),
-            pWriter, SLOT(insertBugComments(QList<QMap<QString,QString> >)));
-    connect(this, SIGNAL(syncDB(int, QString)),
-            pWriter, SLOT(syncDB(int, QString)));
-    connect(this, SIGNAL(deleteBugs(QString)),
-            pWriter, SLOT(deleteBugs(QString)));
-    connect(this, SIGNAL(saveCredentials(int,QString,QString)),
-            pWriter, SLOT(saveCredentials(int,QString,QString)));
-    connect(pWriter, SIGNAL(failure(QString)),
-            this, SIGNAL(failure(QString)));
+
+    // The SqlUtilities slots report through signals; catch them here so they
+    // can be attributed to the request that's currently executing
     connect(pWriter, SIGNAL(success(int)),
-            this, SIGNAL(success(int)));
+            this, SLOT(writerSuccess(int)), Qt::DirectConnection);
+    connect(pWriter, SIGNAL(failure(QString)),
+            this, SLOT(writerFailure(QString)), Qt::DirectConnection);
     connect(pWriter, SIGNAL(commentFinished()),
-            this, SIGNAL(commentFinished()));
+            this, SLOT(writerCommentFinished()), Qt::DirectConnection);
     connect(pWriter, SIGNAL(bugsFinished(QStringList, int)),
-            this, SIGNAL(bugsFinished(QStringList, int)));
-    exec();
+            this, SLOT(writerBugsFinished(QStringList, int)), Qt::DirectConnection);
+
+    forever
+    {
+        mMutex.lock();
+        while (mHighQueue.isEmpty() && mLowQueue.isEmpty() && !mStopping)
+            mCondition.wait(&mMutex);
+
+        if (mHighQueue.isEmpty() && mLowQueue.isEmpty())
+        {
+            mMutex.unlock();
+            break;
+        }
+
+        QList<SqlWriteRequest> batch = takeBatch();
+        mMutex.unlock();
+
+        QList<SqlWriteResult> results;
+        bool grouped = batch.size() > 1;
+        if (grouped)
+            pWriter->beginBatch();
+
+        for (int i = 0; i < batch.size(); ++i)
+        {
+            mCurrentResult = SqlWriteResult();
+            mCurrentResult.type = batch.at(i).type;
+            execute(batch.at(i));
+            results << mCurrentResult;
+        }
+
+        if (grouped && !pWriter->commitBatch())
+        {
+            for (int i = 0; i < results.size(); ++i)
+            {
+                results[i].failures << "Could not commit the database transaction";
+                results[i].success = false;
+                results[i].bugsFinished = false;
+            }
+        }
+
+        for (int i = 0; i < batch.size(); ++i)
+            emit requestFinished(batch.at(i).clientId, results.at(i));
+    }
+
+    delete pWriter;
+    pWriter = NULL;
 }
 
-// Utility functions to keep the backends from caring about the
-// signal/slot implementation
-void
-SqlWriterThread::multiInsert(const QString &table, QList<QMap<QString, QString> > list, int operation)
+// Takes the next request off the highest priority queue that has anything,
+// plus any requests queued behind it for the same table.  A client's requests
+// are never reordered: once one of its requests is skipped, the rest of its
+// requests stay queued too.
+// Must be called with mMutex held.
+QList<SqlWriteRequest>
+SqlWriterThread::takeBatch()
 {
-    emit multiRowInsert(table, list, operation);
+    QQueue<SqlWriteRequest> &queue = mHighQueue.isEmpty() ? mLowQueue : mHighQueue;
+    QList<SqlWriteRequest> batch;
+    batch << queue.dequeue();
+    if (batch.first().type == SqlWriteRequest::MAINTENANCE)
+        return batch;
+    QString table = requestTable(batch.first());
+
+    QSet<quint64> skippedClients;
+    int i = 0;
+    while ((i < queue.size()) && (batch.size() < MAX_BATCH_SIZE))
+    {
+        const SqlWriteRequest &request = queue.at(i);
+        if (!skippedClients.contains(request.clientId)
+            && (request.type != SqlWriteRequest::MAINTENANCE)
+            && (requestTable(request) == table))
+        {
+            batch << queue.takeAt(i);
+            continue;
+        }
+
+        skippedClients.insert(request.clientId);
+        ++i;
+    }
+
+    return batch;
 }
-void
-SqlWriterThread::insertBugs(const QString &table, QList<QMap<QString, QString> > list, const QString &trackerId, int operation)
+
+QString
+SqlWriterThread::requestTable(const SqlWriteRequest &request)
 {
-    emit bugsInsert(table, list, trackerId, operation);
+    switch (request.type)
+    {
+        case SqlWriteRequest::INSERT_COMMENTS:
+        case SqlWriteRequest::INSERT_BUG_COMMENTS:
+            return "comments";
+        case SqlWriteRequest::SYNC_DB:
+        case SqlWriteRequest::SAVE_CREDENTIALS:
+            return "trackers";
+        case SqlWriteRequest::SAVE_CHECKPOINT:
+            return "sync_checkpoints";
+        default:
+            return request.table;
+    }
 }
 
 void
-SqlWriterThread::insertComments(QList<QMap<QString, QString> > commentList)
+SqlWriterThread::execute(const SqlWriteRequest &request)
 {
-    emit newComments(commentList);
+    switch (request.type)
+    {
+        case SqlWriteRequest::INSERT_BUGS:
+            pWriter->insertBugs(request.table, request.batch, request.trackerId, request.operation,
+                               request.removeBatch);
+            break;
+        case SqlWriteRequest::MULTI_INSERT:
+            pWriter->multiInsert(request.table, request.batch, request.operation);
+            break;
+        case SqlWriteRequest::INSERT_COMMENTS:
+            pWriter->insertComments(request.batch);
+            break;
+        case SqlWriteRequest::INSERT_BUG_COMMENTS:
+            pWriter->insertBugComments(request.batch);
+            break;
+        case SqlWriteRequest::SYNC_DB:
+            pWriter->syncDB(request.id, request.timestamp);
+            break;
+        case SqlWriteRequest::SAVE_CREDENTIALS:
+            pWriter->saveCredentials(request.id, request.username, request.password);
+            break;
+        case SqlWriteRequest::DELETE_BUGS:
+            pWriter->deleteBugs(request.trackerId);
+            break;
+        case SqlWriteRequest::SAVE_CHECKPOINT:
+            pWriter->saveSyncCheckpoint(request.trackerId, request.phase, request.chunk,
+                                        request.timestamp, request.started, request.data);
+            break;
+        case SqlWriteRequest::MAINTENANCE:
+            pWriter->maintainDatabase(request.id, request.operation);
+            break;
+        case SqlWriteRequest::CLEAR_RECENT:
+            pWriter->clearRecentBugs(request.table, request.trackerId);
+            break;
+        default:
+            qDebug() << "SqlWriterThread: Unknown request type " << request.type;
+            break;
+    }
 }
 
 void
-SqlWriterThread::insertBugComments(QList<QMap<QString, QString> > commentList)
+SqlWriterThread::writerSuccess(int operation)
 {
-    emit newBugComments(commentList);
+    mCurrentResult.success = true;
+    mCurrentResult.operation = operation;
 }
 
 void
-SqlWriterThread::updateSync(int id, const QString &timestamp)
+SqlWriterThread::writerFailure(QString message)
 {
-    emit syncDB(id, timestamp);
+    mCurrentResult.failures << message;
 }
 
 void
-SqlWriterThread::updateCredentials(int id, const QString &username, const QString &password)
+SqlWriterThread::writerCommentFinished()
 {
-    emit saveCredentials(id, username, password);
+    mCurrentResult.commentFinished = true;
 }
 
 void
-SqlWriterThread::clearBugs(const QString &trackerId)
+SqlWriterThread::writerBugsFinished(QStringList idList, int operation)
 {
-    emit deleteBugs(trackerId);
+    mCurrentResult.bugsFinished = true;
+    mCurrentResult.idList = idList;
+    mCurrentResult.operation = operation;
 }
-
@@ -27,42 +27,114 @@
 #include <QThread>
 #include <QMap>
 #include <QStringList>
+#include <QQueue>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QMetaType>
+#include <QVariant>
+
+#include "SqlRecordBatch.h"
 
 class SqlUtilities;
 
+// A single write queued by one of the SqlWriter handles
+struct SqlWriteRequest
+{
+    enum {
+        INSERT_BUGS = 1,
+        MULTI_INSERT,
+        INSERT_COMMENTS,
+        INSERT_BUG_COMMENTS,
+        SYNC_DB,
+        SAVE_CREDENTIALS,
+        DELETE_BUGS,
+        MAINTENANCE,
+        SAVE_CHECKPOINT,
+        CLEAR_RECENT
+    };
+
+    SqlWriteRequest() : type(0), priority(0), clientId(0), operation(0), id(0), chunk(0) {}
+
+    int type;
+    int priority;
+    quint64 clientId;
+    QString table;
+    QString trackerId;
+    int operation;
+    SqlRecordBatch batch;
+    SqlRecordBatch removeBatch;
+    int id;
+    QString timestamp;
+    QString username;
+    QString password;
+    QString phase;
+    int chunk;
+    QString started;
+    QVariant data;
+};
+
+// What the SqlUtilities slots reported while a request ran.  It's only
+// handed back to the client once the transaction it ran in has committed.
+struct SqlWriteResult
+{
+    SqlWriteResult() : type(0), success(false), commentFinished(false),
+                       bugsFinished(false), operation(0) {}
+
+    int type;
+    QStringList failures;
+    bool success;
+    bool commentFinished;
+    bool bugsFinished;
+    QStringList idList;
+    int operation;
+};
+
+Q_DECLARE_METATYPE(SqlWriteResult)
+
+// The process-wide database writer.  Every backend queues its writes here
+// through a SqlWriter handle, so there's only one thread holding the SQLite
+// write lock no matter how many trackers there are.  Queued requests that
+// touch the same table are committed together in one transaction.
 class SqlWriterThread : public QThread
 {
 Q_OBJECT
 public:
-    SqlWriterThread(QObject *parent = 0);
+    enum {
+        PRIORITY_LOW = 0,   // Sync data
+        PRIORITY_HIGH       // Anything the user is waiting on
+    };
+
+    static SqlWriterThread *instance();
+
     ~SqlWriterThread();
     void run();
-    void clearBugs(const QString &trackerId);
-    // For Mantis, we need to remove *all* bugs in the tables before inserting the new bugs,
-    // as there's no way to filter results based on the last modifed time values.  If trackerId
-    // is not -1, then the bugs will be removed before inserting the new list.
-    void insertBugs(const QString &table, QList<QMap<QString, QString> > list, const QString &trackerId = "-1", int operation = 0);
-    void insertComments(QList<QMap<QString, QString> > commentList);
-    void insertBugComments(QList<QMap<QString, QString> > commentList);
-    void multiInsert(const QString &table, QList<QMap<QString, QString> > bugList, int operation = 0);
-    void updateSync(int id, const QString &timestamp);
-    void updateCredentials(int id, const QString &username, const QString &password);
+
+    quint64 registerClient();
+    void enqueue(const SqlWriteRequest &request);
 
 signals:
-    void success(int operation);
-    void failure(QString message);
-    void commentFinished();
-    void bugsFinished(QStringList idList, int operation);
-    void deleteBugs(const QString &trackerId);
-    void bugsInsert(const QString &table, QList<QMap<QString, QString> > bugList, const QString &trackerId, int operation);
-    void multiRowInsert(const QString &table, QList<QMap<QString, QString> > bugList, int operation);
-    void newComments(QList<QMap<QString, QString> > commentList);
-    void newBugComments(QList<QMap<QString, QString> > commentList);
-    void syncDB(int id, const QString &timestamp);
-    void saveCredentials(int id, const QString &username, const QString &password);
+    void requestFinished(quint64 clientId, SqlWriteResult result);
+
+private slots:
+    void writerSuccess(int operation);
+    void writerFailure(QString message);
+    void writerCommentFinished();
+    void writerBugsFinished(QStringList idList, int operation);
 
 private:
+    SqlWriterThread(QObject *parent = 0);
+    QList<SqlWriteRequest> takeBatch();
+    void execute(const SqlWriteRequest &request);
+    static QString requestTable(const SqlWriteRequest &request);
+
     SqlUtilities *pWriter;
+    QMutex mMutex;
+    QWaitCondition mCondition;
+    QQueue<SqlWriteRequest> mHighQueue;
+    QQueue<SqlWriteRequest> mLowQueue;
+    bool mStopping;
+    quint64 mNextClientId;
+    SqlWriteResult mCurrentResult;
 };
 
 #endif // SQLWRITERTHREAD_H
@@ -0,0 +1,247 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QSettings>
+#include <QUrl>
+#include <QDebug>
+
+#include "SyncCoordinator.h"
+#include "trackers/Backend.h"
+
+SyncCoordinator::SyncCoordinator(QObject *parent) :
+    QObject(parent)
+{
+    mLimit = 1;
+    mPerHost = 1;
+    mDone = 0;
+    mTotal = 0;
+}
+
+SyncCoordinator::~SyncCoordinator()
+{
+}
+
+void
+SyncCoordinator::start(const QList<Backend *> &backends,
+                       Operation operation)
+{
+    for (int i = 0; i < backends.size(); ++i)
+        start(backends.at(i), operation);
+}
+
+void
+SyncCoordinator::start(Backend *backend,
+                       Operation operation)
+{
+    // A job that's still queued will do what this one would, and so will a
+    // sync that's running.  An upload is queued even behind a running one:
+    // the changes it has to send may have been made after that one started.
+    if (isQueued(backend, operation)
+        || ((operation == SYNC) && mRunning.contains(backend) && (mRunning.value(backend) == SYNC)))
+        return;
+
+    if (!isActive())
+    {
+        // The limits are read once per round, so a change in the
+        // preferences applies to the next sync
+        QSettings settings("Entomologist");
+        mLimit = qMax(1, settings.value("sync-parallelism", 4).toInt());
+        mPerHost = qMax(1, settings.value("sync-per-host", 2).toInt());
+        mDone = 0;
+        mTotal = 0;
+        mTimer.start();
+        emit started();
+    }
+
+    Job job;
+    job.backend = backend;
+    job.operation = operation;
+    mQueue.append(job);
+    mTotal++;
+    startJobs();
+}
+
+void
+SyncCoordinator::remove(Backend *backend)
+{
+    for (int i = mQueue.size() - 1; i >= 0; --i)
+    {
+        if (mQueue.at(i).backend == backend)
+        {
+            mQueue.removeAt(i);
+            mTotal--;
+        }
+    }
+
+    if (mRunning.contains(backend))
+        finishJob(backend, false, true);
+}
+
+bool
+SyncCoordinator::isActive() const
+{
+    return !mQueue.isEmpty() || !mRunning.isEmpty();
+}
+
+QStringList
+SyncCoordinator::activeNames() const
+{
+    QStringList names;
+    QMapIterator<Backend *, Operation> i(mRunning);
+    while (i.hasNext())
+    {
+        i.next();
+        names << i.key()->name();
+    }
+    return names;
+}
+
+bool
+SyncCoordinator::isUploading() const
+{
+    QMapIterator<Backend *, Operation> i(mRunning);
+    while (i.hasNext())
+    {
+        i.next();
+        if (i.value() == UPLOAD)
+            return true;
+    }
+    return false;
+}
+
+bool
+SyncCoordinator::isQueued(Backend *backend,
+                          Operation operation) const
+{
+    for (int i = 0; i < mQueue.size(); ++i)
+    {
+        if ((mQueue.at(i).backend == backend) && (mQueue.at(i).operation == operation))
+            return true;
+    }
+    return false;
+}
+
+// Starts queued jobs, in order, until the limit is reached.  A job whose
+// server is already at its cap is skipped, not waited on, so one slow host
+// doesn't hold up trackers elsewhere.  A tracker runs one job at a time, so
+// a job queued behind another for the same tracker waits for it.
+void
+SyncCoordinator::startJobs()
+{
+    QList<Job> starting;
+    int i = 0;
+    while ((i < mQueue.size()) && (mRunning.size() < mLimit))
+    {
+        Job job = mQueue.at(i);
+        QString host = hostFor(job.backend);
+        if (mRunning.contains(job.backend)
+            || (mHostCount.value(host, 0) >= mPerHost))
+        {
+            ++i;
+            continue;
+        }
+
+        mQueue.removeAt(i);
+        mHostCount[host]++;
+        mRunning.insert(job.backend, job.operation);
+        starting.append(job);
+    }
+
+    // The bookkeeping is done before any backend starts, because a backend
+    // that fails straight away reports back from inside sync()
+    for (int j = 0; j < starting.size(); ++j)
+    {
+        Backend *b = starting.at(j).backend;
+        connect(b, SIGNAL(syncFinished()),
+                this, SLOT(backendFinished()));
+        connect(b, SIGNAL(backendError(QString)),
+                this, SLOT(backendFailed(QString)));
+        emit progress(mDone, mTotal);
+        if (starting.at(j).operation == UPLOAD)
+        {
+            qDebug() << "SyncCoordinator: uploading " << b->name();
+            b->uploadAll();
+        }
+        else
+        {
+            qDebug() << "SyncCoordinator: syncing " << b->name();
+            b->sync();
+        }
+    }
+}
+
+void
+SyncCoordinator::backendFinished()
+{
+    Backend *b = qobject_cast<Backend *>(sender());
+    if (b != NULL)
+        finishJob(b, true);
+}
+
+void
+SyncCoordinator::backendFailed(const QString &message)
+{
+    Q_UNUSED(message);
+    Backend *b = qobject_cast<Backend *>(sender());
+    if (b != NULL)
+        finishJob(b, false);
+}
+
+void
+SyncCoordinator::finishJob(Backend *backend,
+                           bool succeeded,
+                           bool removed)
+{
+    if (!mRunning.contains(backend))
+        return;
+
+    disconnect(backend, SIGNAL(syncFinished()),
+               this, SLOT(backendFinished()));
+    disconnect(backend, SIGNAL(backendError(QString)),
+               this, SLOT(backendFailed(QString)));
+    Operation operation = mRunning.take(backend);
+    QString host = hostFor(backend);
+    if (--mHostCount[host] <= 0)
+        mHostCount.remove(host);
+    mDone++;
+    qDebug() << "SyncCoordinator: " << backend->name() << " finished, "
+             << mDone << " of " << mTotal << " done after " << mTimer.elapsed() << "ms";
+    if ((operation == SYNC) && !removed)
+        emit synced(backend, succeeded);
+
+    if (isActive())
+    {
+        emit progress(mDone, mTotal);
+        startJobs();
+    }
+    else
+    {
+        emit finished();
+    }
+}
+
+QString
+SyncCoordinator::hostFor(Backend *backend) const
+{
+    return QUrl(backend->url()).host().toLower();
+}
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SYNCCOORDINATOR_H
+#define SYNCCOORDINATOR_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QTime>
+
+class Backend;
+
+// Runs tracker syncs and uploads side by side instead of one after the
+// other.  At most sync-parallelism trackers (default 4) are busy at once,
+// and no more than sync-per-host (default 2) of them on the same server.
+// A tracker is done when it emits syncFinished() or backendError().
+class SyncCoordinator : public QObject
+{
+Q_OBJECT
+public:
+    enum Operation
+    {
+        SYNC,
+        UPLOAD
+    };
+
+    explicit SyncCoordinator(QObject *parent = 0);
+    ~SyncCoordinator();
+
+    // Queues the backends.  A job that's already queued for the backend,
+    // or a sync while one is running, is left alone; an upload asked for
+    // while the backend syncs runs once the sync is done.
+    void start(const QList<Backend *> &backends, Operation operation);
+    void start(Backend *backend, Operation operation);
+
+    // Drops a backend that's about to be deleted
+    void remove(Backend *backend);
+
+    bool isActive() const;
+    // Names of the trackers currently syncing or uploading
+    QStringList activeNames() const;
+    bool isUploading() const;
+
+signals:
+    void started();
+    // done out of total since the coordinator was last idle
+    void progress(int done, int total);
+    // A single tracker's sync is over, one way or the other
+    void synced(Backend *backend, bool succeeded);
+    void finished();
+
+private slots:
+    void backendFinished();
+    void backendFailed(const QString &message);
+
+private:
+    struct Job
+    {
+        Backend *backend;
+        Operation operation;
+    };
+
+    bool isQueued(Backend *backend, Operation operation) const;
+    void startJobs();
+    void finishJob(Backend *backend, bool succeeded, bool removed = false);
+    QString hostFor(Backend *backend) const;
+
+    QList<Job> mQueue;
+    QMap<Backend *, Operation> mRunning;
+    QMap<QString, int> mHostCount;
+    int mLimit;
+    int mPerHost;
+    int mDone;
+    int mTotal;
+    QTime mTimer;
+};
+
+#endif // SYNCCOORDINATOR_H
@@ -0,0 +1,226 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QDateTime>
+#include <QSettings>
+#include <QTimer>
+#include <QVariantMap>
+#include <QDebug>
+
+#include "SyncScheduler.h"
+#include "SqlUtilities.h"
+#include "trackers/Backend.h"
+
+// A sync that brings back at least this many bugs halves the interval
+#define BUSY_CHANGES 10
+
+SyncScheduler::SyncScheduler(QObject *parent) :
+    QObject(parent)
+{
+    qsrand(QDateTime::currentDateTime().toTime_t());
+    mEnabled = false;
+    mBaseInterval = 2 * 60 * 60;
+    mMinInterval = 15 * 60;
+    mMaxInterval = 24 * 60 * 60;
+    pTimer = new QTimer(this);
+    pTimer->setSingleShot(true);
+    connect(pTimer, SIGNAL(timeout()),
+            this, SLOT(timeout()));
+}
+
+SyncScheduler::~SyncScheduler()
+{
+}
+
+void
+SyncScheduler::addBackend(Backend *backend)
+{
+    QVariantMap saved = SqlUtilities::syncSchedule(backend->id());
+    Schedule schedule;
+    schedule.interval = saved.value("sync_interval", 0).toInt();
+    schedule.nextSync = saved.value("next_sync", 0).toLongLong();
+    schedule.failures = saved.value("sync_failures", 0).toInt();
+    schedule.views = saved.value("tab_views", 0).toDouble();
+
+    if (schedule.interval <= 0)
+        schedule.interval = mBaseInterval;
+    schedule.interval = qBound(mMinInterval, schedule.interval, mMaxInterval);
+    if (schedule.nextSync <= 0)
+        schedule.nextSync = QDateTime::currentDateTime().toTime_t() + jitter(schedule.interval);
+
+    mSchedules.insert(backend, schedule);
+    save(backend);
+    armTimer();
+}
+
+void
+SyncScheduler::removeBackend(Backend *backend)
+{
+    mSchedules.remove(backend);
+    armTimer();
+}
+
+void
+SyncScheduler::reloadSettings()
+{
+    QSettings settings("Entomologist");
+    mEnabled = settings.value("update-automatically", false).toBool();
+    // update-interval is in hours, the bounds in minutes
+    mBaseInterval = qMax(2, settings.value("update-interval", 2).toInt()) * 60 * 60;
+    mMinInterval = qMax(5, settings.value("sync-interval-min", 15).toInt()) * 60;
+    mMaxInterval = qMax(mMinInterval, settings.value("sync-interval-max", 24 * 60).toInt() * 60);
+
+    QMutableMapIterator<Backend *, Schedule> i(mSchedules);
+    while (i.hasNext())
+    {
+        i.next();
+        i.value().interval = qBound(mMinInterval, i.value().interval, mMaxInterval);
+    }
+    armTimer();
+}
+
+void
+SyncScheduler::tabViewed(Backend *backend)
+{
+    if (!mSchedules.contains(backend))
+        return;
+
+    mSchedules[backend].views += 1;
+    save(backend);
+}
+
+void
+SyncScheduler::synced(Backend *backend,
+                      bool succeeded)
+{
+    if (!mSchedules.contains(backend))
+        return;
+
+    Schedule &schedule = mSchedules[backend];
+    int changes = backend->takeChangeCount();
+    int delay;
+    if (succeeded)
+    {
+        schedule.failures = 0;
+        if (changes == 0)
+            schedule.interval = schedule.interval * 3 / 2;
+        else if (changes >= BUSY_CHANGES)
+            schedule.interval = schedule.interval / 2;
+        else if (changes > 2)
+            schedule.interval = schedule.interval * 3 / 4;
+        schedule.interval = qBound(mMinInterval, schedule.interval, mMaxInterval);
+
+        // A tab the user keeps going back to is synced up to three times
+        // as often.  The views fade by half every sync so that it follows
+        // what the user is doing now.
+        delay = int(schedule.interval / (1 + qMin(schedule.views, 8.0) / 4));
+        delay = qMax(mMinInterval, delay);
+        schedule.views /= 2;
+    }
+    else
+    {
+        schedule.failures++;
+        delay = mMinInterval;
+        for (int i = 0; (i < schedule.failures) && (delay < mMaxInterval); ++i)
+            delay *= 2;
+        delay = qMin(mMaxInterval, delay);
+    }
+
+    schedule.nextSync = QDateTime::currentDateTime().toTime_t() + jitter(delay);
+    qDebug() << "SyncScheduler: " << backend->name() << (succeeded ? " synced, " : " failed, ")
+             << changes << " changes, interval " << schedule.interval << "s, next in " << delay << "s";
+    save(backend);
+    armTimer();
+}
+
+void
+SyncScheduler::timeout()
+{
+    if (!mEnabled)
+        return;
+
+    qint64 now = QDateTime::currentDateTime().toTime_t();
+    QList<Backend *> due;
+    QMutableMapIterator<Backend *, Schedule> i(mSchedules);
+    while (i.hasNext())
+    {
+        i.next();
+        if (i.value().nextSync > now)
+            continue;
+
+        i.value().nextSync = now + jitter(mMinInterval);
+        due << i.key();
+        save(i.key());
+    }
+
+    if (!due.isEmpty())
+        emit syncDue(due);
+    armTimer();
+}
+
+void
+SyncScheduler::save(Backend *backend)
+{
+    const Schedule &schedule = mSchedules[backend];
+    QVariantMap saved;
+    saved["sync_interval"] = schedule.interval;
+    saved["next_sync"] = schedule.nextSync;
+    saved["sync_failures"] = schedule.failures;
+    saved["tab_views"] = schedule.views;
+    SqlUtilities::saveSyncSchedule(backend->id(), saved);
+}
+
+// +/- 10%
+int
+SyncScheduler::jitter(int seconds) const
+{
+    int spread = seconds / 5;
+    if (spread <= 0)
+        return seconds;
+    return seconds - (spread / 2) + (qrand() % (spread + 1));
+}
+
+// Wakes up at least once an hour, so that time spent suspended or a
+// change of the clock doesn't leave the timer far off
+void
+SyncScheduler::armTimer()
+{
+    if (!mEnabled || mSchedules.isEmpty())
+    {
+        pTimer->stop();
+        return;
+    }
+
+    qint64 earliest = -1;
+    QMapIterator<Backend *, Schedule> i(mSchedules);
+    while (i.hasNext())
+    {
+        i.next();
+        if ((earliest < 0) || (i.value().nextSync < earliest))
+            earliest = i.value().nextSync;
+    }
+
+    qint64 wait = earliest - QDateTime::currentDateTime().toTime_t();
+    wait = qBound(qint64(1), wait, qint64(60 * 60));
+    pTimer->start(int(wait) * 1000);
+}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SYNCSCHEDULER_H
+#define SYNCSCHEDULER_H
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+
+class Backend;
+class QTimer;
+
+// Decides when each tracker is due for an automatic sync.  Every tracker
+// has its own interval, which starts at update-interval and then follows
+// the tracker: it shrinks when a sync brings back a lot of changed bugs or
+// the user keeps opening the tracker's tab, and grows while nothing
+// happens, within sync-interval-min and sync-interval-max (minutes).
+// Failed syncs back off exponentially, and every delay is jittered so that
+// trackers added together don't keep syncing together.  The schedule is
+// stored in the trackers table.
+class SyncScheduler : public QObject
+{
+Q_OBJECT
+public:
+    explicit SyncScheduler(QObject *parent = 0);
+    ~SyncScheduler();
+
+    void addBackend(Backend *backend);
+    void removeBackend(Backend *backend);
+
+    // Rereads the bounds from the settings, and turns the automatic
+    // syncs on or off
+    void reloadSettings();
+
+    // The user looked at the tracker's tab
+    void tabViewed(Backend *backend);
+
+signals:
+    // These trackers are due.  The schedule moves them back by the
+    // minimum interval until synced() says how it went, so a sync that
+    // never happens (e.g. offline) is retried rather than lost.
+    void syncDue(QList<Backend *> backends);
+
+public slots:
+    void synced(Backend *backend, bool succeeded);
+
+private slots:
+    void timeout();
+
+private:
+    struct Schedule
+    {
+        int interval;
+        qint64 nextSync;
+        int failures;
+        double views;
+    };
+
+    void save(Backend *backend);
+    int jitter(int seconds) const;
+    void armTimer();
+
+    QTimer *pTimer;
+    QMap<Backend *, Schedule> mSchedules;
+    bool mEnabled;
+    int mBaseInterval;
+    int mMinInterval;
+    int mMaxInterval;
+};
+
+#endif // SYNCSCHEDULER_H
@@ -18,3 +18,37 @@ void TrackerTabWidget::contextMenuEvent(QContextMenuEvent *event)
 
     emit showMenu(index);
 }
+
+void
+TrackerTabWidget::setTrackerName(int index, const QString &name)
+{
+    tabBar()->setTabData(index, name);
+    updateCaption(index);
+}
+
+void
+TrackerTabWidget::setTrackerBadge(int index, int count, const QString &toolTip)
+{
+    mBadges[widget(index)] = count;
+    setTabToolTip(index, toolTip);
+    updateCaption(index);
+}
+
+QString
+TrackerTabWidget::trackerName(int index) const
+{
+    QVariant name = tabBar()->tabData(index);
+    if (name.isValid())
+        return name.toString();
+    return tabText(index);
+}
+
+void
+TrackerTabWidget::updateCaption(int index)
+{
+    int count = mBadges.value(widget(index), 0);
+    if (count > 0)
+        setTabText(index, QString("%1 (%2)").arg(trackerName(index)).arg(count));
+    else
+        setTabText(index, trackerName(index));
+}
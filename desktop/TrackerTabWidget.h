@@ -2,6 +2,7 @@
 #define TRACKERTABWIDGET_H
 
 #include <QTabWidget>
+#include <QMap>
 
 // Reimplement the tracker tab widget in order
 // to capture right-clicks on the tabs
@@ -11,11 +12,22 @@ class TrackerTabWidget : public QTabWidget
 public:
     explicit TrackerTabWidget(QWidget *parent = 0);
 
+    // Tracker tabs can show a count next to the name, so anything that
+    // looks a tracker up by its tab should use trackerName(), not tabText()
+    void setTrackerName(int index, const QString &name);
+    void setTrackerBadge(int index, int count, const QString &toolTip);
+    QString trackerName(int index) const;
+
 signals:
     void showMenu(int tabIndex);
 
 protected:
     void contextMenuEvent(QContextMenuEvent *event);
+
+private:
+    void updateCaption(int index);
+
+    QMap<QWidget *, int> mBadges;
 };
 
 #endif // TRACKERTABWIDGET_H
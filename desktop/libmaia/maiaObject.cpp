@@ -257,34 +257,47 @@ QString MaiaObject::prepareResponse(QVariant arg) {
 	return doc.toString();
 }
 
-void MaiaObject::parseResponse(QString response, QNetworkReply* reply) {
+MaiaObject::ParseResult MaiaObject::parse(const QString &response) {
+	ParseResult result;
+	result.isFault = true;
+	result.faultCode = 0;
+
 	QDomDocument doc;
-	QVariant arg;
 	QString errorMsg;
 	int errorLine;
 	int errorColumn;
 	if(!doc.setContent(response, &errorMsg, &errorLine, &errorColumn)) {
-		emit fault(-32700, QString("parse error: response not well formed at line %1: %2").arg(errorLine).arg(errorMsg), reply);
-        delete this;
-		return;
+		result.faultCode = -32700;
+		result.faultString = QString("parse error: response not well formed at line %1: %2").arg(errorLine).arg(errorMsg);
+		return result;
 	}
 	if(doc.documentElement().firstChild().toElement().tagName().toLower() == "params") {
 		QDomNode paramNode = doc.documentElement().firstChild().firstChild();
 		if(!paramNode.isNull()) {
-			arg = fromXml( paramNode.firstChild().toElement() );
+			result.arg = fromXml( paramNode.firstChild().toElement() );
 		}
-		emit aresponse(arg, reply);
+		result.isFault = false;
 	} else if(doc.documentElement().firstChild().toElement().tagName().toLower() == "fault") {
 		const QVariant errorVariant = fromXml(doc.documentElement().firstChild().firstChild().toElement());
-		emit fault(errorVariant.toMap() [ "faultCode" ].toInt(),
-		           errorVariant.toMap() [ "faultString" ].toString(),
-		           reply);
+		result.faultCode = errorVariant.toMap() [ "faultCode" ].toInt();
+		result.faultString = errorVariant.toMap() [ "faultString" ].toString();
+	} else {
+		result.faultCode = -32600;
+		result.faultString = tr("parse error: invalid xml-rpc. not conforming to spec.");
+	}
+	return result;
+}
+
+void MaiaObject::deliver(const ParseResult &result, QNetworkReply* reply) {
+	if(result.isFault) {
+		emit fault(result.faultCode, result.faultString, reply);
 	} else {
-		emit fault(-32600,
-		           tr("parse error: invalid xml-rpc. not conforming to spec."),
-		           reply);
+		QVariant arg = result.arg;
+		emit aresponse(arg, reply);
 	}
-    delete this;
-	return;
+	delete this;
 }
 
+void MaiaObject::parseResponse(QString response, QNetworkReply* reply) {
+	deliver(parse(response), reply);
+}
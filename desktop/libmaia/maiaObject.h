@@ -37,11 +37,22 @@ class MaiaObject : public QObject {
 	Q_OBJECT
 	
 	public:
+		struct ParseResult {
+			bool isFault;
+			QVariant arg;
+			int faultCode;
+			QString faultString;
+		};
+
 		MaiaObject(QObject* parent = 0);
 		static QDomElement toXml(QVariant arg);
 		static QVariant fromXml(const QDomElement &elem);
 		QString prepareCall(QString method, QList<QVariant> args);
 		static QString prepareResponse(QVariant arg);
+		// Doesn't touch the object, so it can run on any thread
+		static ParseResult parse(const QString &response);
+		// Emits the result and deletes the object
+		void deliver(const ParseResult &result, QNetworkReply* reply);
 		
 	public slots:
 		void parseResponse(QString response, QNetworkReply* reply);
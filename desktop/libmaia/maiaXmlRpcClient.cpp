@@ -32,6 +32,12 @@
 
 #include <QDebug>
 #include <QAuthenticator>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+
+// Responses at least this long (a sync's bug lists, say) are parsed on
+// another thread, so the GUI and the next download carry on meanwhile
+#define PARSE_THREAD_THRESHOLD (64 * 1024)
 
 extern bool mLogAllXmlRpcOutput; // in MainWindow.cpp
 
@@ -151,8 +157,30 @@ void MaiaXmlRpcClient::replyFinished(QNetworkReply* reply) {
     if (mLogAllXmlRpcOutput)
         qDebug() << "MaiaXmlRpcClient replyFinished: " << response;
 
+	if(response.size() >= PARSE_THREAD_THRESHOLD) {
+		QFutureWatcher<MaiaObject::ParseResult> *watcher = new QFutureWatcher<MaiaObject::ParseResult>(this);
+		connect(watcher, SIGNAL(finished()), this, SLOT(parseFinished()));
+		parsing[watcher] = reply;
+		watcher->setFuture(QtConcurrent::run(&MaiaObject::parse, response));
+		return;
+	}
+
     // parseResponse deletes the MaiaObject
 	callmap[reply]->parseResponse(response, reply);
 	reply->deleteLater();
 	callmap.remove(reply);
 }
+
+void MaiaXmlRpcClient::parseFinished() {
+	QFutureWatcher<MaiaObject::ParseResult> *watcher =
+		static_cast<QFutureWatcher<MaiaObject::ParseResult> *>(sender());
+	QNetworkReply *reply = parsing.take(watcher);
+	MaiaObject::ParseResult result = watcher->result();
+	watcher->deleteLater();
+	if(!callmap.contains(reply))
+		return;
+
+	// deliver deletes the MaiaObject
+	callmap.take(reply)->deliver(result, reply);
+	reply->deleteLater();
+}
@@ -56,6 +56,7 @@ class MaiaXmlRpcClient : public QObject {
 
 	private slots:
 		void replyFinished(QNetworkReply*);
+		void parseFinished();
         void authenticationRequired(QNetworkReply* reply, QAuthenticator* auth);
 
 	private:
@@ -65,6 +66,8 @@ class MaiaXmlRpcClient : public QObject {
         QNetworkAccessManager manager;
 		QNetworkRequest request;
 		QMap<QNetworkReply*, MaiaObject*> callmap;
+		// Responses being parsed on another thread
+		QMap<QObject*, QNetworkReply*> parsing;
 };
 
 #endif
@@ -29,6 +29,7 @@
 #include <QSslSocket>
 #include "MainWindow.h"
 #include "ErrorHandler.h"
+#include "SqlProfiler.h"
 #include "qtsingleapplication/qtsingleapplication.h"
 
 #ifdef Q_OS_UNIX
@@ -99,10 +100,26 @@ int main(int argc, char *argv[])
     a.setApplicationVersion(APP_VERSION);
 
     digForSystemInfo();
+
+    // --profile-sql turns on the SQL profiler for this run, and
+    // --sql-report <file> also writes its report out on exit
+    QSettings settings("Entomologist");
+    QString sqlReport;
+    QStringList args = a.arguments();
+    int reportIndex = args.indexOf("--sql-report");
+    if ((reportIndex > 0) && (reportIndex + 1 < args.size()))
+        sqlReport = args.at(reportIndex + 1);
+    SqlProfiler::setEnabled(settings.value("sql-profiler", false).toBool()
+                            || args.contains("--profile-sql")
+                            || !sqlReport.isEmpty());
+
     MainWindow w;
     a.setActivationWindow(&w);
     w.show();
-    return a.exec();
+    int ret = a.exec();
+    if (!sqlReport.isEmpty())
+        SqlProfiler::dumpReport(sqlReport);
+    return ret;
 }
 
 // Add some useful debug information in case of an error report
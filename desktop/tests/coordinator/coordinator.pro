@@ -0,0 +1,33 @@
+# -------------------------------------------------
+# Unit tests for SyncCoordinator, run against fake backends that finish
+# when the test tells them to.  Build and run with:
+#   $ qmake && make && ./tst_coordinator
+# -------------------------------------------------
+QT += network sql
+CONFIG += qtestlib console
+CONFIG -= app_bundle
+TARGET = tst_coordinator
+TEMPLATE = app
+INCLUDEPATH += ../.. \
+    ../../trackers
+SOURCES += tst_coordinator.cpp \
+    ../../SyncCoordinator.cpp \
+    ../../trackers/Backend.cpp \
+    ../../trackers/SyncPhaseGraph.cpp \
+    ../../SqlWriter.cpp \
+    ../../SqlWriterThread.cpp \
+    ../../SqlUtilities.cpp \
+    ../../SqlRecordBatch.cpp \
+    ../../SqlProfiler.cpp \
+    ../../SqlStatementCache.cpp \
+    ../../SqlWatchdog.cpp
+HEADERS += ../../SyncCoordinator.h \
+    ../../trackers/Backend.h \
+    ../../trackers/SyncPhaseGraph.h \
+    ../../SqlWriter.h \
+    ../../SqlWriterThread.h \
+    ../../SqlUtilities.h \
+    ../../SqlRecordBatch.h \
+    ../../SqlProfiler.h \
+    ../../SqlStatementCache.h \
+    ../../SqlWatchdog.h
@@ -0,0 +1,196 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QtTest/QtTest>
+#include <QCoreApplication>
+#include <QSettings>
+
+#include "SyncCoordinator.h"
+#include "Backend.h"
+#include "ErrorHandler.h"
+
+// The real one pops up a dialog
+void
+ErrorHandler::handleError(const QString &message,
+                          const QString &details)
+{
+    qDebug() << "handleError: " << message << details;
+}
+
+// Stands in for a tracker: sync() only counts, and the test decides
+// when it's done
+class FakeBackend : public Backend
+{
+Q_OBJECT
+public:
+    FakeBackend(const QString &name, const QString &url)
+        : Backend(url)
+    {
+        setName(name);
+        syncs = 0;
+        uploads = 0;
+    }
+
+    void sync() { syncs++; }
+    void uploadAll() { uploads++; }
+    void finish() { emit syncFinished(); }
+    void fail() { emit backendError("Fake failure"); }
+
+    int syncs;
+    int uploads;
+};
+
+class TestCoordinator : public QObject
+{
+Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void parallelismLimit();
+    void perHostLimit();
+
+private:
+    void setLimits(int parallelism, int perHost);
+
+    QVariant mSavedParallelism;
+    QVariant mSavedPerHost;
+};
+
+void
+TestCoordinator::initTestCase()
+{
+    qRegisterMetaType<Backend *>("Backend*");
+    QSettings settings("Entomologist");
+    mSavedParallelism = settings.value("sync-parallelism");
+    mSavedPerHost = settings.value("sync-per-host");
+}
+
+void
+TestCoordinator::cleanupTestCase()
+{
+    QSettings settings("Entomologist");
+    if (mSavedParallelism.isValid())
+        settings.setValue("sync-parallelism", mSavedParallelism);
+    else
+        settings.remove("sync-parallelism");
+    if (mSavedPerHost.isValid())
+        settings.setValue("sync-per-host", mSavedPerHost);
+    else
+        settings.remove("sync-per-host");
+}
+
+void
+TestCoordinator::setLimits(int parallelism,
+                           int perHost)
+{
+    QSettings settings("Entomologist");
+    settings.setValue("sync-parallelism", parallelism);
+    settings.setValue("sync-per-host", perHost);
+}
+
+// Four trackers on four servers, two at a time
+void
+TestCoordinator::parallelismLimit()
+{
+    setLimits(2, 2);
+    FakeBackend a("a", "http://a.example.com/");
+    FakeBackend b("b", "http://b.example.com/");
+    FakeBackend c("c", "http://c.example.com/");
+    FakeBackend d("d", "http://d.example.com/");
+    QList<Backend *> backends;
+    backends << &a << &b << &c << &d;
+
+    SyncCoordinator coordinator;
+    QSignalSpy synced(&coordinator, SIGNAL(synced(Backend*, bool)));
+    QSignalSpy finished(&coordinator, SIGNAL(finished()));
+    coordinator.start(backends, SyncCoordinator::SYNC);
+    QCOMPARE(a.syncs + b.syncs + c.syncs + d.syncs, 2);
+    QCOMPARE(coordinator.activeNames().size(), 2);
+    QCOMPARE(c.syncs, 0);
+
+    // The one that finishes first makes room, whichever it is
+    b.finish();
+    QCOMPARE(c.syncs, 1);
+    QCOMPARE(d.syncs, 0);
+    QCOMPARE(coordinator.activeNames().size(), 2);
+
+    a.finish();
+    QCOMPARE(d.syncs, 1);
+    c.finish();
+    d.finish();
+    QCOMPARE(a.syncs + b.syncs + c.syncs + d.syncs, 4);
+    QCOMPARE(synced.count(), 4);
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(!coordinator.isActive());
+}
+
+// Three trackers on one server and one on another, one per server.  The
+// tracker on the other server doesn't wait behind the busy one.
+void
+TestCoordinator::perHostLimit()
+{
+    setLimits(4, 1);
+    FakeBackend a1("a1", "http://a.example.com/one");
+    FakeBackend a2("a2", "http://a.example.com/two");
+    FakeBackend a3("a3", "http://A.example.com/three");
+    FakeBackend b("b", "http://b.example.com/");
+    QList<Backend *> backends;
+    backends << &a1 << &a2 << &a3 << &b;
+
+    SyncCoordinator coordinator;
+    QSignalSpy synced(&coordinator, SIGNAL(synced(Backend*, bool)));
+    QSignalSpy finished(&coordinator, SIGNAL(finished()));
+    coordinator.start(backends, SyncCoordinator::SYNC);
+    QCOMPARE(a1.syncs, 1);
+    QCOMPARE(a2.syncs, 0);
+    QCOMPARE(a3.syncs, 0);
+    QCOMPARE(b.syncs, 1);
+
+    b.finish();
+    QCOMPARE(a2.syncs, 0);
+
+    a1.finish();
+    QCOMPARE(a2.syncs, 1);
+    QCOMPARE(a3.syncs, 0);
+
+    // A failed sync frees its server as well
+    a2.fail();
+    QCOMPARE(a3.syncs, 1);
+    QCOMPARE(synced.count(), 3);
+    QCOMPARE(synced.last().at(1).toBool(), false);
+
+    a3.finish();
+    QCOMPARE(finished.count(), 1);
+}
+
+// Backend.h pulls in the widget headers, but nothing here needs a display
+int
+main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    TestCoordinator test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_coordinator.moc"
@@ -0,0 +1,23 @@
+# -------------------------------------------------
+# Unit tests for the SQL layer, run against a scratch SQLite database.
+# Build and run with:
+#   $ qmake && make && ./tst_sql
+# -------------------------------------------------
+QT -= gui
+QT += sql
+CONFIG += qtestlib console
+CONFIG -= app_bundle
+TARGET = tst_sql
+TEMPLATE = app
+INCLUDEPATH += ../..
+SOURCES += tst_sql.cpp \
+    ../../SqlUtilities.cpp \
+    ../../SqlRecordBatch.cpp \
+    ../../SqlProfiler.cpp \
+    ../../SqlStatementCache.cpp \
+    ../../SqlWatchdog.cpp
+HEADERS += ../../SqlUtilities.h \
+    ../../SqlRecordBatch.h \
+    ../../SqlProfiler.h \
+    ../../SqlStatementCache.h \
+    ../../SqlWatchdog.h
@@ -0,0 +1,493 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QtTest/QtTest>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSettings>
+#include <QTemporaryFile>
+
+#include "SqlUtilities.h"
+#include "SqlRecordBatch.h"
+#include "ErrorHandler.h"
+
+// The real one pops up a dialog
+void
+ErrorHandler::handleError(const QString &message,
+                          const QString &details)
+{
+    qDebug() << "handleError: " << message << details;
+}
+
+class TestSql : public QObject
+{
+Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void sameBugTwice();
+    void searchedBugTwice();
+    void searchKeepsSyncedBug();
+    void multiInsertRefusesBugs();
+    void queryPlanUsesIndexes();
+    void unchangedMergeWritesNothing();
+    void pruneSearchesBounds();
+    void compressedCommentsIndexed();
+    void clearRecentIsPerTracker();
+    void changelogShowsCurrentValue();
+
+private:
+    QMap<QString, QString> bug(const QString &bugId,
+                               const QString &bugType,
+                               const QString &summary);
+    void insert(const QString &table,
+                QList<QMap<QString, QString> > list,
+                int operation = 0,
+                const QString &trackerId = "-1");
+    QString bugValue(const QString &table,
+                     const QString &bugId,
+                     const QString &column);
+    int bugCount(const QString &table);
+    QString queryPlan(const QString &sql);
+
+    QTemporaryFile mDbFile;
+    QVariant mSavedDays;
+    QVariant mSavedMaxRows;
+    QVariant mSavedThreshold;
+};
+
+// The writer clones the default connection, so the database has to be
+// a file rather than :memory:
+void
+TestSql::initTestCase()
+{
+    QSettings settings("Entomologist");
+    mSavedDays = settings.value("search-retention-days");
+    mSavedMaxRows = settings.value("search-retention-max-rows");
+    settings.setValue("search-retention-days", 30);
+    settings.setValue("search-retention-max-rows", 100);
+    mSavedThreshold = settings.value("comment-compress-threshold");
+    settings.setValue("comment-compress-threshold", 64);
+
+    QVERIFY(mDbFile.open());
+    mDbFile.close();
+    SqlUtilities::openDb(mDbFile.fileName());
+    // The version recorded doesn't matter here
+    SqlUtilities::createTables(1);
+    SqlUtilities::migrateTables(1);
+}
+
+void
+TestSql::cleanupTestCase()
+{
+    SqlUtilities::closeDb();
+
+    QSettings settings("Entomologist");
+    if (mSavedDays.isValid())
+        settings.setValue("search-retention-days", mSavedDays);
+    else
+        settings.remove("search-retention-days");
+    if (mSavedMaxRows.isValid())
+        settings.setValue("search-retention-max-rows", mSavedMaxRows);
+    else
+        settings.remove("search-retention-max-rows");
+    if (mSavedThreshold.isValid())
+        settings.setValue("comment-compress-threshold", mSavedThreshold);
+    else
+        settings.remove("comment-compress-threshold");
+}
+
+void
+TestSql::init()
+{
+    QSqlQuery q;
+    QVERIFY(q.exec("DELETE FROM bugzilla"));
+    QVERIFY(q.exec("DELETE FROM trac"));
+    QVERIFY(q.exec("DELETE FROM mantis"));
+    QVERIFY(q.exec("DELETE FROM comments"));
+    QVERIFY(q.exec("DELETE FROM shadow_bugzilla"));
+}
+
+void
+TestSql::cleanup()
+{
+    QSqlQuery q;
+    q.exec("DROP TRIGGER IF EXISTS mantis_log_insert");
+    q.exec("DROP TRIGGER IF EXISTS mantis_log_update");
+    q.exec("DROP TRIGGER IF EXISTS mantis_log_delete");
+    q.exec("DROP TRIGGER IF EXISTS comments_log_delete");
+    q.exec("DROP TABLE IF EXISTS write_log");
+}
+
+QMap<QString, QString>
+TestSql::bug(const QString &bugId,
+             const QString &bugType,
+             const QString &summary)
+{
+    QMap<QString, QString> map;
+    map["tracker_id"] = "1";
+    map["bug_id"] = bugId;
+    map["bug_type"] = bugType;
+    map["summary"] = summary;
+    map["status"] = "NEW";
+    map["last_modified"] = "2011-05-01 10:00:00";
+    return map;
+}
+
+void
+TestSql::insert(const QString &table,
+                QList<QMap<QString, QString> > list,
+                int operation,
+                const QString &trackerId)
+{
+    SqlUtilities writer;
+    QSignalSpy failures(&writer, SIGNAL(failure(QString)));
+    QSignalSpy finished(&writer, SIGNAL(bugsFinished(QStringList, int)));
+    writer.insertBugs(table, SqlRecordBatch::fromMaps(list), trackerId, operation);
+    QCOMPARE(failures.count(), 0);
+    QCOMPARE(finished.count(), 1);
+}
+
+QString
+TestSql::bugValue(const QString &table,
+                  const QString &bugId,
+                  const QString &column)
+{
+    QSqlQuery q;
+    q.prepare(QString("SELECT %1 FROM %2 WHERE tracker_id = 1 AND bug_id = :bug_id")
+              .arg(column).arg(table));
+    q.bindValue(":bug_id", bugId);
+    if (!q.exec() || !q.next())
+        return QString();
+    return q.value(0).toString();
+}
+
+int
+TestSql::bugCount(const QString &table)
+{
+    QSqlQuery q;
+    if (!q.exec(QString("SELECT COUNT(*) FROM %1").arg(table)) || !q.next())
+        return -1;
+    return q.value(0).toInt();
+}
+
+QString
+TestSql::queryPlan(const QString &sql)
+{
+    QSqlQuery q;
+    if (!q.exec("EXPLAIN QUERY PLAN " + sql))
+        return q.lastError().text();
+
+    // The detail is the last column, however many come before it
+    QStringList details;
+    while (q.next())
+        details << q.value(q.record().count() - 1).toString();
+    return details.join("; ");
+}
+
+// A bug that's already cached is updated in place, not inserted again
+void
+TestSql::sameBugTwice()
+{
+    QList<QMap<QString, QString> > list;
+    list << bug("100", "Reported", "First");
+    insert("bugzilla", list);
+    list.clear();
+    list << bug("100", "Reported", "Second");
+    insert("bugzilla", list);
+
+    QCOMPARE(bugCount("bugzilla"), 1);
+    QCOMPARE(bugValue("bugzilla", "100", "summary"), QString("Second"));
+}
+
+// Searching for the same ticket twice (Trac and Mantis search results)
+void
+TestSql::searchedBugTwice()
+{
+    QList<QMap<QString, QString> > list;
+    list << bug("200", "SearchedTemp", "First");
+    insert("trac", list, SqlUtilities::BUGS_INSERT_SEARCH);
+    list.clear();
+    list << bug("200", "SearchedTemp", "Second");
+    insert("trac", list, SqlUtilities::BUGS_INSERT_SEARCH);
+
+    QCOMPARE(bugCount("trac"), 1);
+    QCOMPARE(bugValue("trac", "200", "summary"), QString("Second"));
+}
+
+// A search result doesn't demote a bug a sync already cached
+void
+TestSql::searchKeepsSyncedBug()
+{
+    QList<QMap<QString, QString> > list;
+    list << bug("300", "Monitored", "Synced");
+    insert("mantis", list);
+    list.clear();
+    list << bug("300", "SearchedTemp", "Searched");
+    insert("mantis", list, SqlUtilities::BUGS_INSERT_SEARCH);
+
+    QCOMPARE(bugCount("mantis"), 1);
+    QCOMPARE(bugValue("mantis", "300", "bug_type"), QString("Monitored"));
+    QCOMPARE(bugValue("mantis", "300", "summary"), QString("Synced"));
+}
+
+// Bugs have to go through insertBugs, which converts last_modified
+void
+TestSql::multiInsertRefusesBugs()
+{
+    SqlUtilities writer;
+    QSignalSpy failures(&writer, SIGNAL(failure(QString)));
+    QSignalSpy successes(&writer, SIGNAL(success(int)));
+    QList<QMap<QString, QString> > list;
+    list << bug("400", "Reported", "Raw");
+    writer.multiInsert("bugzilla", SqlRecordBatch::fromMaps(list), 0);
+
+    QCOMPARE(failures.count(), 1);
+    QCOMPARE(successes.count(), 0);
+    QCOMPARE(bugCount("bugzilla"), 0);
+}
+
+// The lookups the writer and the tracker tabs make for every bug
+void
+TestSql::queryPlanUsesIndexes()
+{
+    QMap<QString, QString> plans;
+    QString byBug = "SELECT id FROM %1 WHERE tracker_id = 1 AND bug_id = '1'";
+    plans[QString(byBug).arg("bugzilla")] = "bugzilla_tracker_bug_unique";
+    plans[QString(byBug).arg("trac")] = "trac_tracker_bug_unique";
+    plans[QString(byBug).arg("mantis")] = "mantis_tracker_bug_unique";
+    plans[QString(byBug).arg("shadow_bugzilla")] = "shadow_bugzilla_tracker_bug_idx";
+    plans[QString(byBug).arg("shadow_trac")] = "shadow_trac_tracker_bug_idx";
+    plans[QString(byBug).arg("shadow_mantis")] = "shadow_mantis_tracker_bug_idx";
+    plans[QString(byBug).arg("comments")] = "comments_tracker_bug_idx";
+    plans[QString(byBug).arg("shadow_comments")] = "shadow_comments_tracker_bug_idx";
+    plans[QString(byBug).arg("attachments")] = "attachments_tracker_bug_idx";
+    plans[QString(byBug).arg("shadow_attachments")] = "shadow_attachments_tracker_bug_idx";
+    plans["SELECT id FROM bugzilla WHERE tracker_id = 1 AND bug_type = 'Reported'"] = "bugzilla_tracker_type_idx";
+    plans["SELECT id FROM trac WHERE tracker_id = 1 AND bug_type = 'Reported'"] = "trac_tracker_type_idx";
+    plans["SELECT id FROM mantis WHERE tracker_id = 1 AND bug_type = 'Reported'"] = "mantis_tracker_type_idx";
+
+    QMapIterator<QString, QString> i(plans);
+    while (i.hasNext())
+    {
+        i.next();
+        QString plan = queryPlan(i.key());
+        if (!plan.contains(i.value()))
+            QFAIL(qPrintable(QString("%1: %2").arg(i.key()).arg(plan)));
+    }
+}
+
+// A Mantis sync hands over the tracker's whole bug list.  When nothing
+// changed since the last one, the merge mustn't touch a single row or
+// throw away the cached comments.
+void
+TestSql::unchangedMergeWritesNothing()
+{
+    QList<QMap<QString, QString> > list;
+    for (int i = 1; i <= 200; ++i)
+        list << bug(QString::number(i), "Monitored", QString("Bug %1").arg(i));
+    insert("mantis", list, 0, "1");
+    QCOMPARE(bugCount("mantis"), 200);
+
+    QSqlQuery q;
+    QVERIFY(q.exec("INSERT INTO comments (tracker_id, bug_id, comment_id, author, comment) "
+                   "VALUES (1, 7, 1, 'someone', 'Cached')"));
+
+    // The writer has its own connection, so a TEMP trigger wouldn't see it
+    QStringList sql;
+    sql << "CREATE TABLE write_log (what TEXT)"
+        << "CREATE TRIGGER mantis_log_insert AFTER INSERT ON mantis BEGIN "
+           "INSERT INTO write_log VALUES ('insert'); END"
+        << "CREATE TRIGGER mantis_log_update AFTER UPDATE ON mantis BEGIN "
+           "INSERT INTO write_log VALUES ('update'); END"
+        << "CREATE TRIGGER mantis_log_delete AFTER DELETE ON mantis BEGIN "
+           "INSERT INTO write_log VALUES ('delete'); END"
+        << "CREATE TRIGGER comments_log_delete AFTER DELETE ON comments BEGIN "
+           "INSERT INTO write_log VALUES ('comment'); END";
+    for (int i = 0; i < sql.size(); ++i)
+        QVERIFY2(q.exec(sql.at(i)), qPrintable(q.lastError().text()));
+
+    insert("mantis", list, 0, "1");
+
+    QVERIFY(q.exec("SELECT COUNT(*) FROM write_log"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 0);
+    QCOMPARE(bugCount("mantis"), 200);
+    QVERIFY(q.exec("SELECT COUNT(*) FROM comments WHERE tracker_id = 1 AND bug_id = 7"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 1);
+}
+
+// 1500 searched bugs, 700 of them past the 30 days, and a cap of 100, so
+// both passes take more than one batch of 500
+void
+TestSql::pruneSearchesBounds()
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery q;
+    QVariantList trackerIds, bugIds, bugTypes;
+    for (int i = 1; i <= 1500; ++i)
+    {
+        trackerIds << 1;
+        bugIds << i;
+        bugTypes << "Searched";
+    }
+    trackerIds << 1;
+    bugIds << 5000;
+    bugTypes << "Reported";
+
+    QVERIFY(db.transaction());
+    q.prepare("INSERT INTO bugzilla (tracker_id, bug_id, bug_type) VALUES (?, ?, ?)");
+    q.addBindValue(trackerIds);
+    q.addBindValue(bugIds);
+    q.addBindValue(bugTypes);
+    QVERIFY2(q.execBatch(), qPrintable(q.lastError().text()));
+    QVERIFY(q.exec("UPDATE bugzilla SET searched_at = searched_at - 40 * 86400 WHERE bug_id <= 700"));
+    // Bug 1 has unsent changes, so it stays whatever its age
+    QVERIFY(q.exec("INSERT INTO shadow_bugzilla (tracker_id, bug_id, bug_type) VALUES (1, 1, 'Searched')"));
+    QVERIFY(q.exec("INSERT INTO comments (tracker_id, bug_id, comment_id, comment) VALUES (1, 2, 1, 'Expired')"));
+    QVERIFY(q.exec("INSERT INTO comments (tracker_id, bug_id, comment_id, comment) VALUES (1, 5000, 1, 'Kept')"));
+    QVERIFY(db.commit());
+
+    SqlUtilities writer;
+    writer.maintainDatabase(0, SqlUtilities::MAINTAIN_PRUNE_SEARCHES);
+
+    // 699 expired, then 700 of the 801 left over the cap.  Bug 1 is the
+    // oldest, so it's past the cap too, and kept anyway.
+    QVERIFY(q.exec("SELECT COUNT(*) FROM bugzilla WHERE bug_type = 'Searched'"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 101);
+    QVERIFY(q.exec("SELECT COUNT(*) FROM bugzilla WHERE bug_type = 'Searched' AND bug_id <= 700"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 1);
+    QCOMPARE(bugValue("bugzilla", "1", "bug_type"), QString("Searched"));
+    QCOMPARE(bugValue("bugzilla", "5000", "bug_type"), QString("Reported"));
+    QVERIFY(q.exec("SELECT bug_id FROM comments"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 5000);
+    QVERIFY(!q.next());
+}
+
+// Bugzilla leaves comment_id empty, so the full text index has to find
+// compressed comments by the rows that were just inserted
+void
+TestSql::compressedCommentsIndexed()
+{
+    if (!QSqlDatabase::database().tables().contains("comments_fts"))
+        QSKIP("This SQLite has no FTS", SkipSingle);
+
+    QList<QMap<QString, QString> > list;
+    QStringList words;
+    words << "" << "alpha" << "" << "bravo";
+    for (int i = 1; i <= 3; ++i)
+    {
+        QMap<QString, QString> comment;
+        comment["tracker_id"] = "1";
+        comment["bug_id"] = QString::number(i);
+        comment["comment_id"] = "";
+        comment["author"] = "someone";
+        // Long and repetitive enough to be compressed, except the second
+        if (i == 2)
+            comment["comment"] = "short";
+        else
+            comment["comment"] = QString("%1 ").arg(words.at(i)).repeated(40);
+        list << comment;
+    }
+
+    SqlUtilities writer;
+    QSignalSpy failures(&writer, SIGNAL(failure(QString)));
+    writer.insertComments(SqlRecordBatch::fromMaps(list));
+    QCOMPARE(failures.count(), 0);
+
+    QSqlQuery q;
+    QVERIFY(q.exec("SELECT typeof(comment) FROM comments WHERE bug_id = 1"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toString(), QString("blob"));
+
+    QString match = "SELECT comments.bug_id FROM comments_fts "
+                    "JOIN comments ON comments.id = comments_fts.docid "
+                    "WHERE comments_fts MATCH '%1'";
+    QVERIFY(q.exec(QString(match).arg("alpha")));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 1);
+    QVERIFY(!q.next());
+    QVERIFY(q.exec(QString(match).arg("bravo")));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 3);
+    QVERIFY(!q.next());
+    QVERIFY(q.exec(QString(match).arg("short")));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(0).toInt(), 2);
+    QVERIFY(!q.next());
+}
+
+// Two Bugzilla trackers, and a sync of the first one starting
+void
+TestSql::clearRecentIsPerTracker()
+{
+    QSqlQuery q;
+    QVERIFY(q.exec(QString("INSERT INTO bugzilla (tracker_id, bug_id, highlight_type) VALUES (1, 1, %1)")
+                   .arg(SqlUtilities::HIGHLIGHT_RECENT)));
+    QVERIFY(q.exec(QString("INSERT INTO bugzilla (tracker_id, bug_id, highlight_type) VALUES (2, 1, %1)")
+                   .arg(SqlUtilities::HIGHLIGHT_RECENT)));
+
+    SqlUtilities writer;
+    QSignalSpy failures(&writer, SIGNAL(failure(QString)));
+    writer.clearRecentBugs("bugzilla", "1");
+    QCOMPARE(failures.count(), 0);
+
+    QVERIFY(q.exec("SELECT tracker_id, highlight_type FROM bugzilla ORDER BY tracker_id"));
+    QVERIFY(q.next());
+    QCOMPARE(q.value(1).toInt(), 0);
+    QVERIFY(q.next());
+    QCOMPARE(q.value(1).toInt(), int(SqlUtilities::HIGHLIGHT_RECENT));
+}
+
+// A sync that changes the bug after the user edited it moves the
+// changelog's "from" value along
+void
+TestSql::changelogShowsCurrentValue()
+{
+    QSqlQuery q;
+    QVERIFY(q.exec("INSERT OR REPLACE INTO trackers (id, type, name) VALUES (1, 'Bugzilla', 'Test')"));
+    QVERIFY(q.exec("INSERT INTO bugzilla (tracker_id, bug_id, status) VALUES (1, 600, 'NEW')"));
+    QVERIFY(q.exec("INSERT INTO shadow_bugzilla (tracker_id, bug_id, status) VALUES (1, 600, 'RESOLVED')"));
+    QVERIFY(q.exec("UPDATE bugzilla SET status = 'ASSIGNED' WHERE bug_id = 600"));
+
+    QVariantList changelog = SqlUtilities::getBugzillaChangelog();
+    QCOMPARE(changelog.size(), 1);
+    QVariantList entries = changelog.first().toList();
+    QCOMPARE(entries.size(), 1);
+    QVariantMap entry = entries.first().toMap();
+    QCOMPARE(entry.value("column_name").toString(), QString("Status"));
+    QCOMPARE(entry.value("from").toString(), QString("ASSIGNED"));
+    QCOMPARE(entry.value("to").toString(), QString("RESOLVED"));
+}
+
+QTEST_MAIN(TestSql)
+#include "tst_sql.moc"
@@ -0,0 +1,16 @@
+# -------------------------------------------------
+# Unit tests for the sync bookkeeping, which doesn't need the network
+# or a database.  Build and run with:
+#   $ qmake && make && ./tst_sync
+# -------------------------------------------------
+QT -= gui
+CONFIG += qtestlib console
+CONFIG -= app_bundle
+TARGET = tst_sync
+TEMPLATE = app
+INCLUDEPATH += ../../trackers
+SOURCES += tst_sync.cpp \
+    ../../trackers/SyncPhaseGraph.cpp \
+    ../../trackers/SyncPipeline.cpp
+HEADERS += ../../trackers/SyncPhaseGraph.h \
+    ../../trackers/SyncPipeline.h
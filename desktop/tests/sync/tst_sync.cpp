@@ -0,0 +1,217 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QtTest/QtTest>
+#include <QSettings>
+
+#include "SyncPhaseGraph.h"
+#include "SyncPipeline.h"
+
+// Stands in for a backend: every phase slot just records that it ran
+class PhaseTarget : public QObject
+{
+Q_OBJECT
+public:
+    QStringList ran;
+
+public slots:
+    void first() { ran << "first"; }
+    void second() { ran << "second"; }
+    void third() { ran << "third"; }
+};
+
+class TestSync : public QObject
+{
+Q_OBJECT
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void restoredPhasesDontRun();
+    void restoredGraphFinishes();
+    void unknownRestoreIsIgnored();
+    void phaseCycleFails();
+    void pipelineDepthBound();
+    void pipelineParseIsFree();
+
+private:
+    void buildGraph(SyncPhaseGraph &graph);
+
+    QVariant mSavedDepth;
+};
+
+void
+TestSync::initTestCase()
+{
+    QSettings settings("Entomologist");
+    mSavedDepth = settings.value("sync-pipeline-depth");
+    settings.setValue("sync-pipeline-depth", 2);
+}
+
+void
+TestSync::cleanupTestCase()
+{
+    QSettings settings("Entomologist");
+    if (mSavedDepth.isValid())
+        settings.setValue("sync-pipeline-depth", mSavedDepth);
+    else
+        settings.remove("sync-pipeline-depth");
+}
+
+// first -> second -> third
+void
+TestSync::buildGraph(SyncPhaseGraph &graph)
+{
+    graph.clear();
+    graph.addPhase("first", "first");
+    graph.addPhase("second", "second", QStringList("first"));
+    graph.addPhase("third", "third", QStringList("second"));
+}
+
+void
+TestSync::restoredPhasesDontRun()
+{
+    PhaseTarget target;
+    SyncPhaseGraph *graph = new SyncPhaseGraph(&target);
+    QSignalSpy finished(graph, SIGNAL(finished()));
+    buildGraph(*graph);
+
+    // An interrupted sync got through the first phase
+    graph->restore("first");
+    graph->start();
+    QCoreApplication::processEvents();
+    QCOMPARE(target.ran, QStringList("second"));
+    QVERIFY(graph->isRunning());
+
+    graph->finish("second");
+    QCoreApplication::processEvents();
+    QCOMPARE(target.ran, QStringList() << "second" << "third");
+
+    graph->finish("third");
+    QCOMPARE(finished.count(), 1);
+    QVERIFY(!graph->isRunning());
+}
+
+void
+TestSync::restoredGraphFinishes()
+{
+    PhaseTarget target;
+    SyncPhaseGraph *graph = new SyncPhaseGraph(&target);
+    QSignalSpy finished(graph, SIGNAL(finished()));
+    QSignalSpy failed(graph, SIGNAL(failed(QString)));
+    buildGraph(*graph);
+
+    graph->restore("first");
+    graph->restore("second");
+    graph->restore("third");
+    graph->start();
+    QCoreApplication::processEvents();
+    QVERIFY(target.ran.isEmpty());
+    QCOMPARE(finished.count(), 1);
+    QCOMPARE(failed.count(), 0);
+}
+
+void
+TestSync::unknownRestoreIsIgnored()
+{
+    PhaseTarget target;
+    SyncPhaseGraph *graph = new SyncPhaseGraph(&target);
+    QSignalSpy failed(graph, SIGNAL(failed(QString)));
+    buildGraph(*graph);
+
+    // e.g. "details-partial", which is data rather than a phase
+    graph->restore("fourth");
+    graph->start();
+    QCoreApplication::processEvents();
+    QCOMPARE(target.ran, QStringList("first"));
+    QCOMPARE(failed.count(), 0);
+}
+
+// second and third wait on each other, so once first is done nothing
+// can start and the sync has to fail rather than finish
+void
+TestSync::phaseCycleFails()
+{
+    PhaseTarget target;
+    SyncPhaseGraph *graph = new SyncPhaseGraph(&target);
+    QSignalSpy finished(graph, SIGNAL(finished()));
+    QSignalSpy failed(graph, SIGNAL(failed(QString)));
+    graph->addPhase("first", "first");
+    graph->addPhase("second", "second", QStringList() << "first" << "third");
+    graph->addPhase("third", "third", QStringList("second"));
+
+    graph->start();
+    QCoreApplication::processEvents();
+    QCOMPARE(target.ran, QStringList("first"));
+
+    graph->finish("first");
+    QCoreApplication::processEvents();
+    QCOMPARE(target.ran, QStringList("first"));
+    QCOMPARE(failed.count(), 1);
+    QCOMPARE(finished.count(), 0);
+    QVERIFY(!graph->isRunning());
+}
+
+// Pages being fetched and pages waiting for the writer share the depth
+void
+TestSync::pipelineDepthBound()
+{
+    SyncPipeline pipeline;
+    QVERIFY(pipeline.canFetch());
+    QVERIFY(pipeline.isIdle());
+
+    pipeline.begin(SyncPipeline::FETCH);
+    pipeline.begin(SyncPipeline::FETCH);
+    QVERIFY(!pipeline.canFetch());
+
+    pipeline.end(SyncPipeline::FETCH, 10);
+    QVERIFY(pipeline.canFetch());
+    pipeline.begin(SyncPipeline::WRITE);
+    QVERIFY(!pipeline.canFetch());
+
+    pipeline.end(SyncPipeline::WRITE, 10);
+    QVERIFY(pipeline.canFetch());
+    pipeline.end(SyncPipeline::FETCH, 10);
+    QVERIFY(pipeline.isIdle());
+
+    // Ending a stage with nothing in it doesn't free up room
+    pipeline.end(SyncPipeline::WRITE, 0);
+    pipeline.begin(SyncPipeline::FETCH);
+    pipeline.begin(SyncPipeline::FETCH);
+    QVERIFY(!pipeline.canFetch());
+}
+
+// Pages being parsed don't count against the depth
+void
+TestSync::pipelineParseIsFree()
+{
+    SyncPipeline pipeline;
+    pipeline.begin(SyncPipeline::PARSE);
+    pipeline.begin(SyncPipeline::PARSE);
+    pipeline.begin(SyncPipeline::PARSE);
+    QVERIFY(pipeline.canFetch());
+    QVERIFY(!pipeline.isIdle());
+}
+
+QTEST_MAIN(TestSync)
+#include "tst_sync.moc"
@@ -0,0 +1,178 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#include "AllBugsUI.h"
+#include "SqlBugDelegate.h"
+#include "SqlBugModel.h"
+
+#include <QHeaderView>
+#include <QSettings>
+#include <QTableView>
+#include <QVBoxLayout>
+#include <QDebug>
+
+AllBugsUI::AllBugsUI(QWidget *parent) :
+    QWidget(parent)
+{
+    QSettings settings("Entomologist");
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    pTableView = new QTableView(this);
+    pTableView->setFrameShape(QFrame::NoFrame);
+    pTableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    pTableView->setSelectionMode(QAbstractItemView::SingleSelection);
+    pTableView->setSelectionBehavior(QAbstractItemView::SelectRows);
+    pTableView->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(pTableView);
+
+    mBugTypes << "Searched" << "Assigned" << "Reported" << "CC" << "Monitored";
+    unsigned int savedSortColumn = settings.value("all-bugs-sort-column", 4).toUInt();
+    Qt::SortOrder savedSortOrder = static_cast<Qt::SortOrder>(settings.value("all-bugs-sort-order", 1).toUInt());
+    setSortQuery(savedSortColumn, savedSortOrder);
+
+    pBugModel = new SqlBugModel(this);
+    SqlBugDelegate *delegate = new SqlBugDelegate();
+    delegate->setTimestampColumn(4);
+    pTableView->setItemDelegate(delegate);
+    pTableView->setModel(pBugModel);
+    reloadFromDatabase();
+
+    pBugModel->setHeaderData(1, Qt::Horizontal, tr(""));
+    pBugModel->setHeaderData(2, Qt::Horizontal, tr("Tracker"));
+    pBugModel->setHeaderData(3, Qt::Horizontal, tr("Bug ID"));
+    pBugModel->setHeaderData(4, Qt::Horizontal, tr("Last Modified"));
+    pBugModel->setHeaderData(5, Qt::Horizontal, tr("Severity"));
+    pBugModel->setHeaderData(6, Qt::Horizontal, tr("Priority"));
+    pBugModel->setHeaderData(7, Qt::Horizontal, tr("Assignee"));
+    pBugModel->setHeaderData(8, Qt::Horizontal, tr("Status"));
+    pBugModel->setHeaderData(9, Qt::Horizontal, tr("Summary"));
+    pTableView->setSortingEnabled(true);
+    pTableView->setGridStyle(Qt::PenStyle(Qt::DotLine));
+    pTableView->hideColumn(0); // Hide the internal row id
+    pTableView->hideColumn(10); // and the tracker id
+    pTableView->horizontalHeader()->setResizeMode(1, QHeaderView::Fixed);
+    pTableView->verticalHeader()->hide();
+    pTableView->setAlternatingRowColors(true);
+    // The model only fetches rows as they're scrolled into view, so avoid
+    // the resize*ToContents() calls that the per-tracker tabs make.
+    pTableView->verticalHeader()->setDefaultSectionSize(pTableView->fontMetrics().height() + 6);
+
+    QHeaderView *v = pTableView->horizontalHeader();
+    v->setSortIndicator(savedSortColumn, savedSortOrder);
+    connect(v, SIGNAL(sortIndicatorChanged(int,Qt::SortOrder)),
+            this, SLOT(sortIndicatorChanged(int,Qt::SortOrder)));
+    connect(pTableView, SIGNAL(doubleClicked(QModelIndex)),
+            this, SLOT(itemDoubleClicked(QModelIndex)));
+}
+
+AllBugsUI::~AllBugsUI()
+{
+}
+
+void
+AllBugsUI::setShowOptions(bool showMyBugs,
+                          bool showMyReports,
+                          bool showMyCCs,
+                          bool showMonitored)
+{
+    mBugTypes.clear();
+    mBugTypes << "Searched";
+    if (showMyBugs)
+        mBugTypes << "Assigned";
+    if (showMyReports)
+        mBugTypes << "Reported";
+    if (showMyCCs)
+        mBugTypes << "CC";
+    if (showMonitored)
+        mBugTypes << "Monitored";
+    reloadFromDatabase();
+}
+
+void
+AllBugsUI::sortIndicatorChanged(int logicalIndex, Qt::SortOrder order)
+{
+    setSortQuery(logicalIndex, order);
+    QSettings settings("Entomologist");
+    settings.setValue("all-bugs-sort-column", logicalIndex);
+    settings.setValue("all-bugs-sort-order", order);
+    reloadFromDatabase();
+}
+
+void
+AllBugsUI::setSortQuery(int logicalIndex, Qt::SortOrder order)
+{
+    QString sortOrder= "ASC";
+    if (order == Qt::DescendingOrder)
+        sortOrder = "DESC";
+
+    QString newSortQuery =" ORDER BY %1 " + sortOrder;
+    switch(logicalIndex)
+    {
+    case 1:
+        mSortQuery = newSortQuery.arg("highlight_type");
+        break;
+    case 2:
+        mSortQuery = newSortQuery.arg("3");
+        break;
+    case 3:
+        mSortQuery = newSortQuery.arg("bug_id");
+        break;
+    case 5:
+        mSortQuery = newSortQuery.arg("severity");
+        break;
+    case 6:
+        mSortQuery = newSortQuery.arg("priority");
+        break;
+    case 7:
+        mSortQuery = newSortQuery.arg("assigned_to");
+        break;
+    case 8:
+        mSortQuery = newSortQuery.arg("status");
+        break;
+    case 9:
+        mSortQuery = newSortQuery.arg("summary");
+        break;
+    default:
+        mSortQuery = newSortQuery.arg("last_modified");
+        break;
+    }
+}
+
+void
+AllBugsUI::reloadFromDatabase()
+{
+    QString query = QString("SELECT row_id, highlight_type, "
+                            "(SELECT name FROM trackers WHERE trackers.id = all_bugs.tracker_id), "
+                            "bug_id, last_modified, severity, priority, assigned_to, status, summary, tracker_id "
+                            "FROM all_bugs WHERE bug_type IN ('%1')")
+                            .arg(mBugTypes.join("','"));
+    pBugModel->setQuery(query + mSortQuery);
+}
+
+void
+AllBugsUI::itemDoubleClicked(const QModelIndex &index)
+{
+    QString rowId = index.sibling(index.row(), 0).data().toString();
+    QString trackerId = index.sibling(index.row(), 10).data().toString();
+    emit openBug(trackerId, rowId);
+}
@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2011 SUSE Linux Products GmbH
+ *  All Rights Reserved.
+ *
+ *  This file is part of Entomologist.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License version 2
+ *  along with Foobar.  If not, see <http://www.gnu.org/licenses/>
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+
+#ifndef ALLBUGSUI_H
+#define ALLBUGSUI_H
+
+#include <QWidget>
+#include <QStringList>
+
+class QTableView;
+class QModelIndex;
+class SqlBugModel;
+
+// Lists the cached bugs of every tracker in one table, from the all_bugs
+// view.  Opening a bug is handed off to the tab of the tracker it came from.
+class AllBugsUI : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit AllBugsUI(QWidget *parent = 0);
+    ~AllBugsUI();
+
+signals:
+    void openBug(const QString &trackerId,
+                 const QString &rowId);
+
+public slots:
+    void reloadFromDatabase();
+    void setShowOptions(bool showMyBugs,
+                        bool showMyReports,
+                        bool showMyCCs,
+                        bool showMonitored);
+    void sortIndicatorChanged(int logicalIndex, Qt::SortOrder order);
+    void itemDoubleClicked(const QModelIndex &index);
+
+private:
+    void setSortQuery(int logicalIndex, Qt::SortOrder order);
+    QTableView *pTableView;
+    SqlBugModel *pBugModel;
+    QStringList mBugTypes;
+    QString mSortQuery;
+};
+
+#endif // ALLBUGSUI_H
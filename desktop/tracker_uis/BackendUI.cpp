@@ -31,6 +31,7 @@
 #include <QProgressDialog>
 #include <QSettings>
 #include "SqlUtilities.h"
+#include "SqlReader.h"
 
 BackendUI::BackendUI(const QString &id,
                      const QString &trackerName,
@@ -49,12 +50,35 @@ BackendUI::BackendUI(const QString &id,
     pBugModel = new SqlBugModel();
     pBugModel->setParent(this);
     mWhereQuery = "";
+    pReader = new SqlReader(this);
+    connect(pReader, SIGNAL(finished(SqlReadResult)),
+            this, SLOT(fieldValuesLoaded(SqlReadResult)));
+    connect(pBackend, SIGNAL(bugsUpdated()),
+            this, SLOT(loadFields()));
 }
 
 BackendUI::~BackendUI()
 {
 }
 
+void
+BackendUI::readFieldValues(const QString &table,
+                           const QStringList &fields)
+{
+    for (int i = 0; i < fields.size(); ++i)
+        mFieldRequests[pReader->fieldValues(mId, fields.at(i))] = fields.at(i);
+    mFieldRequests[pReader->assignedToValues(table, mId)] = "assigned_to";
+}
+
+void
+BackendUI::fieldValuesLoaded(SqlReadResult result)
+{
+    if (!mFieldRequests.contains(result.id))
+        return;
+
+    mFieldValues[mFieldRequests.take(result.id)] = result.values;
+}
+
 void
 BackendUI::searchCommentsDialogClosing(QMap<QString, QString> details,
                                        const QString &newComment)
@@ -238,7 +262,7 @@ BackendUI::saveNewShadowItems(const QString &tableName,
         comment["bug_id"] = shadowBug["bug_id"];
         comment["comment"] = newComment;
         comment["private"] = isPrivate;
-        comment["timestamp"] = QDateTime::currentDateTime().toString("yyyy-MM-ddThh:mm:ss");
+        comment["timestamp"] = QString::number(QDateTime::currentDateTime().toTime_t());
         SqlUtilities::simpleInsert("shadow_comments", comment);
     }
 }
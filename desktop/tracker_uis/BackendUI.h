@@ -27,7 +27,10 @@
 #include <QAction>
 #include <QHeaderView>
 
+#include "SqlReaderThread.h"
+
 class SqlBugModel;
+class SqlReader;
 class Backend;
 class QProgressDialog;
 
@@ -44,7 +47,6 @@ public:
     void setID(const QString &id) { mId = id; }
     void setTrackerName(const QString &name) { mTrackerName = name; }
     void setBackend(Backend *backend);
-    virtual void loadFields() {}
     virtual void loadSearchResult(const QString &id) { Q_UNUSED(id); }
 
 signals:
@@ -53,6 +55,9 @@ signals:
     void bugChanged();
 
 public slots:
+    // Rereads the values offered in the bug details' combo boxes.  It's
+    // also run after every sync, since the assignees come from the bugs.
+    virtual void loadFields() {}
     virtual void reloadFromDatabase() {}
     void setShowOptions(bool showMyBugs,
                         bool showMyReports,
@@ -67,9 +72,14 @@ public slots:
 
     void removeSearchedBug(int rowId);
 
+    // Opens the details dialog for a row of this tracker's bug table
+    virtual void showBugDetails(const QString &rowId) { Q_UNUSED(rowId); }
     virtual void addBugToToDoList(const QString &bugId) { Q_UNUSED(bugId); }
     virtual void searchResultFinished(QMap<QString, QString> resultMap) { Q_UNUSED(resultMap); }
 
+private slots:
+    void fieldValuesLoaded(SqlReadResult result);
+
 protected:
     void hideColumnsMenu(const QPoint &pos,
                          const QString &settingName,
@@ -80,6 +90,10 @@ protected:
     void startSearchProgress();
     void stopSearchProgress();
     void restoreHeaderSetting();
+    // Reads the fields off the GUI thread into mFieldValues, along with
+    // the assignees of table's bugs as "assigned_to".  The lists are
+    // empty until the reads are back.
+    void readFieldValues(const QString &table, const QStringList &fields);
 
     Backend *pBackend;
     bool mShowMyBugs, mShowMyReports, mShowMyCCs, mShowMonitored;
@@ -89,9 +103,12 @@ protected:
     QHeaderView *v;
     SqlBugModel *pBugModel;
     QVariantMap mHiddenColumns;
+    QMap<QString, QStringList> mFieldValues;
 
 private:
     QProgressDialog *pSearchProgress;
+    SqlReader *pReader;
+    QMap<int, QString> mFieldRequests;
 };
 
 #endif // BACKENDUI_H
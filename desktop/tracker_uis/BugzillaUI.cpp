@@ -112,10 +112,9 @@ BugzillaUI::~BugzillaUI()
 void
 BugzillaUI::loadFields()
 {
-    mSeverities = SqlUtilities::fieldValues(mId, "severity");
-    mPriorities = SqlUtilities::fieldValues(mId, "priority");
-    mStatuses = SqlUtilities::fieldValues(mId, "status");
-    mResolutions = SqlUtilities::fieldValues(mId, "resolution");
+    QStringList fields;
+    fields << "severity" << "priority" << "status" << "resolution";
+    readFieldValues("bugzilla", fields);
 }
 
 void
@@ -140,14 +139,13 @@ BugzillaUI::searchResultFinished(QMap<QString, QString> resultMap)
 
     dialog->setBugInfo(resultMap);
     BugzillaDetails *details = new BugzillaDetails();
-    details->setSeverities(resultMap["severity"], mSeverities);
-    details->setPriorities(resultMap["priority"], mPriorities);
-    details->setStatuses(resultMap["status"], mStatuses);
-    details->setResolutions(resultMap["resolution"], mResolutions);
+    details->setSeverities(resultMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(resultMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(resultMap["status"], mFieldValues.value("status"));
+    details->setResolutions(resultMap["resolution"], mFieldValues.value("resolution"));
     details->setComponent(resultMap["component"]);
     details->setProduct(resultMap["product"]);
-    QStringList assignedVals = SqlUtilities::assignedToValues("bugzilla", mId);
-    details->setAssigneds(resultMap["assigned_to"], assignedVals);
+    details->setAssigneds(resultMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     stopSearchProgress();
@@ -158,7 +156,12 @@ BugzillaUI::searchResultFinished(QMap<QString, QString> resultMap)
 void
 BugzillaUI::itemDoubleClicked(const QModelIndex &index)
 {
-    QString rowId = index.sibling(index.row(), 0).data().toString();
+    showBugDetails(index.sibling(index.row(), 0).data().toString());
+}
+
+void
+BugzillaUI::showBugDetails(const QString &rowId)
+{
     QMap<QString, QString> detailMap = SqlUtilities::bugzillaBugDetail(rowId);
     BugDetailsDialog *dialog = new BugDetailsDialog(pBackend, this);
     connect (dialog, SIGNAL(commentsDialogClosing(QMap<QString,QString>,QString)),
@@ -166,14 +169,13 @@ BugzillaUI::itemDoubleClicked(const QModelIndex &index)
 
     dialog->setBugInfo(detailMap);
     BugzillaDetails *details = new BugzillaDetails();
-    details->setSeverities(detailMap["severity"], mSeverities);
-    details->setPriorities(detailMap["priority"], mPriorities);
-    details->setStatuses(detailMap["status"], mStatuses);
-    details->setResolutions(detailMap["resolution"], mResolutions);
+    details->setSeverities(detailMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(detailMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(detailMap["status"], mFieldValues.value("status"));
+    details->setResolutions(detailMap["resolution"], mFieldValues.value("resolution"));
     details->setComponent(detailMap["component"]);
     details->setProduct(detailMap["product"]);
-    QStringList assignedVals = SqlUtilities::assignedToValues("bugzilla", mId);
-    details->setAssigneds(detailMap["assigned_to"], assignedVals);
+    details->setAssigneds(detailMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     dialog->show();
@@ -190,6 +192,7 @@ void
 BugzillaUI::setupTable()
 {
     SqlBugDelegate *delegate = new SqlBugDelegate();
+    delegate->setTimestampColumn(3);
     ui->tableView->setItemDelegate(delegate);
     ui->tableView->setModel(pBugModel);
 
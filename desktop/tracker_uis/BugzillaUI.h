@@ -45,6 +45,7 @@ public:
 public slots:
     void reloadFromDatabase();
     void itemDoubleClicked(const QModelIndex &index);
+    void showBugDetails(const QString &rowId);
     void headerContextMenu(const QPoint &pos);
     void sortIndicatorChanged(int logicalIndex, Qt::SortOrder order);
     void loadSearchResult(const QString &id);
@@ -53,7 +54,6 @@ public slots:
 private:
     void setupTable();
     Ui::BugzillaUI *ui;
-    QStringList mPriorities, mSeverities, mStatuses, mResolutions;
 };
 
 #endif // BUGZILLAUI_H
@@ -135,11 +135,9 @@ MantisUI::headerContextMenu(const QPoint &pos)
 void
 MantisUI::loadFields()
 {
-    mSeverities = SqlUtilities::fieldValues(mId, "severity");
-    mPriorities = SqlUtilities::fieldValues(mId, "priority");
-    mStatuses = SqlUtilities::fieldValues(mId, "status");
-    mResolutions = SqlUtilities::fieldValues(mId, "resolution");
-    mRepro = SqlUtilities::fieldValues(mId, "reproducibility");
+    QStringList fields;
+    fields << "severity" << "priority" << "status" << "resolution" << "reproducibility";
+    readFieldValues("mantis", fields);
 }
 void
 MantisUI::loadSearchResult(const QString &id)
@@ -162,13 +160,12 @@ MantisUI::searchResultFinished(QMap<QString, QString> resultMap)
     details->setProject(resultMap["project"]);
     details->setVersion(resultMap["product_version"]);
     details->setCategory(resultMap["category"]);
-    details->setSeverities(resultMap["severity"], mSeverities);
-    details->setPriorities(resultMap["priority"], mPriorities);
-    details->setStatuses(resultMap["status"], mStatuses);
-    details->setResolutions(resultMap["resolution"], mResolutions);
-    details->setReproducibility(resultMap["reproducibility"], mRepro);
-    QStringList assignedVals = SqlUtilities::assignedToValues("mantis", mId);
-    details->setAssigneds(resultMap["assigned_to"], assignedVals);
+    details->setSeverities(resultMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(resultMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(resultMap["status"], mFieldValues.value("status"));
+    details->setResolutions(resultMap["resolution"], mFieldValues.value("resolution"));
+    details->setReproducibility(resultMap["reproducibility"], mFieldValues.value("reproducibility"));
+    details->setAssigneds(resultMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     stopSearchProgress();
@@ -179,7 +176,12 @@ MantisUI::searchResultFinished(QMap<QString, QString> resultMap)
 void
 MantisUI::itemDoubleClicked(const QModelIndex &index)
 {
-    QString rowId = index.sibling(index.row(), 0).data().toString();
+    showBugDetails(index.sibling(index.row(), 0).data().toString());
+}
+
+void
+MantisUI::showBugDetails(const QString &rowId)
+{
     QMap<QString, QString> detailMap = SqlUtilities::mantisBugDetail(rowId);
     BugDetailsDialog *dialog = new BugDetailsDialog(pBackend, this);
     connect (dialog, SIGNAL(commentsDialogClosing(QMap<QString,QString>,QString)),
@@ -190,13 +192,12 @@ MantisUI::itemDoubleClicked(const QModelIndex &index)
     details->setProject(detailMap["project"]);
     details->setVersion(detailMap["product_version"]);
     details->setCategory(detailMap["category"]);
-    details->setSeverities(detailMap["severity"], mSeverities);
-    details->setPriorities(detailMap["priority"], mPriorities);
-    details->setStatuses(detailMap["status"], mStatuses);
-    details->setResolutions(detailMap["resolution"], mResolutions);
-    details->setReproducibility(detailMap["reproducibility"], mRepro);
-    QStringList assignedVals = SqlUtilities::assignedToValues("mantis", mId);
-    details->setAssigneds(detailMap["assigned_to"], assignedVals);
+    details->setSeverities(detailMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(detailMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(detailMap["status"], mFieldValues.value("status"));
+    details->setResolutions(detailMap["resolution"], mFieldValues.value("resolution"));
+    details->setReproducibility(detailMap["reproducibility"], mFieldValues.value("reproducibility"));
+    details->setAssigneds(detailMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     dialog->show();
@@ -206,6 +207,7 @@ void
 MantisUI::setupTable()
 {
     SqlBugDelegate *delegate = new SqlBugDelegate();
+    delegate->setTimestampColumn(3);
     ui->tableView->setItemDelegate(delegate);
     ui->tableView->setModel(pBugModel);
     pBugModel->setHeaderData(1, Qt::Horizontal, "");
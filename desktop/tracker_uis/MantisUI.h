@@ -49,6 +49,7 @@ public:
 public slots:
     void reloadFromDatabase();
     void itemDoubleClicked(const QModelIndex &index);
+    void showBugDetails(const QString &rowId);
     void headerContextMenu(const QPoint &pos);
     void sortIndicatorChanged(int logicalIndex, Qt::SortOrder order);
     void loadSearchResult(const QString &id);
@@ -56,8 +57,6 @@ public slots:
 private:
     void setupTable();
     Ui::MantisUI *ui;
-    QStringList mPriorities, mSeverities, mStatuses;
-    QStringList mVersions, mResolutions, mRepro;
 };
 
 #endif // MANTISUI_H
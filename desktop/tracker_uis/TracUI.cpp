@@ -138,12 +138,9 @@ TracUI::headerContextMenu(const QPoint &pos)
 void
 TracUI::loadFields()
 {
-    mSeverities = SqlUtilities::fieldValues(mId, "severity");
-    mPriorities = SqlUtilities::fieldValues(mId, "priority");
-    mStatuses = SqlUtilities::fieldValues(mId, "status");
-    mVersions = SqlUtilities::fieldValues(mId, "version");
-    mComponents = SqlUtilities::fieldValues(mId, "component");
-    mResolutions = SqlUtilities::fieldValues(mId, "resolution");
+    QStringList fields;
+    fields << "severity" << "priority" << "status" << "version" << "component" << "resolution";
+    readFieldValues("trac", fields);
 }
 
 void
@@ -163,14 +160,13 @@ TracUI::searchResultFinished(QMap<QString, QString> resultMap)
             this, SLOT(commentsDialogCanceled(QString,QString)));
     dialog->setBugInfo(resultMap);
     TracDetails *details = new TracDetails(resultMap["bug_id"]);
-    details->setSeverities(resultMap["severity"], mSeverities);
-    details->setPriorities(resultMap["priority"], mPriorities);
-    details->setStatuses(resultMap["status"], mStatuses);
-    details->setVersions(resultMap["version"], mVersions);
-    details->setComponents(resultMap["component"], mComponents);
-    details->setResolutions(resultMap["resolution"], mResolutions);
-    QStringList assignedVals = SqlUtilities::assignedToValues("trac", mId);
-    details->setAssigneds(resultMap["assigned_to"], assignedVals);
+    details->setSeverities(resultMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(resultMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(resultMap["status"], mFieldValues.value("status"));
+    details->setVersions(resultMap["version"], mFieldValues.value("version"));
+    details->setComponents(resultMap["component"], mFieldValues.value("component"));
+    details->setResolutions(resultMap["resolution"], mFieldValues.value("resolution"));
+    details->setAssigneds(resultMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     stopSearchProgress();
@@ -181,7 +177,12 @@ TracUI::searchResultFinished(QMap<QString, QString> resultMap)
 void
 TracUI::itemDoubleClicked(const QModelIndex &index)
 {
-    QString rowId = index.sibling(index.row(), 0).data().toString();
+    showBugDetails(index.sibling(index.row(), 0).data().toString());
+}
+
+void
+TracUI::showBugDetails(const QString &rowId)
+{
     QMap<QString, QString> detailMap = SqlUtilities::tracBugDetail(rowId);
     BugDetailsDialog *dialog = new BugDetailsDialog(pBackend, this);
     connect (dialog, SIGNAL(commentsDialogClosing(QMap<QString,QString>,QString)),
@@ -189,14 +190,13 @@ TracUI::itemDoubleClicked(const QModelIndex &index)
     dialog->setBugInfo(detailMap);
     TracDetails *details = new TracDetails(detailMap["bug_id"]);
 
-    details->setSeverities(detailMap["severity"], mSeverities);
-    details->setPriorities(detailMap["priority"], mPriorities);
-    details->setStatuses(detailMap["status"], mStatuses);
-    details->setVersions(detailMap["version"], mVersions);
-    details->setComponents(detailMap["component"], mComponents);
-    details->setResolutions(detailMap["resolution"], mResolutions);
-    QStringList assignedVals = SqlUtilities::assignedToValues("trac", mId);
-    details->setAssigneds(detailMap["assigned_to"], assignedVals);
+    details->setSeverities(detailMap["severity"], mFieldValues.value("severity"));
+    details->setPriorities(detailMap["priority"], mFieldValues.value("priority"));
+    details->setStatuses(detailMap["status"], mFieldValues.value("status"));
+    details->setVersions(detailMap["version"], mFieldValues.value("version"));
+    details->setComponents(detailMap["component"], mFieldValues.value("component"));
+    details->setResolutions(detailMap["resolution"], mFieldValues.value("resolution"));
+    details->setAssigneds(detailMap["assigned_to"], mFieldValues.value("assigned_to"));
     dialog->setDetailsWidget(details);
     dialog->loadComments();
     dialog->show();
@@ -206,6 +206,7 @@ void
 TracUI::setupTable()
 {
     SqlBugDelegate *delegate = new SqlBugDelegate();
+    delegate->setTimestampColumn(3);
     ui->tableView->setItemDelegate(delegate);
     ui->tableView->setModel(pBugModel);
     pBugModel->setHeaderData(1, Qt::Horizontal, tr(""));
@@ -48,6 +48,7 @@ public:
 public slots:
     void reloadFromDatabase();
     void itemDoubleClicked(const QModelIndex &index);
+    void showBugDetails(const QString &rowId);
     void headerContextMenu(const QPoint &pos);
     void sortIndicatorChanged(int logicalIndex, Qt::SortOrder order);
     void addBugToToDoList(const QString &bugId);
@@ -57,8 +58,6 @@ public slots:
 private:
     void setupTable();
     Ui::TracUI *ui;
-    QStringList mPriorities, mSeverities, mStatuses;
-    QStringList mVersions, mComponents, mResolutions;
 };
 
 #endif // TRACUI_H
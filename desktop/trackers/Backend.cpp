@@ -28,21 +28,32 @@
 #include "Backend.h"
 #include "SqlUtilities.h"
 #include "tracker_uis/BackendUI.h"
-#include "SqlWriterThread.h"
+#include "SqlWriter.h"
+#include "SyncPhaseGraph.h"
 
 Backend::Backend(const QString &url)
     : mUrl(url)
 {
     pDisplayWidget = NULL;
     mUpdateCount = 0;
+    mChangeCount = 0;
     pManager = new QNetworkAccessManager();
     pCookieJar = new QNetworkCookieJar();
     pManager->setCookieJar(pCookieJar);
 
-    pSqlWriter = new SqlWriterThread();
+    pSqlWriter = new SqlWriter();
     connect(pSqlWriter, SIGNAL(failure(QString)),
             this, SIGNAL(backendError(QString)));
-    pSqlWriter->start();
+    // Connected before the subclasses connect bugsInsertionFinished(), so
+    // the count is in by the time they emit bugsUpdated()
+    connect(pSqlWriter, SIGNAL(bugsFinished(QStringList,int)),
+            this, SLOT(countChanges(QStringList,int)));
+
+    pPhases = new SyncPhaseGraph(this);
+    connect(pPhases, SIGNAL(failed(QString)),
+            this, SIGNAL(backendError(QString)));
+    connect(pPhases, SIGNAL(finished()),
+            this, SLOT(phasesFinished()));
 }
 
 Backend::~Backend()
@@ -65,13 +76,98 @@ Backend::setLastSync(const QString &dateTime)
     mLastSync = QDateTime::fromString(dateTime, "yyyy-MM-ddThh:mm:ss");
 }
 
+QVariantMap
+Backend::resumeSync()
+{
+    QString started;
+    QVariantMap saved = SqlUtilities::syncCheckpoints(mId,
+                                                      mLastSync.toString("yyyy-MM-ddThh:mm:ss"),
+                                                      started);
+    mSyncStarted = QDateTime::currentDateTime().toUTC();
+    mCheckpointChunks.clear();
+    if (saved.isEmpty())
+        return saved;
+
+    // Anything that changed while the first attempt was running may have
+    // been missed by the phases it finished, so the next sync has to
+    // start from when it started
+    QDateTime firstStarted = QDateTime::fromString(started, "yyyy-MM-ddThh:mm:ss");
+    if (firstStarted.isValid())
+    {
+        firstStarted.setTimeSpec(Qt::UTC);
+        mSyncStarted = firstStarted;
+    }
+
+    QStringList phases = pPhases->phases();
+    QMapIterator<QString, QVariant> i(saved);
+    while (i.hasNext())
+    {
+        i.next();
+        mCheckpointChunks[i.key()] = i.value().toList().size();
+        if (phases.contains(i.key()))
+            pPhases->restore(i.key());
+    }
+    qDebug() << "Resuming the sync of " << mName << " started at " << started
+             << " with " << saved.keys();
+    return saved;
+}
+
+void
+Backend::checkpoint(const QString &phase,
+                    const QVariant &data)
+{
+    if (!mSyncStarted.isValid())
+        return;
+
+    pSqlWriter->saveCheckpoint(mId,
+                               phase,
+                               0,
+                               mLastSync.toString("yyyy-MM-ddThh:mm:ss"),
+                               mSyncStarted.toString("yyyy-MM-ddThh:mm:ss"),
+                               data);
+}
+
+void
+Backend::appendCheckpoint(const QString &phase,
+                          const QVariant &data)
+{
+    if (!mSyncStarted.isValid())
+        return;
+
+    pSqlWriter->saveCheckpoint(mId,
+                               phase,
+                               mCheckpointChunks[phase]++,
+                               mLastSync.toString("yyyy-MM-ddThh:mm:ss"),
+                               mSyncStarted.toString("yyyy-MM-ddThh:mm:ss"),
+                               data);
+}
+
 void
 Backend::updateSync()
 {
-    mLastSync = QDateTime::currentDateTime().toUTC();
+    if (mSyncStarted.isValid())
+        mLastSync = mSyncStarted;
+    else
+        mLastSync = QDateTime::currentDateTime().toUTC();
+    mSyncStarted = QDateTime();
     pSqlWriter->updateSync(mId.toInt(), mLastSync.toUTC().toString("yyyy-MM-ddThh:mm:ss"));
 }
 
+void
+Backend::countChanges(QStringList idList,
+                      int operation)
+{
+    if (operation != SqlUtilities::BUGS_INSERT_SEARCH)
+        mChangeCount += idList.size();
+}
+
+void
+Backend::syncError(const QString &message)
+{
+    if (!pPhases->abort(message))
+        emit backendError(message);
+}
+
 void
 Backend::saveCredentials()
 {
@@ -35,7 +35,10 @@
 #include <QSqlQuery>
 
 #include "tracker_uis/BackendUI.h"
-#include "SqlWriterThread.h"
+#include "SqlWriter.h"
+
+class SyncPhaseGraph;
+
 class Backend : public QObject
 {
     Q_OBJECT
@@ -111,6 +114,10 @@ public:
     // It's used to pop up the system tray notification.
     int latestUpdateCount() { return mUpdateCount; }
 
+    // How many bugs the syncs since the last call brought back.
+    // SyncScheduler uses it as the tracker's change rate.
+    int takeChangeCount() { int count = mChangeCount; mChangeCount = 0; return count; }
+
     virtual void search(const QString &query) { Q_UNUSED(query); }
 
     virtual void deleteData() {}
@@ -120,6 +127,9 @@ signals:
     void attachmentDownloaded(const QString &filePath);
     void searchResultFinished(QMap<QString, QString> resultMap);
     void bugsUpdated();
+    // sync() or uploadAll() is done.  bugsUpdated() is also emitted
+    // outside of syncs (e.g. for a searched bug), so it can't say that.
+    void syncFinished();
     void commentsCached();
     void versionChecked(const QString &version, const QString &message);
     void componentsFound(QStringList components);
@@ -132,12 +142,36 @@ public slots:
     virtual void bugsInsertionFinished(QStringList idList, int operation) { Q_UNUSED(idList); Q_UNUSED(operation); }
     void sqlError(QString message);
 
+protected slots:
+    // Called once every phase of a sync has finished
+    virtual void phasesFinished() {}
+
+private slots:
+    void countChanges(QStringList idList, int operation);
+
 protected:
+    // Aborts the running sync with message, or reports it as a plain
+    // backend error if there's no sync in progress
+    void syncError(const QString &message);
+
+    // Sync checkpoints, queued through the writer.  resumeSync() is called
+    // once the phases are added and before they're started: it marks the
+    // phases an interrupted sync of the same window got through as done,
+    // and returns the chunks each phase saved, as a QVariantList.
+    // checkpoint() saves a phase's data as its only chunk; appendCheckpoint()
+    // adds another chunk, so a phase can save its progress a page at a time
+    // without rewriting what it saved before.
+    QVariantMap resumeSync();
+    void checkpoint(const QString &phase, const QVariant &data);
+    void appendCheckpoint(const QString &phase, const QVariant &data);
+    // Moves last_sync to when the sync (or the first attempt at it) started
     void updateSync();
     void saveCredentials();
     QString friendlyTime(const QString &time);
     BackendUI *pDisplayWidget;
     QDateTime mLastSync;
+    QDateTime mSyncStarted;
+    QMap<QString, int> mCheckpointChunks;
     QString mId;
     QString mName;
     QString mUrl;
@@ -154,7 +188,9 @@ protected:
     bool mLoggedIn;
     int mPendingCommentInsertions;
     int mUpdateCount;
-    SqlWriterThread *pSqlWriter;
+    int mChangeCount;
+    SqlWriter *pSqlWriter;
+    SyncPhaseGraph *pPhases;
 };
 
 Q_DECLARE_METATYPE(Backend*)
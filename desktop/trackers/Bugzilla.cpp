@@ -32,7 +32,9 @@
 
 #include "Bugzilla.h"
 #include "SqlUtilities.h"
+#include "AttachmentCache.h"
 #include "tracker_uis/BugzillaUI.h"
+#include "SyncPhaseGraph.h"
 
 // Bugzilla is not fun to work with.  This uses a mix of XMLRPC and POST calls:
 // - XMLRPC to login
@@ -77,6 +79,7 @@ Bugzilla::Bugzilla(const QString &url)
 
 Bugzilla::~Bugzilla()
 {
+    qDeleteAll(mAttachmentDownloads);
 }
 
 BackendUI *
@@ -113,9 +116,38 @@ Bugzilla::sync()
     mUpdateCount = 0;
     mState = 0;
     mBugs.clear();
-    SqlUtilities::clearRecentBugs("bugzilla");
+    mPhaseBugs.clear();
+    pSqlWriter->clearRecentBugs("bugzilla", mId);
     mTimezoneOffset = SqlUtilities::getTimezoneOffset(mId);
     qDebug() << "Bugzilla::sync for " << name() << " at " << mLastSync;
+
+    // Once we're logged in and know the user's email address, the four bug
+    // searches don't depend on each other.  They're added in the order
+    // their bug_type should win in, lowest first.
+    QStringList afterEmail("email");
+    pPhases->clear();
+    pPhases->addPhase("login", "syncLogin");
+    pPhases->addPhase("email", "getUserEmail", QStringList("login"));
+    if ((mVersion != "3.2") && (mVersion != "3.4"))
+        pPhases->addPhase("monitored", "getMonitoredBugs", QStringList("login"));
+    pPhases->addPhase("cc", "getCCs", afterEmail);
+    pPhases->addPhase("reported", "getReportedBugs", afterEmail);
+    pPhases->addPhase("assigned", "getUserBugs", afterEmail);
+
+    // The searches an interrupted sync finished don't need to run again
+    QVariantMap saved = resumeSync();
+    QMapIterator<QString, QVariant> i(saved);
+    while (i.hasNext())
+    {
+        i.next();
+        mPhaseBugs[i.key()] = i.value().toList().value(0).toMap();
+    }
+    pPhases->start();
+}
+
+void
+Bugzilla::syncLogin()
+{
     qDebug() << "Logging into " << mUrl + "/xmlrpc.cgi";
     QVariantList args;
     QVariantMap params;
@@ -178,6 +210,7 @@ Bugzilla::uploadAll()
     if (!SqlUtilities::hasPendingChanges("shadow_bugzilla", mId))
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
     qDebug() << "Bugzilla::uploadAll";
@@ -215,7 +248,7 @@ Bugzilla::getUserEmail()
     if (mVersion == "3.2")
     {
         mEmail = mUsername;
-        getCCs();
+        pPhases->finish("email");
     }
     else
     {
@@ -319,12 +352,10 @@ Bugzilla::getReportedBugs()
 void
 Bugzilla::getMonitoredBugs()
 {
-    mBugs.clear();
     if (mMonitorComponents.isEmpty())
     {
         qDebug() << "There are no components to monitor.";
-        QVariant empty = QVariant();
-        monitoredBugResponse(empty);
+        pPhases->finish("monitored");
         return;
     }
 
@@ -527,10 +558,21 @@ Bugzilla::downloadAttachment(int rowId,
                              const QString &path)
 {
     QMap<QString, QString> attachment = SqlUtilities::attachmentDetails(rowId);
+    AttachmentCache *cache = new AttachmentCache(mId, attachment);
+    if (!cache->open())
+    {
+        delete cache;
+        emit attachmentDownloaded("");
+        return;
+    }
+
     QString url = mUrl + "/attachment.cgi?id=" + attachment["attachment_id"];
     QNetworkRequest req = QNetworkRequest(QUrl(url));
     req.setAttribute(QNetworkRequest::User, QVariant(path));
     QNetworkReply *rep = pManager->get(req);
+    mAttachmentDownloads[rep] = cache;
+    connect(rep, SIGNAL(readyRead()),
+            this, SLOT(attachmentReadyRead()));
     connect(rep, SIGNAL(finished()),
             this, SLOT(attachmentDownloadFinished()));
 }
@@ -677,7 +719,7 @@ Bugzilla::rpcError(int error, const QString &message)
 {
     qDebug() << "Bugzilla::rpcError: " << message;
     QString e = QString("Error %1: %2").arg(error).arg(message);
-    emit backendError(e);
+    syncError(e);
 }
 
 void
@@ -757,39 +799,24 @@ void Bugzilla::loginSyncRpcResponse(QVariant &arg)
     if (mState == BUGZILLA_STATE_UPLOADING)
         doUploading();
     else
-        getUserEmail();
+        pPhases->finish("login");
 }
 
 void Bugzilla::emailRpcResponse(QVariant &arg)
 {
     QVariantMap userMap = arg.toMap();
-    if (userMap.isEmpty())
+    QVariantList userList = userMap.value("users").toList();
+    if (userList.isEmpty())
     {
         qDebug() << "usermap is empty!";
         mEmail = mUsername;
-        if (mVersion == "3.4")
-            getCCs();
-        else
-            getMonitoredBugs();
-        return;
     }
-
-    QVariantList userList = userMap.value("users").toList();
-    if (userList.isEmpty())
+    else
     {
-        mEmail = mUsername;
-        if (mVersion == "3.4")
-            getCCs();
-        else
-            getMonitoredBugs();
-        return;
+        mEmail = userList.at(0).toMap().value("email").toString();
     }
 
-    mEmail = userList.at(0).toMap().value("email").toString();
-    if (mVersion == "3.4")
-        getCCs();
-    else
-        getMonitoredBugs();
+    pPhases->finish("email");
 }
 
 void Bugzilla::reportedRpcResponse(QVariant &arg)
@@ -800,75 +827,84 @@ void Bugzilla::reportedRpcResponse(QVariant &arg)
     {
         QVariantMap responseMap = bugList.at(i).toMap();
         responseMap["bug_type"] = "Reported";
-        mBugs[responseMap.value("id").toString()] = responseMap;
+        mPhaseBugs["reported"][responseMap.value("id").toString()] = responseMap;
     }
-    getUserBugs();
+    finishSearch("reported");
 }
 
 void
 Bugzilla::monitoredBugResponse(QVariant &arg)
 {
-    if (arg.isNull())
-    {
-        qDebug() << "Empty monitoredBugResponse argument";
-        getCCs();
-        return;
-    }
-
     qDebug() << "Monitored Bugs:";
     QVariantList bugList = arg.toMap().value("bugs").toList();
     for (int i = 0; i < bugList.size(); ++i)
     {
         QVariantMap responseMap = bugList.at(i).toMap();
         responseMap["bug_type"] = "Monitored";
-        mBugs[responseMap.value("id").toString()] = responseMap;
+        mPhaseBugs["monitored"][responseMap.value("id").toString()] = responseMap;
     }
 
-    getCCs();
+    finishSearch("monitored");
 }
 
 void Bugzilla::bugRpcResponse(QVariant &arg)
 {
     QVariantList bugList = arg.toMap().value("bugs").toList();
-    QVariantMap responseMap;
     for (int i = 0; i < bugList.size(); ++i)
     {
-        responseMap = bugList.at(i).toMap();
+        QVariantMap responseMap = bugList.at(i).toMap();
         responseMap["bug_type"] = "Assigned";
-        mBugs[responseMap.value("id").toString()] = responseMap;
+        mPhaseBugs["assigned"][responseMap.value("id").toString()] = responseMap;
+    }
+
+    finishSearch("assigned");
+}
+
+// Saves a search's bugs so that an interrupted sync can skip it next time
+void
+Bugzilla::finishSearch(const QString &phase)
+{
+    checkpoint(phase, mPhaseBugs.value(phase));
+    pPhases->finish(phase);
+}
+
+// Every search is in, so merge them (later phases win the bug_type) and
+// write the lot out in one go
+void
+Bugzilla::phasesFinished()
+{
+    QStringList phases = pPhases->phases();
+    for (int p = 0; p < phases.size(); ++p)
+    {
+        QMapIterator<QString, QVariant> bugs(mPhaseBugs.value(phases.at(p)));
+        while (bugs.hasNext())
+        {
+            bugs.next();
+            mBugs[bugs.key()] = bugs.value();
+        }
+    }
+    mPhaseBugs.clear();
+
+    if (mVersion == "3.2")
+    {
+        insertCsvBugs();
+        return;
     }
 
     QMapIterator<QString, QVariant> i(mBugs);
-    QList< QMap<QString,QString> > insertList;
+    QVariantMap responseMap;
+    SqlRecordBatch insertBatch;
 
     while (i.hasNext())
     {
         i.next();
         responseMap = i.value().toMap();
-        QMap<QString, QString> newBug;
-        newBug["tracker_id"] = mId;
-        newBug["bug_id"] = responseMap.value("id").toString();
-        newBug["severity"] = responseMap.value("severity").toString();
-        newBug["priority"] = responseMap.value("priority").toString();
-        newBug["assigned_to"] = responseMap.value("assigned_to").toString();
-        newBug["status"] = responseMap.value("status").toString();
-        newBug["summary"] = responseMap.value("summary").toString();
-        newBug["component"] = responseMap.value("component").toString();
-        newBug["product"] = responseMap.value("product").toString();
-        newBug["bug_type"] = responseMap.value("bug_type").toString();
-        newBug["description"] = responseMap.value("description").toString();
-        if (mLastSync.date().year() != 1970)
-            newBug["highlight_type"] = QString::number(SqlUtilities::HIGHLIGHT_RECENT);
-
-        if (responseMap.value("resolution").toString() != "")
-            newBug["bug_state"] = "closed";
-        else
-            newBug["bug_state"] = "open";
-
-        if ((newBug["status"].toUpper() == "RESOLVED")
-            ||(newBug["status"].toUpper() == "CLOSED"))
+        QString bugId = responseMap.value("id").toString();
+        QString status = responseMap.value("status").toString();
+        if ((status.toUpper() == "RESOLVED")
+            ||(status.toUpper() == "CLOSED"))
         {
-            SqlUtilities::removeShadowBug("bugzilla", newBug["bug_id"], mId);
+            SqlUtilities::removeShadowBug("bugzilla", bugId, mId);
             continue;
         }
         else
@@ -876,13 +912,33 @@ void Bugzilla::bugRpcResponse(QVariant &arg)
             mUpdateCount++;
         }
 
+        insertBatch.appendRow();
+        insertBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+        insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, bugId);
+        insertBatch.setValue(SqlRecordBatch::COLUMN_SEVERITY, responseMap.value("severity").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_PRIORITY, responseMap.value("priority").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_ASSIGNED_TO, responseMap.value("assigned_to").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_STATUS, status);
+        insertBatch.setValue(SqlRecordBatch::COLUMN_SUMMARY, responseMap.value("summary").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_COMPONENT, responseMap.value("component").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_PRODUCT, responseMap.value("product").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_TYPE, responseMap.value("bug_type").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_DESCRIPTION, responseMap.value("description").toString());
+        if (mLastSync.date().year() != 1970)
+            insertBatch.setValue(SqlRecordBatch::COLUMN_HIGHLIGHT_TYPE, SqlUtilities::HIGHLIGHT_RECENT);
+
+        if (responseMap.value("resolution").toString() != "")
+            insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_STATE, "closed");
+        else
+            insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_STATE, "open");
+
         // Bugs from RPC come in in ISO format (YYYY-MM-DDTHH:MM:SS) so convert
         // to an easier to read format
-        newBug["last_modified"] = friendlyTime(responseMap.value("last_change_time").toString());
-        insertList << newBug;
+        insertBatch.setValue(SqlRecordBatch::COLUMN_LAST_MODIFIED,
+                             friendlyTime(responseMap.value("last_change_time").toString()));
     }
 
-    pSqlWriter->insertBugs("bugzilla", insertList);
+    pSqlWriter->insertBugs("bugzilla", insertBatch);
 }
 
 void
@@ -934,7 +990,7 @@ void Bugzilla::commentRpcResponse(QVariant &arg)
     QVariantMap commentHash = arg.toMap().value("bugs").toMap();
     QVariantList commentList;
     QVariantMap comment;
-    QList<QMap<QString, QString> > commentInsertionList;
+    SqlRecordBatch commentBatch;
 
     QMapIterator<QString, QVariant> j(commentHash);
     while (j.hasNext())
@@ -958,19 +1014,18 @@ void Bugzilla::commentRpcResponse(QVariant &arg)
         while (c.hasNext())
         {
             comment = c.next().toMap();
-            QMap<QString, QString> newComment;
-            newComment["tracker_id"] = mId;
-            newComment["bug_id"] = j.key();
-            newComment["comment_id"] = comment.value("id").toString();
-            newComment["author"] = comment.value("author").toString();
-            newComment["comment"] = comment.value("text").toString();
-            newComment["timestamp"] = comment.value("time").toDateTime().toString("yyyy-MM-ddThh:mm:ss");
-            newComment["private"] = comment.value("is_private").toInt();
-            commentInsertionList << newComment;
+            commentBatch.appendRow();
+            commentBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, j.key());
+            commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT_ID, comment.value("id").toString());
+            commentBatch.setValue(SqlRecordBatch::COLUMN_AUTHOR, comment.value("author").toString());
+            commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT, comment.value("text").toString());
+            commentBatch.setValue(SqlRecordBatch::COLUMN_TIMESTAMP, comment.value("time").toDateTime().toString("yyyy-MM-ddThh:mm:ss"));
+            commentBatch.setValue(SqlRecordBatch::COLUMN_PRIVATE, comment.value("is_private").toInt());
         }
     }
 
-    pSqlWriter->insertBugComments(commentInsertionList);
+    pSqlWriter->insertBugComments(commentBatch);
 }
 
 void
@@ -1157,15 +1212,15 @@ Bugzilla::reportedBugListFinished()
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     if (reply->error())
     {
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
         return;
     }
     qDebug() << "reportedBugListFinished";
     QString csv = QString::fromUtf8(reply->readAll());
-    parseBuglistCSV(csv, "Reported");
+    parseBuglistCSV(csv, "Reported", mPhaseBugs["reported"]);
     reply->close();
-    getUserBugs();
+    finishSearch("reported");
 }
 
 void
@@ -1193,7 +1248,7 @@ Bugzilla::searchCallFinished()
     }
 
     QString csv = QString::fromUtf8(reply->readAll());
-    parseBuglistCSV(csv, "Searched");
+    parseBuglistCSV(csv, "Searched", mBugs);
     reply->close();
 
     QList< QMap<QString,QString> > insertList;
@@ -1231,15 +1286,20 @@ Bugzilla::userBugListFinished()
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     if (reply->error())
     {
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
 
         return;
     }
     QString csv = QString::fromUtf8(reply->readAll());
-    parseBuglistCSV(csv, "Assigned");
+    parseBuglistCSV(csv, "Assigned", mPhaseBugs["assigned"]);
     reply->close();
+    finishSearch("assigned");
+}
 
+void
+Bugzilla::insertCsvBugs()
+{
     QList< QMap<QString,QString> > insertList;
     QVariantMap responseMap;
     QMapIterator<QString, QVariant> i(mBugs);
@@ -1258,7 +1318,9 @@ Bugzilla::userBugListFinished()
         newBug["component"] = responseMap.value("component").toString();
         newBug["product"] = responseMap.value("product").toString();
         newBug["bug_type"] = responseMap.value("bug_type").toString();
-        newBug["last_modified"] = responseMap.value("last_change_time").toString();
+        // buglist.cgi gives changeddate in the server's time
+        newBug["last_modified"] = SqlUtilities::toEpoch(responseMap.value("last_change_time"),
+                                                        mTimezoneOffset).toString();
         if (mLastSync.date().year() != 1970)
             newBug["highlight_type"] = QString::number(SqlUtilities::HIGHLIGHT_RECENT);
 
@@ -1289,6 +1351,7 @@ Bugzilla::bugsInsertionFinished(QStringList idList, int operation)
         qDebug() << "Updating sync...";
         updateSync();
         emit bugsUpdated();
+        emit syncFinished();
     }
 
 }
@@ -1302,7 +1365,7 @@ Bugzilla::ccFinished()
     QVariant redirect = reply->attribute(QNetworkRequest::RedirectionTargetAttribute);
     if (reply->error())
     {
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
         return;
     }
@@ -1319,15 +1382,16 @@ Bugzilla::ccFinished()
     }
 
     QString csv = QString::fromUtf8(reply->readAll());
-    parseBuglistCSV(csv, "CC");
+    parseBuglistCSV(csv, "CC", mPhaseBugs["cc"]);
     reply->close();
-    getReportedBugs();
+    finishSearch("cc");
 }
 
 // Parse buglist.cgi?ctype=csv output and convert to a map
 void
 Bugzilla::parseBuglistCSV(const QString &csv,
-                          const QString &bugType)
+                          const QString &bugType,
+                          QVariantMap &bugs)
 {
     QString entry;
     QRegExp reg("^\"|\"$");
@@ -1354,7 +1418,7 @@ Bugzilla::parseBuglistCSV(const QString &csv,
          entry = list.at(i).section(',', 8);
          newBug["summary"] = entry.remove(reg);
          newBug["bug_type"] = bugType;
-         mBugs[bug.at(0)] = newBug;
+         bugs[bug.at(0)] = newBug;
     }
 }
 
@@ -1448,13 +1512,33 @@ Bugzilla::itemPostFinished()
     reply->close();
 }
 
+// Each chunk goes straight to disk, so large attachments don't pile up
+// in the reply's buffer
+void
+Bugzilla::attachmentReadyRead()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
+    AttachmentCache *cache = mAttachmentDownloads.value(reply);
+    if (cache == NULL)
+        return;
+
+    if (!cache->write(reply->readAll()))
+    {
+        mAttachmentDownloads.remove(reply);
+        delete cache;
+        reply->abort();
+    }
+}
+
 void
 Bugzilla::attachmentDownloadFinished()
 {
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
-    if (reply->error())
+    AttachmentCache *cache = mAttachmentDownloads.take(reply);
+    if (reply->error() || (cache == NULL))
     {
         qDebug() << "Bugzilla::attachmentDownloadFinished error: " << reply->errorString();
+        delete cache;
         emit attachmentDownloaded("");
         reply->close();
         reply->deleteLater();
@@ -1462,19 +1546,20 @@ Bugzilla::attachmentDownloadFinished()
     }
 
     QString filepath = reply->request().attribute(QNetworkRequest::User).toString();
-    QByteArray data = reply->readAll();
+    bool ok = cache->write(reply->readAll());
     reply->close();
     reply->deleteLater();
 
-    QFile file(filepath);
-    if (!file.open(QFile::WriteOnly|QFile::Truncate))
+    QString cachedPath;
+    if (ok)
+        cachedPath = cache->commit();
+    delete cache;
+    if (cachedPath.isEmpty() || !AttachmentCache::copyTo(cachedPath, filepath))
     {
-        qDebug() << "Bugzilla::attachmentDownloadFinished error: " << file.errorString();
         emit attachmentDownloaded("");
+        return;
     }
 
-    file.write(data);
-    file.close();
     emit attachmentDownloaded(filepath);
 }
 
@@ -29,6 +29,7 @@
 
 class QNetworkReply;
 class QSslError;
+class AttachmentCache;
 
 class Bugzilla : public Backend
 {
@@ -88,6 +89,7 @@ public slots:
     void ccFinished();
     void commentInsertionFinished();
     void bugsInsertionFinished(QStringList idList, int operation);
+    void attachmentReadyRead();
     void attachmentDownloadFinished();
     void commentXMLFinished();
     void reportedBugListFinished();
@@ -116,6 +118,17 @@ public slots:
     void statusResponse(QVariant &arg);
     void handleSslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
 
+    // Sync phases
+    void syncLogin();
+    void getUserEmail();
+    void getMonitoredBugs();
+    void getCCs();
+    void getReportedBugs();
+    void getUserBugs();
+
+protected slots:
+    void phasesFinished();
+
 protected:
     MaiaXmlRpcClient *pClient;
     void postNewItems(QMap<QString, QString> tokenMap);
@@ -123,22 +136,23 @@ protected:
     void postComments();
     void postComment();
     void doUploading();
-    void getMonitoredBugs();
-    void parseBuglistCSV(const QString &csv, const QString &bugType);
+    void insertCsvBugs();
+    void finishSearch(const QString &phase);
+    void parseBuglistCSV(const QString &csv, const QString &bugType, QVariantMap &bugs);
     QVariantMap mProductMap;
     QString mCurrentProduct;
     QString mCurrentCommentBug;
     QVariantMap mBugs;
+    // Each sync phase's bugs, kept apart until they're merged
+    QMap<QString, QVariantMap> mPhaseBugs;
     QString mBugzillaId;
     QList< QMap<QString, QString> > mPostQueue;
     QList< QMap<QString, QString> > mCommentQueue;
     QString mActiveCommentId;
+    // Attachment downloads in progress, written to the cache as they arrive
+    QMap<QNetworkReply *, AttachmentCache *> mAttachmentDownloads;
     int mState;
     int mTimezoneOffset;
-    void getUserEmail();
-    void getUserBugs();
-    void getReportedBugs();
-    void getCCs();
 };
 
 #endif // BUGZILLA_H
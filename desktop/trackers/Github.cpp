@@ -125,6 +125,7 @@ Github::bugListFinished()
         }
     }
     emit bugsUpdated();
+    emit syncFinished();
 }
 
 void
@@ -154,7 +155,7 @@ Github::checkValidStatuses()
 void
 Github::uploadAll()
 {
-
+    emit syncFinished();
 }
 
 QString
@@ -213,6 +213,7 @@ Google::bugsFinished()
     reply->close();
 
     emit bugsUpdated();
+    emit syncFinished();
 }
 
 void
@@ -242,7 +243,7 @@ Google::checkValidStatuses()
 void
 Google::uploadAll()
 {
-
+    emit syncFinished();
 }
 
 QString
@@ -456,11 +456,13 @@ Launchpad::uploadAll()
 // Qt < 4.7 don't allow us to make an HTTP PATCH call
 #if QT_VERSION < 0x040700
     emit bugsUpdated();
+    emit syncFinished();
     return;
 #endif
     if (!hasPendingChanges())
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
     qDebug() << mLastSync.toString("yyyy-MM-ddThh:mm:ss");
@@ -556,6 +558,7 @@ Launchpad::getNextCommentUpload()
     if (mCommentUploadList.size() == 0)
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
 
@@ -573,6 +576,7 @@ Launchpad::getNextCommentUpload()
     if (q.value(0).isNull())
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
 
@@ -750,6 +754,7 @@ Launchpad::bugsInsertionFinished(QStringList idList)
 {
     updateSync();
     emit bugsUpdated();
+    emit syncFinished();
 }
 
 void
@@ -25,8 +25,10 @@
 #include <QVariantMap>
 #include "Mantis.h"
 #include "SqlUtilities.h"
+#include "AttachmentCache.h"
 #include "tracker_uis/MantisUI.h"
 #include "Translator.h"
+#include "SyncPhaseGraph.h"
 
 // The Mantis SOAP API for 1.1 and 1.2 doesn't allow us to safely
 // list all bugs, so we use the API to get the version and the
@@ -85,7 +87,9 @@ Mantis::downloadAttachment(int rowId, const QString &path)
 {
     QMap<QString, QString> attachment = SqlUtilities::attachmentDetails(rowId);
     QtSoapHttpTransport *attachmentTransport = new QtSoapHttpTransport(this);
-    attachmentTransport->setUserAttribute(path);
+    QVariantList userAttribute;
+    userAttribute << path << rowId;
+    attachmentTransport->setUserAttribute(userAttribute);
     bool secure = true;
     if (QUrl(mUrl).scheme() == "http")
         secure = false;
@@ -107,6 +111,22 @@ void
 Mantis::sync()
 {
     mBugs.clear();
+
+    // view_all_set.php stores the filter in the session, and csv_export.php
+    // exports whatever the session's filter is, so these can't overlap.
+    // Later phases win the bug_type.
+    pPhases->clear();
+    pPhases->addPhase("login", "syncLogin");
+    pPhases->addPhase("monitored", "syncMonitored", QStringList("login"));
+    pPhases->addPhase("cc", "syncCC", QStringList("monitored"));
+    pPhases->addPhase("reported", "syncReported", QStringList("cc"));
+    pPhases->addPhase("assigned", "syncAssigned", QStringList("reported"));
+    pPhases->start();
+}
+
+void
+Mantis::syncLogin()
+{
     QString url = mUrl + "/login.php";
     QString query = QString("username=%1&password=%2&").arg(mUsername).arg(mPassword);
     QNetworkRequest req = QNetworkRequest(QUrl(url));
@@ -147,8 +167,7 @@ Mantis::setView(const QString &search)
     {
         if (mMonitorComponents.isEmpty())
         {
-            mViewType = CC;
-            setView();
+            pPhases->finish("monitored");
             return;
         }
         QString componentQuery;
@@ -187,6 +206,34 @@ Mantis::setView(const QString &search)
             this, SLOT(viewResponse()));
 }
 
+void
+Mantis::syncMonitored()
+{
+    mViewType = MONITORED;
+    setView();
+}
+
+void
+Mantis::syncCC()
+{
+    mViewType = CC;
+    setView();
+}
+
+void
+Mantis::syncReported()
+{
+    mViewType = REPORTED;
+    setView();
+}
+
+void
+Mantis::syncAssigned()
+{
+    mViewType = ASSIGNED;
+    setView();
+}
+
 void
 Mantis::getAssigned()
 {
@@ -735,7 +782,6 @@ Mantis::response()
         else
         {
             int i;
-            QList<QMap<QString, QString> > list;
             QString bugId = resp.returnValue()["id"].toString();
             QtSoapArray &array = (QtSoapArray &) resp.returnValue()["notes"];
             QtSoapArray &attachmentArray = (QtSoapArray &) resp.returnValue()["attachments"];
@@ -766,22 +812,23 @@ Mantis::response()
             }
 
             // Finally, the comments
+            SqlRecordBatch commentBatch;
             for (i = 0; i < array.count(); ++i)
             {
-                QMap<QString, QString> newComment;
                 QtSoapType &note = array.at(i);
-                newComment["tracker_id"] = mId;
-                newComment["bug_id"] = bugId;
-                newComment["author"] = note["reporter"]["name"].toString();
-                newComment["comment_id"] = note["id"].toString();
-                newComment["comment"] = note["text"].toString();
-                newComment["timestamp"] = note["last_modified"].toString();
-                newComment["private"] = "0";
+                commentBatch.appendRow();
+                commentBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+                commentBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, bugId);
+                commentBatch.setValue(SqlRecordBatch::COLUMN_AUTHOR, note["reporter"]["name"].toString());
+                commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT_ID, note["id"].toString());
+                commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT, note["text"].toString());
+                commentBatch.setValue(SqlRecordBatch::COLUMN_TIMESTAMP, note["last_modified"].toString());
                 if (note["view_state"]["name"].toString() == "private")
-                    newComment["private"] = "1";
-                list << newComment;
+                    commentBatch.setValue(SqlRecordBatch::COLUMN_PRIVATE, 1);
+                else
+                    commentBatch.setValue(SqlRecordBatch::COLUMN_PRIVATE, 0);
             }
-            pSqlWriter->insertBugComments(list);
+            pSqlWriter->insertBugComments(commentBatch);
         }
     }
     else if (messageName == "mc_issue_updateResponse")
@@ -843,7 +890,8 @@ void
 Mantis::attachmentDownloadFinished()
 {
     QtSoapHttpTransport *transport = qobject_cast<QtSoapHttpTransport*>(sender());
-    QString filePath = transport->userAttribute().toString();
+    QVariantList userAttribute = transport->userAttribute().toList();
+    QString filePath = userAttribute.value(0).toString();
     if (filePath.isEmpty())
     {
         qDebug() << "Mantis::attachmentDownloadFinished: Uh oh, filepath is empty!";
@@ -868,16 +916,17 @@ Mantis::attachmentDownloadFinished()
 
     if (messageName == "mc_issue_attachment_getResponse")
     {
-        QByteArray data = QByteArray::fromBase64(response.toString().toLocal8Bit());
-        QFile file(filePath);
-        if (!file.open(QFile::WriteOnly|QFile::Truncate))
-        {
-            qDebug() << "Mantis::attachmentDownloadFinished error: " << file.errorString();
+        QMap<QString, QString> attachment = SqlUtilities::attachmentDetails(userAttribute.value(1).toInt());
+        AttachmentCache cache(mId, attachment);
+        QString cachedPath;
+        if (cache.open()
+            && cache.write(QByteArray::fromBase64(response.toString().toLocal8Bit())))
+            cachedPath = cache.commit();
+
+        if (cachedPath.isEmpty() || !AttachmentCache::copyTo(cachedPath, filePath))
             emit attachmentDownloaded("");
-        }
-        file.write(data);
-        file.close();
-        emit attachmentDownloaded(filePath);
+        else
+            emit attachmentDownloaded(filePath);
     }
     else
     {
@@ -928,7 +977,7 @@ Mantis::searchedBugResponse()
         params["highlight_type"] = QString::number(SqlUtilities::HIGHLIGHT_SEARCH);
         params["last_modified"] = response["last_updated"].toString();
         list << params;
-        pSqlWriter->multiInsert("mantis", list);
+        pSqlWriter->insertBugs("mantis", list, "-1", SqlUtilities::BUGS_INSERT_SEARCH);
         emit searchResultFinished(params);
     }
     transport->deleteLater();
@@ -1091,6 +1140,7 @@ Mantis::uploadAll()
     {
         qDebug() << "No pending changes";
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
 
@@ -1138,6 +1188,7 @@ Mantis::uploadAll()
     if ((mCommentUploadList.size() == 0) && (mUploadList.size() == 0))
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
 
@@ -1234,13 +1285,12 @@ void Mantis::loginSyncResponse()
     if (reply->error())
     {
         qDebug() << "loginSyncResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
         return;
     }
     reply->deleteLater();
-    mViewType = MONITORED;
-    setView();
+    pPhases->finish("login");
 }
 
 void Mantis::viewResponse()
@@ -1250,7 +1300,7 @@ void Mantis::viewResponse()
     if (reply->error())
     {
         qDebug() << "viewResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
 
         return;
@@ -1276,7 +1326,7 @@ void Mantis::assignedResponse()
     if (reply->error())
     {
         qDebug() << "assignedResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
 
         return;
@@ -1284,35 +1334,38 @@ void Mantis::assignedResponse()
     QString rep = QString::fromUtf8(reply->readAll());
     reply->deleteLater();
     handleCSV(QString(rep), "Assigned");
+    pPhases->finish("assigned");
+}
 
-    QList< QMap<QString,QString> > insertList;
+void
+Mantis::phasesFinished()
+{
+    SqlRecordBatch insertBatch;
     QVariantMap responseMap;
     QMapIterator<QString, QVariant> i(mBugs);
     while (i.hasNext())
     {
         i.next();
         responseMap = i.value().toMap();
-        QMap<QString, QString> newBug;
-        newBug["tracker_id"] = mId;
-        newBug["bug_id"] = responseMap.value("id").toString();
-        newBug["severity"] = responseMap.value("severity").toString();
-        newBug["priority"] = responseMap.value("priority").toString();
-        newBug["project"] = responseMap.value("project").toString();
-        newBug["category"] = responseMap.value("category").toString();
-        newBug["reproducibility"] = responseMap.value("reproducibility").toString();
-        newBug["os"] = responseMap.value("os").toString();
-        newBug["os_version"] = responseMap.value("os_version").toString();
-        newBug["assigned_to"] = responseMap.value("assigned_to").toString();
-        newBug["status"] = responseMap.value("status").toString();
-        newBug["summary"] = responseMap.value("summary").toString();
-        newBug["product_version"] = responseMap.value("product_version").toString();
-        newBug["bug_type"] = responseMap.value("bug_type").toString();
-        newBug["last_modified"] = responseMap.value("last_modified").toString();
-
-        insertList << newBug;
+        insertBatch.appendRow();
+        insertBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+        insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, responseMap.value("id").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_SEVERITY, responseMap.value("severity").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_PRIORITY, responseMap.value("priority").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_PROJECT, responseMap.value("project").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_CATEGORY, responseMap.value("category").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_REPRODUCIBILITY, responseMap.value("reproducibility").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_OS, responseMap.value("os").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_OS_VERSION, responseMap.value("os_version").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_ASSIGNED_TO, responseMap.value("assigned_to").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_STATUS, responseMap.value("status").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_SUMMARY, responseMap.value("summary").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_PRODUCT_VERSION, responseMap.value("product_version").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_TYPE, responseMap.value("bug_type").toString());
+        insertBatch.setValue(SqlRecordBatch::COLUMN_LAST_MODIFIED, responseMap.value("last_modified").toString());
     }
 
-    pSqlWriter->insertBugs("mantis", insertList, mId);
+    pSqlWriter->insertBugs("mantis", insertBatch, mId);
 }
 
 void Mantis::reportedResponse()
@@ -1321,7 +1374,7 @@ void Mantis::reportedResponse()
     if (reply->error())
     {
         qDebug() << "reportedResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
 
         return;
@@ -1330,8 +1383,7 @@ void Mantis::reportedResponse()
     QString rep = QString::fromUtf8(reply->readAll());
     reply->deleteLater();
     handleCSV(rep, "Reported");
-    mViewType = ASSIGNED;
-    setView();
+    pPhases->finish("reported");
 }
 
 void Mantis::monitoredResponse()
@@ -1340,7 +1392,7 @@ void Mantis::monitoredResponse()
     if (reply->error())
     {
         qDebug() << "monitoredResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
         return;
     }
@@ -1348,8 +1400,7 @@ void Mantis::monitoredResponse()
     QString rep = QString::fromUtf8(reply->readAll());
     reply->deleteLater();
     handleCSV(rep, "Monitored");
-    mViewType = CC;
-    setView();
+    pPhases->finish("monitored");
 }
 void Mantis::ccResponse()
 {
@@ -1357,7 +1408,7 @@ void Mantis::ccResponse()
     if (reply->error())
     {
         qDebug() << "ccResponse error: " << reply->errorString();
-        emit backendError(reply->errorString());
+        syncError(reply->errorString());
         reply->close();
 
         return;
@@ -1366,8 +1417,7 @@ void Mantis::ccResponse()
     QString rep = QString::fromUtf8(reply->readAll());
     reply->deleteLater();
     handleCSV(rep, "CC");
-    mViewType = REPORTED;
-    setView();
+    pPhases->finish("cc");
 }
 
 void
@@ -1419,6 +1469,7 @@ Mantis::bugsInsertionFinished(QStringList idList, int operation)
     {
         updateSync();
         emit bugsUpdated();
+        emit syncFinished();
     }
 }
 
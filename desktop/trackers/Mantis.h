@@ -58,6 +58,16 @@ public slots:
     void commentInsertionFinished();
     void attachmentDownloadFinished();
 
+    // Sync phases
+    void syncLogin();
+    void syncMonitored();
+    void syncCC();
+    void syncReported();
+    void syncAssigned();
+
+protected slots:
+    void phasesFinished();
+
 private:
     enum viewType {
         ASSIGNED = 0,
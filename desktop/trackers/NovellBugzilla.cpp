@@ -58,7 +58,7 @@ NovellBugzilla::sync()
     QNetworkRequest request = QNetworkRequest(QUrl(ichainLogin));
     QNetworkReply *reply = pManager->post(request, username);
     connect(reply, SIGNAL(finished()),
-            this, SLOT(syncFinished()));
+            this, SLOT(syncLoginFinished()));
 }
 
 void
@@ -128,9 +128,9 @@ NovellBugzilla::finished()
 }
 
 void
-NovellBugzilla::syncFinished()
+NovellBugzilla::syncLoginFinished()
 {
-    qDebug() << "NovellBugzilla::syncFinished";
+    qDebug() << "NovellBugzilla::syncLoginFinished";
     QNetworkReply *reply = qobject_cast<QNetworkReply*>(sender());
     if (reply->error())
     {
@@ -43,7 +43,8 @@ public:
     void getComments(const QString &bugId);
 public slots:
     void finished();
-    void syncFinished();
+    // The ichain login for a sync is done
+    void syncLoginFinished();
 
 private:
     int state;
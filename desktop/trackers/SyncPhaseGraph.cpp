@@ -0,0 +1,176 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QMetaObject>
+#include <QDebug>
+
+#include "SyncPhaseGraph.h"
+
+SyncPhaseGraph::SyncPhaseGraph(QObject *target) :
+    QObject(target)
+{
+    pTarget = target;
+    mRunning = false;
+}
+
+void
+SyncPhaseGraph::clear()
+{
+    mOrder.clear();
+    mPhases.clear();
+    mRunning = false;
+}
+
+void
+SyncPhaseGraph::addPhase(const QString &name,
+                         const char *slot,
+                         const QStringList &after)
+{
+    Phase phase;
+    phase.slot = slot;
+    phase.after = after;
+    phase.state = WAITING;
+    phase.elapsed = 0;
+    mOrder.append(name);
+    mPhases.insert(name, phase);
+}
+
+void
+SyncPhaseGraph::restore(const QString &name)
+{
+    if (!mPhases.contains(name))
+        return;
+
+    qDebug() << "SyncPhaseGraph: " << name << " restored from a checkpoint";
+    mPhases[name].state = DONE;
+}
+
+void
+SyncPhaseGraph::start()
+{
+    for (int i = 0; i < mOrder.size(); ++i)
+    {
+        const Phase &phase = mPhases[mOrder.at(i)];
+        for (int j = 0; j < phase.after.size(); ++j)
+        {
+            if (!mPhases.contains(phase.after.at(j)))
+            {
+                qDebug() << "SyncPhaseGraph: " << mOrder.at(i) << " waits for unknown phase " << phase.after.at(j);
+                mRunning = true;
+                abort(QString("Internal error: sync phase %1 can never start").arg(mOrder.at(i)));
+                return;
+            }
+        }
+    }
+
+    mRunning = true;
+    mTimer.start();
+    startReady();
+}
+
+void
+SyncPhaseGraph::finish(const QString &name)
+{
+    // Late responses from a sync that's already been aborted
+    if (!mRunning || !mPhases.contains(name))
+        return;
+
+    Phase &phase = mPhases[name];
+    if (phase.state != RUNNING)
+        return;
+
+    phase.state = DONE;
+    phase.elapsed = phase.timer.elapsed();
+    qDebug() << "SyncPhaseGraph: " << name << " finished in " << phase.elapsed << "ms";
+    startReady();
+}
+
+bool
+SyncPhaseGraph::abort(const QString &message)
+{
+    if (!mRunning)
+        return false;
+
+    mRunning = false;
+    qDebug() << "SyncPhaseGraph: aborted after " << mTimer.elapsed() << "ms: " << message;
+    emit failed(message);
+    return true;
+}
+
+// Phases are started through the event loop, so a phase that finishes
+// straight away doesn't re-enter this loop
+void
+SyncPhaseGraph::startReady()
+{
+    bool busy = false;
+    bool running = false;
+    for (int i = 0; i < mOrder.size(); ++i)
+    {
+        Phase &phase = mPhases[mOrder.at(i)];
+        if (phase.state != DONE)
+            busy = true;
+        if (phase.state == WAITING)
+        {
+            bool ready = true;
+            for (int j = 0; j < phase.after.size(); ++j)
+            {
+                if (mPhases.value(phase.after.at(j)).state != DONE)
+                    ready = false;
+            }
+
+            if (!ready)
+                continue;
+
+            phase.state = RUNNING;
+            phase.timer.start();
+            QMetaObject::invokeMethod(pTarget, phase.slot.constData(), Qt::QueuedConnection);
+        }
+
+        if (phase.state == RUNNING)
+            running = true;
+    }
+
+    if (busy && !running)
+    {
+        abort("Internal error: the sync phases are waiting on each other");
+        return;
+    }
+    if (busy)
+        return;
+
+    mRunning = false;
+    qDebug() << "SyncPhaseGraph: all phases finished in " << mTimer.elapsed() << "ms";
+    emit finished();
+}
+
+QString
+SyncPhaseGraph::report() const
+{
+    QStringList lines;
+    for (int i = 0; i < mOrder.size(); ++i)
+    {
+        Phase phase = mPhases.value(mOrder.at(i));
+        lines << QString("%1: %2ms").arg(mOrder.at(i)).arg(phase.elapsed);
+    }
+    return lines.join(", ");
+}
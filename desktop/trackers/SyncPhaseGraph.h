@@ -0,0 +1,97 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SYNCPHASEGRAPH_H
+#define SYNCPHASEGRAPH_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QTime>
+
+// The steps of a backend's sync, and what each of them has to wait for.
+// Every phase is a slot on the backend that starts some network call; the
+// backend calls finish() with the phase's name once its response is in.
+// Phases whose dependencies are all done run side by side, and finished()
+// is emitted once the last of them is through.  An error anywhere aborts
+// the rest and is reported once through failed().
+class SyncPhaseGraph : public QObject
+{
+Q_OBJECT
+public:
+    explicit SyncPhaseGraph(QObject *target);
+
+    // Forgets the phases of the last sync
+    void clear();
+    // slot is the bare name of a slot on the target, e.g. "getCCs"
+    void addPhase(const QString &name,
+                  const char *slot,
+                  const QStringList &after = QStringList());
+    // Counts a phase as done without running it, for phases a previous
+    // sync already got through.  Call before start().
+    void restore(const QString &name);
+    void start();
+    void finish(const QString &name);
+    // Returns false if no sync was running, in which case the error
+    // belongs to someone else and nothing is emitted
+    bool abort(const QString &message);
+
+    bool isRunning() const { return mRunning; }
+    // Phase names in the order they were added, which is the order
+    // their results should be merged in
+    QStringList phases() const { return mOrder; }
+    // How long each phase took in the last sync
+    QString report() const;
+
+signals:
+    void finished();
+    void failed(const QString &message);
+
+private:
+    enum State
+    {
+        WAITING,
+        RUNNING,
+        DONE
+    };
+
+    struct Phase
+    {
+        QByteArray slot;
+        QStringList after;
+        State state;
+        QTime timer;
+        int elapsed;
+    };
+
+    void startReady();
+
+    QObject *pTarget;
+    QStringList mOrder;
+    QMap<QString, Phase> mPhases;
+    bool mRunning;
+    QTime mTimer;
+};
+
+#endif // SYNCPHASEGRAPH_H
@@ -0,0 +1,116 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#include <QSettings>
+#include <QStringList>
+
+#include "SyncPipeline.h"
+
+SyncPipeline::SyncPipeline()
+{
+    reset();
+}
+
+void
+SyncPipeline::reset()
+{
+    QSettings settings("Entomologist");
+    mDepth = qMax(1, settings.value("sync-pipeline-depth", 3).toInt());
+    mMaxQueued = 0;
+    for (int i = 0; i < STAGES; ++i)
+    {
+        mStages[i].active = 0;
+        mStages[i].pages = 0;
+        mStages[i].items = 0;
+        mStages[i].busyMs = 0;
+    }
+    mTimer.start();
+}
+
+// A stage's busy time runs while at least one page is in it, so stages
+// that overlap add up to more than the wall clock time
+void
+SyncPipeline::begin(Stage stage)
+{
+    Counter &counter = mStages[stage];
+    if (counter.active++ == 0)
+        counter.busy.start();
+
+    mMaxQueued = qMax(mMaxQueued, mStages[FETCH].active + mStages[WRITE].active);
+}
+
+void
+SyncPipeline::end(Stage stage,
+                  int items)
+{
+    Counter &counter = mStages[stage];
+    if (counter.active <= 0)
+        return;
+
+    counter.pages++;
+    counter.items += items;
+    if (--counter.active == 0)
+        counter.busyMs += counter.busy.elapsed();
+}
+
+bool
+SyncPipeline::canFetch() const
+{
+    return (mStages[FETCH].active + mStages[WRITE].active) < mDepth;
+}
+
+bool
+SyncPipeline::isIdle() const
+{
+    for (int i = 0; i < STAGES; ++i)
+    {
+        if (mStages[i].active > 0)
+            return false;
+    }
+    return true;
+}
+
+QString
+SyncPipeline::report() const
+{
+    const char *names[STAGES] = { "fetch", "parse", "write" };
+    QStringList lines;
+    for (int i = 0; i < STAGES; ++i)
+    {
+        const Counter &counter = mStages[i];
+        int rate = 0;
+        if (counter.busyMs > 0)
+            rate = qRound(counter.items * 1000.0 / counter.busyMs);
+        lines << QString("%1: %2 pages, %3 bugs in %4ms (%5/s)")
+                 .arg(names[i])
+                 .arg(counter.pages)
+                 .arg(counter.items)
+                 .arg(counter.busyMs)
+                 .arg(rate);
+    }
+    lines << QString("%1ms in all, at most %2 of %3 pages in flight")
+             .arg(mTimer.elapsed())
+             .arg(mMaxQueued)
+             .arg(mDepth);
+    return lines.join("; ");
+}
@@ -0,0 +1,82 @@
+/*
+ *  Copyright (c) 2011 Novell, Inc.
+ *  All Rights Reserved.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of version 2 of the GNU General Public License as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.   See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, contact Novell, Inc.
+ *
+ *  To contact Novell about this file by physical or electronic mail,
+ *  you may find current contact information at www.novell.com
+ *
+ *  Author: Matt Barringer <mbarringer@suse.de>
+ *
+ */
+
+#ifndef SYNCPIPELINE_H
+#define SYNCPIPELINE_H
+
+#include <QString>
+#include <QTime>
+
+// Bookkeeping for a sync that fetches, parses and writes its bugs a page
+// at a time, so that one page can download while the last one is written.
+// The backend tells it when a page enters and leaves each stage; it says
+// when there's room for another download, and keeps per-stage counters.
+//
+// Pages being downloaded and pages waiting for the writer both count
+// against sync-pipeline-depth (default 3), which keeps a slow disk from
+// piling up responses in memory.
+class SyncPipeline
+{
+public:
+    enum Stage
+    {
+        FETCH,
+        PARSE,
+        WRITE,
+        STAGES
+    };
+
+    SyncPipeline();
+
+    // Rereads the depth and zeroes the counters
+    void reset();
+
+    void begin(Stage stage);
+    // items is how many bugs the page held when it left the stage
+    void end(Stage stage, int items);
+
+    bool canFetch() const;
+    bool isIdle() const;
+
+    // An entry per stage: pages, items, the time the stage was busy and
+    // the items per second over that time, plus the deepest the pipeline
+    // got
+    QString report() const;
+
+private:
+    struct Counter
+    {
+        int active;
+        int pages;
+        int items;
+        int busyMs;
+        QTime busy;
+    };
+
+    Counter mStages[STAGES];
+    int mDepth;
+    int mMaxQueued;
+    QTime mTimer;
+};
+
+#endif // SYNCPIPELINE_H
@@ -26,8 +26,13 @@
 
 #include "Trac.h"
 #include "SqlUtilities.h"
+#include "AttachmentCache.h"
 #include "Utilities.hpp"
 #include "tracker_uis/TracUI.h"
+#include "SyncPhaseGraph.h"
+
+// How many ticket.get calls go into one system.multicall during a sync
+#define DETAILS_CHUNK 200
 
 Trac::Trac(const QString &url,
            const QString &username,
@@ -51,6 +56,11 @@ Trac::Trac(const QString &url,
 
     /* set trac 0.11.7 compatbility mode to false */
     mTrac0117support = false;
+    mPhaseBugTypes["monitored"] = "Monitored";
+    mPhaseBugTypes["cc"] = "CC";
+    mPhaseBugTypes["reporter"] = "Reported";
+    mPhaseBugTypes["owner"] = "Assigned";
+    mActiveAttachmentRow = -1;
 
     connect(pClient, SIGNAL(sslErrors(QNetworkReply *, const QList<QSslError> &)),
             this, SLOT(handleSslErrors(QNetworkReply *, const QList<QSslError> &)));
@@ -111,48 +121,109 @@ void
 Trac::sync()
 {
     mBugMap.clear();
+    mPhaseTickets.clear();
+    mWrittenDetails.clear();
+    mPendingDetails.clear();
     mUpdateCount = 0;
-    qDebug() << "Syncing monitored components...";
-    if (mMonitorComponents.isEmpty())
+    pSqlWriter->clearRecentBugs("trac", mId);
+
+    // The four ticket queries are independent.  They're added in the order
+    // their bug_type should win in, lowest first, and the ticket details
+    // are fetched once all of them are in.
+    QStringList queries;
+    queries << "monitored" << "cc" << "reporter" << "owner";
+    pPhases->clear();
+    pPhases->addPhase("monitored", "queryMonitored");
+    pPhases->addPhase("cc", "queryCC");
+    pPhases->addPhase("reporter", "queryReporter");
+    pPhases->addPhase("owner", "queryOwner");
+    pPhases->addPhase("details", "getBugDetails", queries);
+
+    // Queries an interrupted sync finished aren't run again, and the
+    // tickets it already wrote out aren't fetched again
+    QVariantMap saved = resumeSync();
+    QMapIterator<QString, QVariant> i(saved);
+    while (i.hasNext())
     {
-        QStringList none;
-        QVariant empty(none);
-        qDebug() << "No monitored components for this Trac instance";
-        monitoredComponentsRpcResponse(empty);
-        return;
+        i.next();
+        QVariantList chunks = i.value().toList();
+        if (i.key() == "details-partial")
+        {
+            for (int j = 0; j < chunks.size(); ++j)
+                mWrittenDetails << chunks.at(j).toStringList();
+        }
+        else
+        {
+            mPhaseTickets[i.key()] = chunks.value(0).toStringList();
+        }
     }
+    pPhases->start();
+}
 
-    SqlUtilities::clearRecentBugs("trac");
-    QVariantList args;
+// Builds a ticket.query for one of the sync phases.  sinceLastSync limits it
+// to tickets modified since the last sync, which Trac 0.11.7 can't do.
+QString
+Trac::syncQuery(const QString &filter,
+                bool sinceLastSync)
+{
     QString closed = "";
     if (mLastSync.date().year() == 1970)
         closed = "status!=closed&";
     else
         closed = "status=closed&status=new&status=accepted&status=assigned&status=reopened&";
 
-    QString monitorString;
-    for (int i = 0; i < mMonitorComponents.size(); ++i)
-    {
-        monitorString += QString("component=%1&").arg(mMonitorComponents.at(i));
-    }
-    QString query;
-    if(!mTrac0117support)
-    {
-        query = QString("%1%2max=0&modified=%3..")
-                    .arg(closed)
-                    .arg(monitorString)
-                    .arg(mLastSync.addSecs(-3600).toString("yyyy-MM-ddThh:mm")); // -1 hour to accommodate for clock drift
-    }
-    else
+    QString query = QString("%1%2&max=0").arg(closed).arg(filter);
+    if (sinceLastSync && !mTrac0117support)
+        query += QString("&modified=%1..")
+                 .arg(mLastSync.addSecs(-3600).toString("yyyy-MM-ddThh:mm")); // -1 hour to accommodate for clock drift
+    return query;
+}
+
+void
+Trac::queryMonitored()
+{
+    qDebug() << "Syncing monitored components...";
+    if (mMonitorComponents.isEmpty())
     {
-        query = QString("%1%2max=0")
-                    .arg(closed)
-                    .arg(monitorString);
+        qDebug() << "No monitored components for this Trac instance";
+        pPhases->finish("monitored");
+        return;
     }
-    args << query;
+
+    QStringList components;
+    for (int i = 0; i < mMonitorComponents.size(); ++i)
+        components << QString("component=%1").arg(mMonitorComponents.at(i));
+
+    QVariantList args;
+    args << syncQuery(components.join("&"), true);
     pClient->call("ticket.query", args, this, SLOT(monitoredComponentsRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
 }
 
+void
+Trac::queryCC()
+{
+    qDebug() << "Syncing CCs";
+    QVariantList args;
+    args << syncQuery(QString("cc=%1").arg(mUsername), true);
+    pClient->call("ticket.query", args, this, SLOT(ccRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+}
+
+void
+Trac::queryReporter()
+{
+    QVariantList args;
+    args << syncQuery(QString("reporter=%1").arg(mUsername), false);
+    pClient->call("ticket.query", args, this, SLOT(reporterRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+}
+
+void
+Trac::queryOwner()
+{
+    QVariantList args;
+    args << syncQuery(QString("owner=%1").arg(mUsername), true);
+    pClient->call("ticket.query", args, this, SLOT(ownerRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+}
+
 void
 Trac::getSearchedBug(const QString &bugId)
 {
@@ -196,6 +267,7 @@ Trac::downloadAttachment(int rowId,
                          const QString &path)
 {
     mActiveAttachmentPath = path;
+    mActiveAttachmentRow = rowId;
     QMap<QString, QString> details = SqlUtilities::attachmentDetails(rowId);
     QVariantList args;
     qDebug() << details;
@@ -324,6 +396,7 @@ Trac::uploadAll()
     if (!SqlUtilities::hasPendingChanges("shadow_trac", mId))
     {
         emit bugsUpdated();
+        emit syncFinished();
         return;
     }
 
@@ -472,133 +545,103 @@ Trac::searchedTicketResponse(QVariant &arg)
     else
         newBug["bug_state"] = "open";
     insertList << newBug;
-    //pSqlWriter->insertBugs("trac", insertList, mId, SqlUtilities::BUGS_INSERT_SEARCH);
-    pSqlWriter->multiInsert("trac", insertList);
+    pSqlWriter->insertBugs("trac", insertList, "-1", SqlUtilities::BUGS_INSERT_SEARCH);
     emit searchResultFinished(newBug);
 }
 
 void
 Trac::monitoredComponentsRpcResponse(QVariant &arg)
 {
-    QStringList bugs = arg.toStringList();
-    for (int i = 0; i < bugs.size(); ++i)
-    {
-        qDebug() << "Inserting a monitored bug";
-        mBugMap.insert(bugs.at(i), "Monitored");
-    }
-
-    qDebug() << "Syncing CCs";
-    QVariantList args;
-    QString closed = "";
-    if (mLastSync.date().year() == 1970)
-        closed = "status!=closed&";
-    else
-        closed = "status=closed&status=new&status=accepted&status=assigned&status=reopened&";
-    QString query;
-    if(!mTrac0117support)
-    {
-        query = QString("%1cc=%2&max=0&modified=%3..")
-                    .arg(closed)
-                    .arg(mUsername)
-                    .arg(mLastSync.addSecs(-3600).toString("yyyy-MM-ddThh:mm")); // -1 hour to accommodate for clock drift
-    }
-    else
-    {
-        query = QString("%1cc=%2&max=0")
-                    .arg(closed)
-                    .arg(mUsername);
-    }
-    args << query;
-    pClient->call("ticket.query", args, this, SLOT(ccRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+    mPhaseTickets["monitored"] = arg.toStringList();
+    finishQuery("monitored");
 }
 
 void
 Trac::ccRpcResponse(QVariant &arg)
 {
-    QStringList bugs = arg.toStringList();
-    for (int i = 0; i < bugs.size(); ++i)
-    {
-        mBugMap.insert(bugs.at(i), "CC");
-    }
-    QVariantList args;
-    QString closed = "";
-    if (mLastSync.date().year() == 1970)
-        closed = "status!=closed&";
-    else
-        closed = "status=closed&status=new&status=accepted&status=assigned&status=reopened&";
-#if 0
-    QString query = QString("%1reporter=%2&max=0&modified=%3..")
-                    .arg(closed)
-                    .arg(mUsername)
-                    .arg(mLastSync.addSecs(-3600).toString("yyyy-MM-ddThh:mm")); // -1 hour to accommodate for clock drift
-#else
-    QString query = QString("%1reporter=%2&max=0")
-                    .arg(closed)
-                    .arg(mUsername);
-#endif
-    args << query;
-    pClient->call("ticket.query", args, this, SLOT(reporterRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+    mPhaseTickets["cc"] = arg.toStringList();
+    finishQuery("cc");
 }
 
 void
 Trac::reporterRpcResponse(QVariant &arg)
 {
-    QStringList bugs = arg.toStringList();
-    for (int i = 0; i < bugs.size(); ++i)
-    {
-        mBugMap.insert(bugs.at(i), "Reported");
-    }
-    QVariantList args;
-    QString closed = "";
-    if (mLastSync.date().year() == 1970)
-        closed = "status!=closed&";
-    else
-        closed = "status=closed&status=new&status=accepted&status=assigned&status=reopened&";
-    QString query;
-    if(!mTrac0117support)
-    {
-        query = QString("%1owner=%2&max=0&modified=%3..")
-                    .arg(closed)
-                    .arg(mUsername)
-                    .arg(mLastSync.addSecs(-3600).toString("yyyy-MM-ddThh:mm")); // -1 hour to accommodate for clock drift
-    }
-    else
-    {
-        query = QString("%1owner=%2&max=0")
-                    .arg(closed)
-                    .arg(mUsername);
-    }
-    args << query;
-    pClient->call("ticket.query", args, this, SLOT(ownerRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+    mPhaseTickets["reporter"] = arg.toStringList();
+    finishQuery("reporter");
 }
 
 void
 Trac::ownerRpcResponse(QVariant &arg)
 {
-    QStringList bugs = arg.toStringList();
-    for (int i = 0; i < bugs.size(); ++i)
+    mPhaseTickets["owner"] = arg.toStringList();
+    finishQuery("owner");
+}
+
+// Saves a query's tickets so that an interrupted sync can skip it next time
+void
+Trac::finishQuery(const QString &phase)
+{
+    checkpoint(phase, mPhaseTickets.value(phase));
+    pPhases->finish(phase);
+}
+
+// Merges the ticket queries, later phases winning the bug_type
+void
+Trac::getBugDetails()
+{
+    QStringList phases = pPhases->phases();
+    for (int p = 0; p < phases.size(); ++p)
     {
-        mBugMap.insert(bugs.at(i), "Assigned");
+        QString bugType = mPhaseBugTypes.value(phases.at(p));
+        QStringList bugs = mPhaseTickets.value(phases.at(p));
+        for (int i = 0; i < bugs.size(); ++i)
+            mBugMap.insert(bugs.at(i), bugType);
     }
-    // The search response just gives us a list of bug numbers.
-    // In order to get the full details, we bundle a bunch of XMLRPC
-    // calls into one array, and ship that off to trac.
-    QVariantList args, methodList;
+    mPhaseTickets.clear();
 
+    mPendingDetails.clear();
     QMapIterator<QString, QString> i(mBugMap);
     while (i.hasNext())
     {
         i.next();
-        QVariantMap newMethod;
-        QVariantList newParams;
-        newParams.append(i.key().toInt());
-        newMethod.insert("methodName", "ticket.get");
-        newMethod.insert("params", newParams);
-        methodList.append(newMethod);
+        if (!mWrittenDetails.contains(i.key()))
+            mPendingDetails << i.key();
     }
+    mPipeline.reset();
+    fetchDetails();
+}
 
-    args.insert(0, methodList);;
-    pClient->call("system.multicall", args, this, SLOT(bugDetailsRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+// The search response just gives us a list of bug numbers.  In order to
+// get the full details, we bundle a bunch of XMLRPC calls into one array,
+// and ship that off to trac.  That's done DETAILS_CHUNK tickets at a time,
+// with as many pages in flight as the pipeline has room for.
+void
+Trac::fetchDetails()
+{
+    if (!pPhases->isRunning())
+        return;
+
+    while (!mPendingDetails.isEmpty() && mPipeline.canFetch())
+    {
+        QVariantList args, methodList;
+        int count = qMin(DETAILS_CHUNK, mPendingDetails.size());
+        for (int i = 0; i < count; ++i)
+        {
+            QVariantMap newMethod;
+            QVariantList newParams;
+            newParams.append(mPendingDetails.takeFirst().toInt());
+            newMethod.insert("methodName", "ticket.get");
+            newMethod.insert("params", newParams);
+            methodList.append(newMethod);
+        }
+
+        args.insert(0, methodList);
+        mPipeline.begin(SyncPipeline::FETCH);
+        pClient->call("system.multicall", args, this, SLOT(bugDetailsRpcResponse(QVariant&)), this, SLOT(rpcError(int, const QString &)));
+    }
+
+    if (mPendingDetails.isEmpty() && mPipeline.isIdle())
+        detailsFinished();
 }
 
 void
@@ -656,7 +699,7 @@ Trac::attachmentsRpcResponse(QVariant &arg)
 void
 Trac::changelogRpcResponse(QVariant &arg)
 {
-    QList<QMap<QString, QString> > list;
+    SqlRecordBatch commentBatch;
     QVariantList changelogList = arg.toList();
     for (int i = 0; i < changelogList.size(); ++i)
     {
@@ -669,75 +712,118 @@ Trac::changelogRpcResponse(QVariant &arg)
         if ((field == "comment") && (!newValue.isEmpty()))
         {
             // It's an actual comment
-            QMap<QString, QString> newComment;
-            newComment["tracker_id"] = mId;
-            newComment["bug_id"] = mActiveCommentId;
-            newComment["author"] = author;
-            newComment["comment_id"] = oldValue;
-            newComment["comment"] = newValue;
-            newComment["timestamp"] = time.toString("yyyy-MM-dd hh:mm:ss");
-            newComment["private"] = "0";
-            list << newComment;
+            commentBatch.appendRow();
+            commentBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, mActiveCommentId);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_AUTHOR, author);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT_ID, oldValue);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_COMMENT, newValue);
+            commentBatch.setValue(SqlRecordBatch::COLUMN_TIMESTAMP, time.toString("yyyy-MM-dd hh:mm:ss"));
+            commentBatch.setValue(SqlRecordBatch::COLUMN_PRIVATE, 0);
         }
     }
 
-    pSqlWriter->insertBugComments(list);
+    pSqlWriter->insertBugComments(commentBatch);
 }
 
+// A page of ticket details is in.  It's turned into a batch and handed to
+// the writer straight away, and the next page is fetched while it's written.
 void
 Trac::bugDetailsRpcResponse(QVariant &arg)
 {
-    QList<QMap<QString, QString> > insertList;
     QVariantList bugList = arg.toList();
+    mPipeline.end(SyncPipeline::FETCH, bugList.size());
+    // An aborted sync's pages are thrown away
+    if (!pPhases->isRunning())
+        return;
+
+    mPipeline.begin(SyncPipeline::PARSE);
+    SqlRecordBatch insertBatch, closedBatch;
     for (int i = 0; i < bugList.size(); ++i)
     {
         // It's QVariantLists all the way down...
         QVariantList infoList = bugList.at(i).toList().at(0).toList();
+        if (infoList.isEmpty())
+            continue;
+
         QString bugId = infoList.at(0).toString();
         for (int j = 0; j < infoList.size(); ++j )
         {
             if (infoList.at(j).type() == QVariant::Map)
             {
                 QVariantMap bug = infoList.at(j).toMap();
-                QMap<QString, QString> newBug;
-                newBug["tracker_id"] = mId;
-                newBug["bug_id"] = bugId;
-                if (!bug.value("severity").isNull())
-                    newBug["severity"] = bug.value("severity").toString();
-                else
-                    newBug["severity"] = bug.value("type").toString();
-
-                newBug["priority"] = bug.value("priority").toString();
-                newBug["version"] = bug.value("version").toString();
-                newBug["milestone"] = bug.value("milestone").toString();
-                newBug["assigned_to"] = bug.value("owner").toString();
-                newBug["status"] = bug.value("status").toString();
-                newBug["summary"] = bug.value("summary").toString();
-                newBug["description"] = bug.value("description").toString();
-                newBug["resolution"] = bug.value("resolution").toString();
-                newBug["component"] = bug.value("component").toString();
-                newBug["bug_type"] = mBugMap.value(bugId);
-                if (mLastSync.date().year() != 1970)
-                    newBug["highlight_type"] = QString::number(SqlUtilities::HIGHLIGHT_RECENT);
-
-                newBug["last_modified"] = bug.value("changetime")
-                                             .toDateTime()
-                                             .toString("yyyy-MM-dd hh:mm:ss");
+                // Closed tickets are deleted by the writer along with the page
                 if (bug.value("status").toString() == "closed")
                 {
-                    SqlUtilities::removeShadowBug("trac", newBug["bug_id"], mId);
+                    closedBatch.appendRow();
+                    closedBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+                    closedBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, bugId);
+                    continue;
                 }
+
+                mUpdateCount++;
+                insertBatch.appendRow();
+                insertBatch.setValue(SqlRecordBatch::COLUMN_TRACKER_ID, mId);
+                insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_ID, bugId);
+                if (!bug.value("severity").isNull())
+                    insertBatch.setValue(SqlRecordBatch::COLUMN_SEVERITY, bug.value("severity").toString());
                 else
-                {
-                    newBug["bug_state"] = "open";
-                    mUpdateCount++;
-                    insertList << newBug;
-                }
+                    insertBatch.setValue(SqlRecordBatch::COLUMN_SEVERITY, bug.value("type").toString());
+
+                insertBatch.setValue(SqlRecordBatch::COLUMN_PRIORITY, bug.value("priority").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_VERSION, bug.value("version").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_MILESTONE, bug.value("milestone").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_ASSIGNED_TO, bug.value("owner").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_STATUS, bug.value("status").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_SUMMARY, bug.value("summary").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_DESCRIPTION, bug.value("description").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_RESOLUTION, bug.value("resolution").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_COMPONENT, bug.value("component").toString());
+                insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_TYPE, mBugMap.value(bugId));
+                if (mLastSync.date().year() != 1970)
+                    insertBatch.setValue(SqlRecordBatch::COLUMN_HIGHLIGHT_TYPE, SqlUtilities::HIGHLIGHT_RECENT);
+
+                insertBatch.setValue(SqlRecordBatch::COLUMN_LAST_MODIFIED,
+                                     bug.value("changetime")
+                                        .toDateTime()
+                                        .toString("yyyy-MM-dd hh:mm:ss"));
+                insertBatch.setValue(SqlRecordBatch::COLUMN_BUG_STATE, "open");
             }
         }
     }
+    mPipeline.end(SyncPipeline::PARSE, insertBatch.size());
+
+    if (insertBatch.isEmpty() && closedBatch.isEmpty())
+    {
+        pageWritten(QStringList());
+        return;
+    }
 
-    pSqlWriter->insertBugs("trac", insertList);
+    mPipeline.begin(SyncPipeline::WRITE);
+    pSqlWriter->insertBugs("trac", insertBatch, "-1", SqlUtilities::BUGS_INSERT_PAGE, closedBatch);
+    fetchDetails();
+}
+
+// The tickets that are in the database don't need fetching again if the
+// sync is interrupted.  Each page is saved as a chunk of its own.
+void
+Trac::pageWritten(const QStringList &idList)
+{
+    mWrittenDetails << idList;
+    if (!idList.isEmpty())
+        appendCheckpoint("details-partial", idList);
+    fetchDetails();
+}
+
+void
+Trac::detailsFinished()
+{
+    qDebug() << "Trac::sync for " << name() << ": " << mPipeline.report();
+    mWrittenDetails.clear();
+    pPhases->finish("details");
+    updateSync();
+    emit bugsUpdated();
+    emit syncFinished();
 }
 
 void
@@ -878,16 +964,16 @@ Trac::severityRpcResponse(QVariant &arg)
 void
 Trac::attachmentDownloadedRpcResponse(QVariant &arg)
 {
-    QByteArray save = arg.toByteArray();
-    QFile file(mActiveAttachmentPath);
-    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate))
+    AttachmentCache cache(mId, SqlUtilities::attachmentDetails(mActiveAttachmentRow));
+    QString cachedPath;
+    if (cache.open() && cache.write(arg.toByteArray()))
+        cachedPath = cache.commit();
+
+    if (cachedPath.isEmpty() || !AttachmentCache::copyTo(cachedPath, mActiveAttachmentPath))
     {
-        qDebug() << "Could not open " << mActiveAttachmentPath;
-        qDebug() << "Error: " << file.errorString();
         emit attachmentDownloaded("");
+        return;
     }
-    file.write(save);
-    file.close();
     emit attachmentDownloaded(mActiveAttachmentPath);
 }
 
@@ -955,18 +1041,22 @@ void
 Trac::rpcError(int error,
                const QString &message)
 {
-    if(!mTrac0117support && (message ==
-        "'no such column: t.modified' while executing 'ticket.query()'"))
+    // Every query of the sync that used the modified filter fails this way,
+    // so only the first one restarts it
+    if (message == "'no such column: t.modified' while executing 'ticket.query()'")
     {
-        qDebug() << "Try to sync with trac 0.11.7 support";
-        mTrac0117support = true;
-        sync();
+        if (!mTrac0117support)
+        {
+            qDebug() << "Try to sync with trac 0.11.7 support";
+            mTrac0117support = true;
+            sync();
+        }
         return;
     }
 
     qDebug() << "rpcError" << message;
     QString e = QString("Error %1: %2").arg(error).arg(message);
-    emit backendError(e);
+    syncError(e);
 }
 
 void
@@ -985,11 +1075,16 @@ Trac::commentInsertionFinished()
 void
 Trac::bugsInsertionFinished(QStringList idList, int operation)
 {
-    Q_UNUSED(idList);
-    if (operation != SqlUtilities::BUGS_INSERT_SEARCH)
+    if (operation == SqlUtilities::BUGS_INSERT_PAGE)
+    {
+        mPipeline.end(SyncPipeline::WRITE, idList.size());
+        pageWritten(idList);
+    }
+    else if (operation != SqlUtilities::BUGS_INSERT_SEARCH)
     {
         updateSync();
         emit bugsUpdated();
+        emit syncFinished();
     }
 }
 
@@ -25,6 +25,7 @@
 #include <QObject>
 #include "Backend.h"
 #include "libmaia/maiaXmlRpcClient.h"
+#include "SyncPipeline.h"
 
 class Trac : public Backend
 {
@@ -85,7 +86,19 @@ public slots:
     void headFinished();
     void handleSslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
 
+    // Sync phases
+    void queryMonitored();
+    void queryCC();
+    void queryReporter();
+    void queryOwner();
+    void getBugDetails();
+
 private:
+    QString syncQuery(const QString &filter, bool sinceLastSync);
+    void finishQuery(const QString &phase);
+    void fetchDetails();
+    void pageWritten(const QStringList &idList);
+    void detailsFinished();
     void checkValidSeverities();
     void checkValidStatuses();
     void checkValidVersions();
@@ -95,9 +108,18 @@ private:
 
     MaiaXmlRpcClient *pClient;
     QMap<QString, QString> mBugMap;
+    // The tickets each sync phase found, and the bug_type they get
+    QMap<QString, QStringList> mPhaseTickets;
+    QMap<QString, QString> mPhaseBugTypes;
+    // Tickets whose details are in the database, and the ones still to
+    // fetch
+    QStringList mWrittenDetails;
+    QStringList mPendingDetails;
+    SyncPipeline mPipeline;
     QStringList mSeverities;
     QString mActiveCommentId;
     QString mActiveAttachmentPath;
+    int mActiveAttachmentRow;
     bool mTrac0117support;
 };
 